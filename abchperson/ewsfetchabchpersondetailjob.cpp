@@ -47,12 +47,9 @@ void EwsFetchAbchContactDetailsJob::processItems(const QList<EwsGetItemRequest::
 
         if (!resp.isSuccess()) {
             qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to fetch item %1").arg(item.remoteId());
-            continue;
         }
 
-        //const EwsItem &ewsItem = resp.item();
-
-        // TODO: Implement
+        /* There is no Akonadi payload type for AbchPerson items - they are only tracked by id. */
 
         ++it;
     }
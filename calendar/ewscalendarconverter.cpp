@@ -0,0 +1,184 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ewscalendarconverter.h"
+
+#include <QHash>
+#include <QTimeZone>
+
+#include <KCalCore/Event>
+#include <KCalCore/ICalFormat>
+#include <KCalCore/MemoryCalendar>
+#include <KDE/KDateTime>
+#include <KDE/KSystemTimeZones>
+#include <KDE/KTimeZone>
+
+#include "ewsitem.h"
+#include "ewsclient_debug.h"
+
+/* Properties needed to build the incidence from the MIME content of the item. */
+QList<EwsPropertyField> EwsCalendarConverter::mimeProperties()
+{
+    static const QList<EwsPropertyField> props = {
+        EwsPropertyField("calendar:CalendarItemType"),
+        EwsPropertyField("item:Culture"),
+        EwsPropertyField("item:MimeContent"),
+        EwsPropertyField("calendar:TimeZone"),
+    };
+    return props;
+}
+
+/* Maps a Windows time zone id to the matching system time zone, using the country of the item
+ * culture to pick among several IANA zones sharing the same Windows id. The result is memoized
+ * as the same few zones are looked up several times for every calendar item. */
+KTimeZone EwsCalendarConverter::resolveTimezone(const QString &msTimezone, const QString &culture)
+{
+    static QHash<QPair<QString, QString>, KTimeZone> timezoneCache;
+
+    if (msTimezone.isEmpty()) {
+        return KTimeZone();
+    }
+
+    const QPair<QString, QString> key(msTimezone, culture);
+    QHash<QPair<QString, QString>, KTimeZone>::const_iterator it = timezoneCache.constFind(key);
+    if (it != timezoneCache.cend()) {
+        return *it;
+    }
+
+    KTimeZone tz;
+    // Special case:
+    if (msTimezone == QStringLiteral("tzone://Microsoft/Utc")) {
+        tz = KTimeZone::utc();
+    } else {
+        QByteArray ianaTz = QTimeZone::windowsIdToDefaultIanaId(msTimezone.toLatin1(), QLocale(culture).country());
+        if (ianaTz.isEmpty()) {
+            // Give it one more try with the default country.
+            ianaTz = QTimeZone::windowsIdToDefaultIanaId(msTimezone.toLatin1());
+        }
+        if (!ianaTz.isEmpty()) {
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("Found IANA time zone '%1' for '%2'").arg(QString::fromLatin1(ianaTz))
+                            .arg(msTimezone);
+            tz = KSystemTimeZones::zone(QString::fromLatin1(ianaTz));
+        }
+    }
+
+    /* Failed lookups are cached as well - they would fail again. */
+    timezoneCache.insert(key, tz);
+    return tz;
+}
+
+/* Checking the list of available IANA time zones is expensive on some platforms, so remember
+ * the answer for each time zone name. */
+static bool isIanaTimezone(const QString &tzName)
+{
+    static QHash<QString, bool> ianaCache;
+
+    QHash<QString, bool>::const_iterator it = ianaCache.constFind(tzName);
+    if (it != ianaCache.cend()) {
+        return *it;
+    }
+
+    bool available = QTimeZone::isTimeZoneIdAvailable(tzName.toLatin1());
+    ianaCache.insert(tzName, available);
+    return available;
+}
+
+/* This function is a lousy workaround for Exchange returning Windows timezone names instead of
+ * IANA ones.
+ */
+static void convertTimezone(KDateTime &currentTime, const QString &msTimezone, const QString &culture)
+{
+    KDateTime resultDt;
+    const QString tzName = currentTime.timeZone().name();
+
+    if (!isIanaTimezone(tzName)) {
+        // The event uses an incorrect IANA timezone, so this will most likely be a
+        // Windows timezone name. Attempt to do the conversion.
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Time zone '%1' not found on IANA list. Trying to convert with culture '%2'")
+                        .arg(tzName).arg(culture);
+        qCDebugNC(EWSRES_LOG) << "MSTZ: " << msTimezone;
+        KTimeZone newTz = EwsCalendarConverter::resolveTimezone(msTimezone.isEmpty() ? tzName : msTimezone, culture);
+        if (!newTz.isValid()) {
+            // Give it another try with the timezone name from the event.
+            newTz = EwsCalendarConverter::resolveTimezone(tzName, culture);
+        }
+        if (newTz.isValid()) {
+            resultDt = KDateTime(currentTime.dateTime(), newTz);
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("New timezone: '%1'").arg(resultDt.timeZone().name());
+        } else {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to convert time zone '%1' or '%2' to IANA id")
+                            .arg(msTimezone).arg(tzName);
+        }
+    }
+
+    currentTime = resultDt;
+}
+
+KCalCore::Incidence::Ptr EwsCalendarConverter::incidenceFromMime(const EwsItem &ewsItem, bool exception)
+{
+    KCalCore::ICalFormat format;
+    QString mimeContent = ewsItem[EwsItemFieldMimeContent].toString();
+    KCalCore::Calendar::Ptr memcal(new KCalCore::MemoryCalendar("GMT"));
+    format.fromString(memcal, mimeContent);
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Found %1 events").arg(memcal->events().count());
+
+    KCalCore::Incidence::Ptr incidence;
+    if (memcal->events().isEmpty()) {
+        return incidence;
+    }
+    if (exception) {
+        incidence = memcal->events().last();
+        incidence->clearRecurrence();
+    }
+    else if (memcal->events().count() > 1) {
+        Q_FOREACH(KCalCore::Event::Ptr event, memcal->events()) {
+            if (!event->recurrenceId().isValid()) {
+                incidence = event;
+            }
+        }
+    }
+    else {
+        incidence = memcal->events()[0];
+    }
+
+    if (incidence) {
+        QString msTz = ewsItem[EwsItemFieldTimeZone].toString();
+        QString culture = ewsItem[EwsItemFieldCulture].toString();
+        KDateTime dt(incidence->dtStart());
+        convertTimezone(dt, msTz, culture);
+        if (dt.isValid()) {
+            incidence->setDtStart(dt);
+        }
+        if (incidence->type() == KCalCore::Incidence::TypeEvent) {
+            KCalCore::Event *event = reinterpret_cast<KCalCore::Event*>(incidence.data());
+            dt = event->dtEnd();
+            convertTimezone(dt, msTz, culture);
+            if (dt.isValid()) {
+                event->setDtEnd(dt);
+            }
+        }
+        dt = incidence->recurrenceId();
+        convertTimezone(dt, msTz, culture);
+        if (dt.isValid()) {
+            incidence->setRecurrenceId(dt);
+        }
+    }
+
+    return incidence;
+}
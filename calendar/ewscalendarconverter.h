@@ -0,0 +1,47 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#ifndef EWSCALENDARCONVERTER_H
+#define EWSCALENDARCONVERTER_H
+
+#include <QList>
+
+#include <KCalCore/Incidence>
+
+#include "ewspropertyfield.h"
+
+class KTimeZone;
+class EwsItem;
+
+/**
+ *  @brief  Conversion of EWS calendar items into KCalCore incidences
+ *
+ *  Exchange reports time zones using Windows names instead of IANA ones. resolveTimezone() maps
+ *  them to system time zones and is also used directly for the time zone properties of items
+ *  fetched without MIME content.
+ */
+class EwsCalendarConverter
+{
+public:
+    static QList<EwsPropertyField> mimeProperties();
+    static KCalCore::Incidence::Ptr incidenceFromMime(const EwsItem &ewsItem, bool exception);
+    static KTimeZone resolveTimezone(const QString &msTimezone, const QString &culture);
+};
+
+#endif
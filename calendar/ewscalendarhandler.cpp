@@ -21,6 +21,8 @@
 
 #include <KCalCore/Event>
 
+#include "ewsclient_debug.h"
+#include "ewscalendarconverter.h"
 #include "ewsfetchcalendardetailjob.h"
 #include "ewsmodifycalendarjob.h"
 #include "ewscreatecalendarjob.h"
@@ -59,9 +61,15 @@ QString EwsCalendarHandler::mimeType()
 
 bool EwsCalendarHandler::setItemPayload(Akonadi::Item &item, const EwsItem &ewsItem)
 {
-    Q_UNUSED(item)
-    Q_UNUSED(ewsItem)
-
+    bool exception = ewsItem[EwsItemFieldCalendarItemType].toInt() == EwsCalendarItemException;
+    KCalCore::Incidence::Ptr incidence = EwsCalendarConverter::incidenceFromMime(ewsItem, exception);
+    if (!incidence) {
+        qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to convert calendar item %1")
+                        .arg(ewsHash(item.remoteId()));
+        return false;
+    }
+
+    item.setPayload<KCalCore::Incidence::Ptr>(incidence);
     return true;
 }
 
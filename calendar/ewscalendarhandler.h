@@ -20,6 +20,8 @@
 #ifndef EWSCALENDARHANDLER_H
 #define EWSCALENDARHANDLER_H
 
+#include <KCalCore/Incidence>
+
 #include "ewsitemhandler.h"
 
 class EwsCalendarHandler : public EwsItemHandler
@@ -16,161 +16,163 @@
     the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
     Boston, MA 02110-1301, USA.
 */
-
 #include "ewsfetchcalendardetailjob.h"
 
-#include <QTimeZone>
-
 #include <KCalCore/Event>
-#include <KCalCore/ICalFormat>
-#include <KCalCore/MemoryCalendar>
 #include <KDE/KDateTime>
-#include <KDE/KSystemTimeZones>
 #include <KDE/KTimeZone>
 
 #include "ewsclient_debug.h"
+#include "ewsattendee.h"
+#include "ewscalendarconverter.h"
 #include "ewsgetitemrequest.h"
 #include "ewsitemshape.h"
 #include "ewsmailbox.h"
 #include "ewsoccurrence.h"
+#include "ewsrecurrence.h"
 
 using namespace Akonadi;
 
 EwsFetchCalendarDetailJob::EwsFetchCalendarDetailJob(EwsClient &client, QObject *parent,
                                                      const Collection &collection)
-    : EwsFetchItemDetailJob(client, parent, collection)
+    : EwsFetchItemDetailJob(client, parent, collection),
+      mTypedProperties(client.serverVersion().supports(EwsServerVersion::StartEndTimeZones))
 {
+    /* Building the incidence from typed properties needs the start and end time zone ids, which
+     * are only available since Exchange 2010. Older servers fall back to parsing the MIME
+     * content. */
+    if (mTypedProperties) {
+        mRequest->setServerVersion(EwsServerVersion::minSupporting(EwsServerVersion::StartEndTimeZones));
+    }
+    mRequest->setItemShape(itemShape());
+}
+
+
+EwsFetchCalendarDetailJob::~EwsFetchCalendarDetailJob()
+{
+}
+
+EwsItemShape EwsFetchCalendarDetailJob::itemShape() const
+{
+    if (!mTypedProperties) {
+        return mimeItemShape();
+    }
+
     EwsItemShape shape(EwsShapeIdOnly);
-/*    shape << EwsPropertyField("calendar:UID");
     shape << EwsPropertyField("item:Subject");
     shape << EwsPropertyField("item:Body");
-    shape << EwsPropertyField("calendar:Organizer");
-    shape << EwsPropertyField("calendar:RequiredAttendees");
-    shape << EwsPropertyField("calendar:OptionalAttendees");
-    shape << EwsPropertyField("calendar:Resources");
+    shape << EwsPropertyField("item:Sensitivity");
+    shape << EwsPropertyField("item:Categories");
+    shape << EwsPropertyField("item:Culture");
+    shape << EwsPropertyField("item:ReminderIsSet");
+    shape << EwsPropertyField("item:ReminderMinutesBeforeStart");
+    shape << EwsPropertyField("calendar:UID");
+    shape << EwsPropertyField("calendar:CalendarItemType");
+    shape << EwsPropertyField("calendar:OriginalStart");
     shape << EwsPropertyField("calendar:Start");
     shape << EwsPropertyField("calendar:End");
+    shape << EwsPropertyField("calendar:StartTimeZone");
+    shape << EwsPropertyField("calendar:EndTimeZone");
     shape << EwsPropertyField("calendar:IsAllDayEvent");
     shape << EwsPropertyField("calendar:LegacyFreeBusyStatus");
+    shape << EwsPropertyField("calendar:Location");
+    shape << EwsPropertyField("calendar:Organizer");
+    shape << EwsPropertyField("calendar:RequiredAttendees");
+    shape << EwsPropertyField("calendar:OptionalAttendees");
+    shape << EwsPropertyField("calendar:Resources");
     shape << EwsPropertyField("calendar:AppointmentSequenceNumber");
-    shape << EwsPropertyField("calendar:IsRecurring");
     shape << EwsPropertyField("calendar:Recurrence");
-    shape << EwsPropertyField("calendar:FirstOccurrence");
-    shape << EwsPropertyField("calendar:LastOccurrence");
     shape << EwsPropertyField("calendar:ModifiedOccurrences");
     shape << EwsPropertyField("calendar:DeletedOccurrences");
-    shape << EwsPropertyField("calendar:StartTimeZone");
-    shape << EwsPropertyField("calendar:EndTimeZone");
-    shape << EwsPropertyField("calendar:MyResponseType");
-    shape << EwsPropertyField("item:HasAttachments");
-    shape << EwsPropertyField("item:Attachments");*/
+    return shape;
+}
 
-//    shape << EwsPropertyField("item:Attachments");
+EwsItemShape EwsFetchCalendarDetailJob::mimeItemShape() const
+{
+    EwsItemShape shape(EwsShapeIdOnly);
     shape << EwsPropertyField("calendar:ModifiedOccurrences");
     shape << EwsPropertyField("calendar:DeletedOccurrences");
     shape << EwsPropertyField("item:Body");
-    shape << EwsPropertyField("item:Culture");
-    shape << EwsPropertyField("item:MimeContent");
     shape << EwsPropertyField("item:Subject");
-    shape << EwsPropertyField("calendar:TimeZone");
-    mRequest->setItemShape(shape);
-}
-
-
-EwsFetchCalendarDetailJob::~EwsFetchCalendarDetailJob()
-{
+    Q_FOREACH(const EwsPropertyField &field, EwsCalendarConverter::mimeProperties()) {
+        shape << field;
+    }
+    return shape;
 }
 
+/* Exceptions of recurring items are not fetched here. Instead they are handed back to the fetch
+ * items job as additional items, which fetches them in batches together with the exceptions found
+ * by other detail jobs. */
 void EwsFetchCalendarDetailJob::processItems(const QList<EwsGetItemRequest::Response> &responses)
 {
     Item::List::iterator it = mChangedItems.begin();
-    KCalCore::ICalFormat format;
 
-    EwsId::List addItems;
+    EwsId::List fallbackIds;
 
     Q_FOREACH(const EwsGetItemRequest::Response &resp, responses) {
         Item &item = *it;
 
-        qDebug() << item.remoteId();
-
         if (!resp.isSuccess()) {
             qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to fetch item %1").arg(item.remoteId());
+            ++it;
             continue;
         }
 
         const EwsItem &ewsItem = resp.item();
-        QString mimeContent = ewsItem[EwsItemFieldMimeContent].toString();
-        KCalCore::Calendar::Ptr memcal(new KCalCore::MemoryCalendar("GMT"));
-        format.fromString(memcal, mimeContent);
-        qCDebugNC(EWSRES_LOG) << QStringLiteral("Found %1 events").arg(memcal->events().count());
+        bool exception = ewsItem[EwsItemFieldCalendarItemType].toInt() == EwsCalendarItemException;
         KCalCore::Incidence::Ptr incidence;
-        if (memcal->events().count() > 1) {
-            Q_FOREACH(KCalCore::Event::Ptr event, memcal->events()) {
-                qCDebugNC(EWSRES_LOG) << QString::number(event->recurrence()->recurrenceType(), 16) << event->recurrenceId().dateTime() << event->recurrenceId().isValid();
-                if (!event->recurrenceId().isValid()) {
-                    incidence = event;
+        if (mTypedProperties) {
+            KCalCore::Event::Ptr event = eventFromProperties(ewsItem);
+            if (event && exception) {
+                QDateTime originalStart = ewsItem[EwsItemFieldOriginalStart].toDateTime();
+                if (originalStart.isValid()) {
+                    event->setRecurrenceId(toEventTime(originalStart, event->dtStart().timeZone(),
+                                                       event->allDay()));
+                } else {
+                    event.clear();
                 }
             }
-            EwsOccurrence::List excList = ewsItem[EwsItemFieldModifiedOccurrences].value<EwsOccurrence::List>();
-            Q_FOREACH(const EwsOccurrence &exc, excList) {
-                addItems.append(exc.itemId());
+            incidence = event;
+            if (!incidence) {
+                qCDebugNC(EWSRES_LOG) << QStringLiteral("Falling back to MIME content for item %1")
+                                .arg(ewsHash(item.remoteId()));
+                mFallbackItems.insert(item.remoteId(), it - mChangedItems.begin());
+                fallbackIds.append(EwsId(item.remoteId(), item.remoteRevision()));
             }
+        } else {
+            incidence = EwsCalendarConverter::incidenceFromMime(ewsItem, exception);
         }
-        else if (memcal->events().count() == 1) {
-            incidence = memcal->events()[0];
-        }
-        //KCalCore::Incidence::Ptr incidence(format.fromString(mimeContent));
 
         if (incidence) {
-            QString msTz = ewsItem[EwsItemFieldTimeZone].toString();
-            QString culture = ewsItem[EwsItemFieldCulture].toString();
-            KDateTime dt(incidence->dtStart());
-            convertTimezone(dt, msTz, culture);
-            if (dt.isValid()) {
-                incidence->setDtStart(dt);
-            }
-            if (incidence->type() == KCalCore::Incidence::TypeEvent) {
-                KCalCore::Event *event = reinterpret_cast<KCalCore::Event*>(incidence.data());
-                dt = event->dtEnd();
-                convertTimezone(dt, msTz, culture);
-                if (dt.isValid()) {
-                    event->setDtEnd(dt);
-                }
-            }
-            dt = incidence->recurrenceId();
-            convertTimezone(dt, msTz, culture);
-            if (dt.isValid()) {
-                incidence->setRecurrenceId(dt);
-            }
-
             item.setPayload<KCalCore::Incidence::Ptr>(incidence);
         }
 
-        it++;
-    }
-
-    if (addItems.isEmpty()) {
-        qDebug() << "done";
+        EwsOccurrence::List excList = ewsItem[EwsItemFieldModifiedOccurrences].value<EwsOccurrence::List>();
+        Q_FOREACH(const EwsOccurrence &exc, excList) {
+            Item excItem(KCalCore::Event::eventMimeType());
+            excItem.setParentCollection(mCollection);
+            excItem.setRemoteId(exc.itemId().id());
+            excItem.setRemoteRevision(exc.itemId().changeKey());
+            mAdditionalItems.append(excItem);
+        }
 
-        emitResult();
+        ++it;
     }
-    else {
+
+    if (!fallbackIds.isEmpty()) {
         EwsGetItemRequest *req = new EwsGetItemRequest(mClient, this);
-        EwsItemShape shape(EwsShapeIdOnly);
-//        shape << EwsPropertyField("item:Attachments");
-        shape << EwsPropertyField("item:Body");
-        shape << EwsPropertyField("item:MimeContent");
-        shape << EwsPropertyField("calendar:TimeZone");
-        shape << EwsPropertyField("item:Culture");
-        req->setItemShape(shape);
-
-        req->setItemIds(addItems);
-        connect(req, SIGNAL(result(KJob*)), SLOT(exceptionItemsFetched(KJob*)));
+        req->setItemShape(mimeItemShape());
+        req->setItemIds(fallbackIds);
+        connect(req, SIGNAL(result(KJob*)), SLOT(fallbackItemsFetched(KJob*)));
         req->start();
+        return;
     }
+
+    qCDebugNC(EWSRES_LOG) << "EwsFetchCalendarDetailJob::processItems: done";
+    emitResult();
 }
 
-void EwsFetchCalendarDetailJob::exceptionItemsFetched(KJob *job)
+void EwsFetchCalendarDetailJob::fallbackItemsFetched(KJob *job)
 {
     if (job->error()) {
         setError(job->error());
@@ -188,7 +190,6 @@ void EwsFetchCalendarDetailJob::exceptionItemsFetched(KJob *job)
         return;
     }
 
-    KCalCore::ICalFormat format;
     Q_FOREACH(const EwsGetItemRequest::Response& resp, req->responses()) {
         if (!resp.isSuccess()) {
             qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to fetch item.");
@@ -196,103 +197,195 @@ void EwsFetchCalendarDetailJob::exceptionItemsFetched(KJob *job)
         }
         const EwsItem &ewsItem = resp.item();
 
-        Item item(KCalCore::Event::eventMimeType());
-        item.setParentCollection(mCollection);
         EwsId id = ewsItem[EwsItemFieldItemId].value<EwsId>();
-        item.setRemoteId(id.id());
-        item.setRemoteRevision(id.changeKey());
-
-        QString mimeContent = ewsItem[EwsItemFieldMimeContent].toString();
-        KCalCore::Calendar::Ptr memcal(new KCalCore::MemoryCalendar("GMT"));
-        format.fromString(memcal, mimeContent);
-        KCalCore::Incidence::Ptr incidence(memcal->events().last());
-        incidence->clearRecurrence();
-
-        QString msTz = ewsItem[EwsItemFieldStartTimeZone].toString();
-        QString culture = ewsItem[EwsItemFieldCulture].toString();
-        KDateTime dt(incidence->dtStart());
-        convertTimezone(dt, msTz, culture);
-        if (dt.isValid()) {
-            incidence->setDtStart(dt);
-        }
-        if (incidence->type() == KCalCore::Incidence::TypeEvent) {
-            KCalCore::Event *event = reinterpret_cast<KCalCore::Event*>(incidence.data());
-            dt = event->dtEnd();
-            convertTimezone(dt, msTz, culture);
-            if (dt.isValid()) {
-                event->setDtEnd(dt);
-            }
-        }
-        dt = incidence->recurrenceId();
-        convertTimezone(dt, msTz, culture);
-        if (dt.isValid()) {
-            incidence->setRecurrenceId(dt);
+        int index = mFallbackItems.value(id.id(), -1);
+        if (index < 0) {
+            continue;
         }
 
-        item.setPayload<KCalCore::Incidence::Ptr>(incidence);
-
-        mChangedItems.append(item);
+        bool exception = ewsItem[EwsItemFieldCalendarItemType].toInt() == EwsCalendarItemException;
+        KCalCore::Incidence::Ptr incidence = EwsCalendarConverter::incidenceFromMime(ewsItem, exception);
+        if (incidence) {
+            mChangedItems[index].setPayload<KCalCore::Incidence::Ptr>(incidence);
+        }
     }
 
+    qCDebugNC(EWSRES_LOG) << "EwsFetchCalendarDetailJob::processItems: done";
     emitResult();
 }
 
-/*
- *  This method does its best to convert the timezone found in the EWS calendar event to a IANA
- *  timezone. This is a cumbersome process as there is no guarantee that the
- */
-/*KTimeZone EwsFetchCalendarDetailJob::getTimezone(QString msTimezone, QString culture)
+static KCalCore::Attendee::PartStat attendeeStatus(EwsEventResponseType response)
 {
-    return KTimeZone();
-}*/
+    switch (response) {
+    case EwsEventResponseOrganizer:
+    case EwsEventResponseAccept:
+        return KCalCore::Attendee::Accepted;
+    case EwsEventResponseTentative:
+        return KCalCore::Attendee::Tentative;
+    case EwsEventResponseDecline:
+        return KCalCore::Attendee::Declined;
+    default:
+        return KCalCore::Attendee::NeedsAction;
+    }
+}
 
-/* This function is a lousy workaround for Exchange returning Windows timezone names instead of
- * IANA ones.
- */
-void EwsFetchCalendarDetailJob::convertTimezone(KDateTime &currentTime, QString msTimezone, QString culture)
+/* Builds the event directly from the typed calendar item properties. Returns a null pointer when
+ * the item lacks the properties needed for the conversion, in which case the caller falls back to
+ * the MIME content. */
+KCalCore::Event::Ptr EwsFetchCalendarDetailJob::eventFromProperties(const EwsItem &ewsItem)
 {
-    KDateTime resultDt;
+    QVariant start = ewsItem[EwsItemFieldStart];
+    QVariant end = ewsItem[EwsItemFieldEnd];
+    if (!start.isValid() || !end.isValid()) {
+        return KCalCore::Event::Ptr();
+    }
+
+    KCalCore::Event::Ptr event(new KCalCore::Event());
+
+    QString culture = ewsItem[EwsItemFieldCulture].toString();
+    KTimeZone startTz = EwsCalendarConverter::resolveTimezone(ewsItem[EwsItemFieldStartTimeZone].toString(), culture);
+    KTimeZone endTz = ewsItem[EwsItemFieldEndTimeZone].isValid() ?
+        EwsCalendarConverter::resolveTimezone(ewsItem[EwsItemFieldEndTimeZone].toString(), culture) : startTz;
+    bool allDay = ewsItem[EwsItemFieldIsAllDayEvent].toBool();
+
+    KDateTime dtStart = toEventTime(start.toDateTime(), startTz, allDay);
+    KDateTime dtEnd = toEventTime(end.toDateTime(), endTz, allDay);
+    if (allDay) {
+        // EWS uses an exclusive end for all-day events, iCalendar an inclusive one.
+        dtEnd = dtEnd.addDays(-1);
+        if (dtEnd < dtStart) {
+            dtEnd = dtStart;
+        }
+    }
+    event->setDtStart(dtStart);
+    event->setDtEnd(dtEnd);
+    event->setAllDay(allDay);
+
+    QVariant v = ewsItem[EwsItemFieldUID];
+    if (v.isValid()) {
+        event->setUid(v.toString());
+    }
+
+    v = ewsItem[EwsItemFieldSubject];
+    if (v.isValid()) {
+        event->setSummary(v.toString());
+    }
+
+    v = ewsItem[EwsItemFieldBody];
+    if (v.isValid()) {
+        event->setDescription(v.toString(), ewsItem[EwsItemFieldBodyIsHtml].toBool());
+    }
+
+    v = ewsItem[EwsItemFieldLocation];
+    if (v.isValid()) {
+        event->setLocation(v.toString());
+    }
+
+    v = ewsItem[EwsItemFieldCategories];
+    if (v.isValid()) {
+        event->setCategories(v.toStringList());
+    }
+
+    v = ewsItem[EwsItemFieldSensitivity];
+    if (v.isValid()) {
+        switch (static_cast<EwsItemSensitivity>(v.toInt())) {
+        case EwsItemSensitivityPersonal:
+        case EwsItemSensitivityPrivate:
+            event->setSecrecy(KCalCore::Incidence::SecrecyPrivate);
+            break;
+        case EwsItemSensitivityConfidential:
+            event->setSecrecy(KCalCore::Incidence::SecrecyConfidential);
+            break;
+        default:
+            event->setSecrecy(KCalCore::Incidence::SecrecyPublic);
+            break;
+        }
+    }
+
+    v = ewsItem[EwsItemFieldLegacyFreeBusyStatus];
+    if (v.isValid()) {
+        event->setTransparency(v.toInt() == EwsLfbStatusFree ? KCalCore::Event::Transparent
+                                                              : KCalCore::Event::Opaque);
+    }
 
-    if (!QTimeZone::isTimeZoneIdAvailable(currentTime.timeZone().name().toLatin1())) {
-        // The event uses an incorrect IANA timezone, so this will most likely be a
-        // Windows timezone name. Attempt to do the conversion.
+    v = ewsItem[EwsItemFieldAppointmentSequenceNumber];
+    if (v.isValid()) {
+        event->setRevision(v.toInt());
+    }
+
+    v = ewsItem[EwsItemFieldOrganizer];
+    if (v.isValid()) {
+        EwsMailbox mbox = v.value<EwsMailbox>();
+        event->setOrganizer(KCalCore::Person::Ptr(new KCalCore::Person(mbox.name(), mbox.email())));
+    }
 
-        QString ianaTz;
-        // Special case:
-        if (msTimezone == QStringLiteral("tzone://Microsoft/Utc")) {
-            ianaTz = QStringLiteral("UTC");
+    static const QVector<QPair<EwsItemFields, KCalCore::Attendee::Role>> attendeeFields = {
+        {EwsItemFieldRequiredAttendees, KCalCore::Attendee::ReqParticipant},
+        {EwsItemFieldOptionalAttendees, KCalCore::Attendee::OptParticipant},
+        {EwsItemFieldResources, KCalCore::Attendee::NonParticipant},
+    };
+    for (const auto &field : attendeeFields) {
+        v = ewsItem[field.first];
+        if (!v.isValid()) {
+            continue;
         }
-        else {
-            QLocale locale(culture);
-            if (msTimezone.isEmpty()) {
-                msTimezone = currentTime.timeZone().name();
-            }
-            qCDebugNC(EWSRES_LOG) << QStringLiteral("Time zone '%1' not found on IANA list. Trying to convert with country '%2'")
-                            .arg(currentTime.timeZone().name()).arg(QLocale::countryToString(locale.country()));
-            qCDebugNC(EWSRES_LOG) << "MSTZ: " << msTimezone;
-            ianaTz = QTimeZone::windowsIdToDefaultIanaId(msTimezone.toLatin1(), locale.country());
-            if (ianaTz.isEmpty()) {
-                // Give it one more try with the default country.
-                ianaTz = QTimeZone::windowsIdToDefaultIanaId(msTimezone.toLatin1());
-                if (ianaTz.isEmpty()) {
-                    // Give it two more tries with the timezone name from the event.
-                    ianaTz = QTimeZone::windowsIdToDefaultIanaId(currentTime.timeZone().name().toLatin1(), locale.country());
-                    if (ianaTz.isEmpty()) {
-                        // Give it one more try with the default country.
-                        ianaTz = QTimeZone::windowsIdToDefaultIanaId(currentTime.timeZone().name().toLatin1());
-                        qCWarningNC(EWSRES_LOG)
-                            << QStringLiteral("Failed to convert time zone '%1' or '%2' to IANA id").arg(msTimezone).arg(currentTime.timeZone().name());
-                    }
-                }
+        Q_FOREACH(const EwsAttendee &att, v.value<EwsAttendee::List>()) {
+            const EwsMailbox &mbox = att.mailbox();
+            event->addAttendee(KCalCore::Attendee::Ptr(new KCalCore::Attendee(mbox.name(), mbox.email(),
+                                                       true, attendeeStatus(att.response()),
+                                                       field.second)));
+        }
+    }
+
+    if (ewsItem[EwsItemFieldReminderIsSet].toBool()) {
+        KCalCore::Alarm::Ptr alarm = event->newAlarm();
+        alarm->setDisplayAlarm(event->summary());
+        alarm->setStartOffset(KCalCore::Duration(-60 * ewsItem[EwsItemFieldReminderMinutesBeforeStart].toInt()));
+        alarm->setEnabled(true);
+    }
+
+    v = ewsItem[EwsItemFieldRecurrence];
+    if (v.isValid()) {
+        const EwsRecurrence ewsRecurrence = v.value<EwsRecurrence>();
+        if (ewsRecurrence.rRules().isEmpty()) {
+            // The recurrence pattern could not be read.
+            return KCalCore::Event::Ptr();
+        }
+        KCalCore::Recurrence *recurrence = event->recurrence();
+        Q_FOREACH(const KCalCore::RecurrenceRule *rule, ewsRecurrence.rRules()) {
+            KCalCore::RecurrenceRule *newRule = new KCalCore::RecurrenceRule(*rule);
+            /* The recurrence was read without knowing the event start, so the end date is only
+             * meaningful as a date. */
+            QDate endDate = rule->endDt().date();
+            if (rule->duration() == 0 && endDate.isValid()) {
+                newRule->setEndDt(allDay ? KDateTime(endDate, dtStart.timeSpec())
+                                         : KDateTime(endDate, QTime(23, 59, 59), dtStart.timeSpec()));
             }
+            recurrence->addRRule(newRule);
         }
-        if (!ianaTz.isEmpty()) {
-            qCDebugNC(EWSRES_LOG) << QStringLiteral("Found IANA time zone '%1'").arg(ianaTz);
-            KTimeZone newTz = KSystemTimeZones::timeZones()->zone(ianaTz);
-            resultDt = KDateTime(currentTime.dateTime(), newTz);
-            qCDebugNC(EWSRES_LOG) << QStringLiteral("New timezone: '%1'").arg(resultDt.timeZone().name());
+        recurrence->setStartDateTime(dtStart);
+
+        Q_FOREACH(const EwsOccurrence &occ, ewsItem[EwsItemFieldDeletedOccurrences].value<EwsOccurrence::List>()) {
+            KDateTime exDt = toEventTime(occ.start(), startTz, allDay);
+            if (allDay) {
+                recurrence->addExDate(exDt.date());
+            } else {
+                recurrence->addExDateTime(exDt);
+            }
         }
     }
 
-    currentTime = resultDt;
+    return event;
+}
+
+KDateTime EwsFetchCalendarDetailJob::toEventTime(const QDateTime &dt, const KTimeZone &tz, bool allDay)
+{
+    KDateTime result(dt.toUTC(), KDateTime::UTC);
+    if (tz.isValid()) {
+        result = result.toZone(tz);
+    }
+    if (allDay) {
+        result.setDateOnly(true);
+    }
+    return result;
 }
@@ -20,9 +20,12 @@
 #ifndef EWSFETCHCALENDARDETAILJOB_H
 #define EWSFETCHCALENDARDETAILJOB_H
 
+#include <KCalCore/Event>
+
 #include "ewsfetchitemdetailjob.h"
 
 class KDateTime;
+class KTimeZone;
 
 class EwsFetchCalendarDetailJob : public EwsFetchItemDetailJob
 {
@@ -32,9 +35,16 @@ public:
     virtual ~EwsFetchCalendarDetailJob();
 protected:
     virtual void processItems(const QList<EwsGetItemRequest::Response> &responses) Q_DECL_OVERRIDE;
-    void convertTimezone(KDateTime &currentTime, QString msTimezone, QString culture);
 private Q_SLOTS:
-    void exceptionItemsFetched(KJob *job);
+    void fallbackItemsFetched(KJob *job);
+private:
+    EwsItemShape itemShape() const;
+    EwsItemShape mimeItemShape() const;
+    KCalCore::Event::Ptr eventFromProperties(const EwsItem &ewsItem);
+    KDateTime toEventTime(const QDateTime &dt, const KTimeZone &tz, bool allDay);
+
+    bool mTypedProperties;
+    QHash<QString, int> mFallbackItems;
 };
 
 #endif
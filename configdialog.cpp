@@ -167,12 +167,14 @@ void ConfigDialog::save()
     /* Erase the subscription id in case subscription is disabled or its parameters changed. This
      * fill force creation of a new subscription. */
     if (!mSubWidget->subscriptionEnabled() ||
+        (mSubWidget->allFoldersSubscribed() != mParentResource->settings()->serverSubscriptionAllFolders()) ||
         (mSubWidget->subscribedList() != mParentResource->settings()->serverSubscriptionList())) {
         mParentResource->settings()->setEventSubscriptionId(QString());
         mParentResource->settings()->setEventSubscriptionWatermark(QString());
     }
 
     mParentResource->settings()->setServerSubscription(mSubWidget->subscriptionEnabled());
+    mParentResource->settings()->setServerSubscriptionAllFolders(mSubWidget->allFoldersSubscribed());
     if (mSubWidget->subscribedListValid()) {
         mParentResource->settings()->setServerSubscriptionList(mSubWidget->subscribedList());
     }
@@ -0,0 +1,200 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ewscontactconverter.h"
+
+#include <KContacts/Addressee>
+
+#include "ewsitem.h"
+
+QList<EwsPropertyField> EwsContactConverter::contactProperties()
+{
+    static const QList<EwsPropertyField> props = {
+        EwsPropertyField("contacts:DisplayName"),
+        EwsPropertyField("contacts:GivenName"),
+        EwsPropertyField("contacts:MiddleName"),
+        EwsPropertyField("contacts:Nickname"),
+        EwsPropertyField("contacts:CompanyName"),
+        EwsPropertyField("contacts:EmailAddresses"),
+        EwsPropertyField("contacts:PhysicalAddresses"),
+        EwsPropertyField("contacts:PhoneNumbers"),
+        EwsPropertyField("contacts:AssistantName"),
+        EwsPropertyField("contacts:Birthday"),
+        EwsPropertyField("contacts:BusinessHomePage"),
+        EwsPropertyField("contacts:Department"),
+        EwsPropertyField("contacts:Generation"),
+        EwsPropertyField("contacts:ImAddresses"),
+        EwsPropertyField("contacts:JobTitle"),
+        EwsPropertyField("contacts:Manager"),
+        EwsPropertyField("contacts:OfficeLocation"),
+        EwsPropertyField("contacts:Profession"),
+        EwsPropertyField("contacts:SpouseName"),
+        EwsPropertyField("contacts:Surname"),
+        EwsPropertyField("contacts:WeddingAnniversary"),
+    };
+    return props;
+}
+
+static KContacts::PhoneNumber::Type phoneNumberType(const QString &key)
+{
+    static const QHash<QString, KContacts::PhoneNumber::Type> types = {
+        {QStringLiteral("AssistantPhone"), KContacts::PhoneNumber::Work | KContacts::PhoneNumber::Voice},
+        {QStringLiteral("BusinessFax"), KContacts::PhoneNumber::Work | KContacts::PhoneNumber::Fax},
+        {QStringLiteral("BusinessPhone"), KContacts::PhoneNumber::Work | KContacts::PhoneNumber::Voice},
+        {QStringLiteral("BusinessPhone2"), KContacts::PhoneNumber::Work | KContacts::PhoneNumber::Voice},
+        {QStringLiteral("CarPhone"), KContacts::PhoneNumber::Car},
+        {QStringLiteral("CompanyMainPhone"), KContacts::PhoneNumber::Work | KContacts::PhoneNumber::Pref},
+        {QStringLiteral("HomeFax"), KContacts::PhoneNumber::Home | KContacts::PhoneNumber::Fax},
+        {QStringLiteral("HomePhone"), KContacts::PhoneNumber::Home | KContacts::PhoneNumber::Voice},
+        {QStringLiteral("HomePhone2"), KContacts::PhoneNumber::Home | KContacts::PhoneNumber::Voice},
+        {QStringLiteral("Isdn"), KContacts::PhoneNumber::Isdn},
+        {QStringLiteral("MobilePhone"), KContacts::PhoneNumber::Cell},
+        {QStringLiteral("OtherFax"), KContacts::PhoneNumber::Fax},
+        {QStringLiteral("Pager"), KContacts::PhoneNumber::Pager},
+        {QStringLiteral("PrimaryPhone"), KContacts::PhoneNumber::Pref | KContacts::PhoneNumber::Voice},
+    };
+    return types.value(key, KContacts::PhoneNumber::Voice);
+}
+
+/* Dates such as the birthday are stored by Exchange as the local midnight of that day converted to
+ * UTC. Taking the date of the UTC value would shift it by a day for time zones east of UTC. */
+static QDate dateFromEws(const QVariant &v)
+{
+    return v.toDateTime().toLocalTime().date();
+}
+
+void EwsContactConverter::readContact(KContacts::Addressee &contact, const EwsItem &ewsItem)
+{
+    QVariant v = ewsItem[EwsItemFieldDisplayName];
+    if (v.isValid()) {
+        contact.setFormattedName(v.toString());
+    }
+    v = ewsItem[EwsItemFieldGivenName];
+    if (v.isValid()) {
+        contact.setGivenName(v.toString());
+    }
+    v = ewsItem[EwsItemFieldMiddleName];
+    if (v.isValid()) {
+        contact.setAdditionalName(v.toString());
+    }
+    v = ewsItem[EwsItemFieldSurname];
+    if (v.isValid()) {
+        contact.setFamilyName(v.toString());
+    }
+    v = ewsItem[EwsItemFieldGeneration];
+    if (v.isValid()) {
+        contact.setSuffix(v.toString());
+    }
+    v = ewsItem[EwsItemFieldNickname];
+    if (v.isValid()) {
+        contact.setNickName(v.toString());
+    }
+    v = ewsItem[EwsItemFieldCompanyName];
+    if (v.isValid()) {
+        contact.setOrganization(v.toString());
+    }
+    v = ewsItem[EwsItemFieldDepartment];
+    if (v.isValid()) {
+        contact.setDepartment(v.toString());
+    }
+    v = ewsItem[EwsItemFieldJobTitle];
+    if (v.isValid()) {
+        contact.setTitle(v.toString());
+    }
+    v = ewsItem[EwsItemFieldBusinessHomePage];
+    if (v.isValid()) {
+        contact.setUrl(QUrl(v.toString()));
+    }
+    v = ewsItem[EwsItemFieldBirthday];
+    if (v.isValid()) {
+        contact.setBirthday(dateFromEws(v));
+    }
+
+    v = ewsItem[EwsItemFieldEmailAddresses];
+    if (v.isValid()) {
+        /* Entries are keyed EmailAddress1..3 and come out of the map in that order, so the
+         * first one ends up as the preferred address. */
+        Q_FOREACH(const QString &email, v.value<EwsItem::EntryMap>()) {
+            contact.insertEmail(email, contact.emails().isEmpty());
+        }
+    }
+
+    v = ewsItem[EwsItemFieldPhoneNumbers];
+    if (v.isValid()) {
+        const EwsItem::EntryMap numbers = v.value<EwsItem::EntryMap>();
+        for (auto it = numbers.cbegin(); it != numbers.cend(); ++it) {
+            contact.insertPhoneNumber(KContacts::PhoneNumber(*it, phoneNumberType(it.key())));
+        }
+    }
+
+    v = ewsItem[EwsItemFieldPhysicalAddresses];
+    if (v.isValid()) {
+        const EwsItem::PhysicalAddressMap addresses = v.value<EwsItem::PhysicalAddressMap>();
+        for (auto it = addresses.cbegin(); it != addresses.cend(); ++it) {
+            KContacts::Address::Type type;
+            if (it.key() == QStringLiteral("Business")) {
+                type = KContacts::Address::Work;
+            } else if (it.key() == QStringLiteral("Home")) {
+                type = KContacts::Address::Home;
+            } else {
+                type = KContacts::Address::Postal;
+            }
+            KContacts::Address addr(type);
+            addr.setStreet(it->value(QStringLiteral("Street")));
+            addr.setLocality(it->value(QStringLiteral("City")));
+            addr.setRegion(it->value(QStringLiteral("State")));
+            addr.setCountry(it->value(QStringLiteral("CountryOrRegion")));
+            addr.setPostalCode(it->value(QStringLiteral("PostalCode")));
+            contact.insertAddress(addr);
+        }
+    }
+
+    v = ewsItem[EwsItemFieldImAddresses];
+    if (v.isValid()) {
+        /* KAddressBook keeps a single IM address field, so store all of them there. */
+        const QStringList ims = v.value<EwsItem::EntryMap>().values();
+        contact.insertCustom(QStringLiteral("KADDRESSBOOK"), QStringLiteral("X-IMAddress"),
+                             ims.join(QStringLiteral(", ")));
+    }
+
+    /* Fields without a native vCard counterpart are stored the same way KAddressBook does. */
+    static const QVector<QPair<EwsItemFields, QString>> customFields = {
+        {EwsItemFieldAssistantName, QStringLiteral("X-AssistantsName")},
+        {EwsItemFieldManager, QStringLiteral("X-ManagersName")},
+        {EwsItemFieldOfficeLocation, QStringLiteral("X-Office")},
+        {EwsItemFieldProfession, QStringLiteral("X-Profession")},
+        {EwsItemFieldSpouseName, QStringLiteral("X-SpousesName")},
+    };
+    for (const auto &field : customFields) {
+        v = ewsItem[field.first];
+        if (v.isValid()) {
+            contact.insertCustom(QStringLiteral("KADDRESSBOOK"), field.second, v.toString());
+        }
+    }
+    v = ewsItem[EwsItemFieldWeddingAnniversary];
+    if (v.isValid()) {
+        contact.insertCustom(QStringLiteral("KADDRESSBOOK"), QStringLiteral("X-Anniversary"),
+                             dateFromEws(v).toString(Qt::ISODate));
+    }
+
+    v = ewsItem[EwsItemFieldBody];
+    if (v.isValid()) {
+        contact.setNote(v.toString());
+    }
+}
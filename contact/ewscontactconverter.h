@@ -0,0 +1,45 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#ifndef EWSCONTACTCONVERTER_H
+#define EWSCONTACTCONVERTER_H
+
+#include <QList>
+
+#include "ewspropertyfield.h"
+
+namespace KContacts {
+class Addressee;
+}
+class EwsItem;
+
+/**
+ *  @brief  Conversion of EWS contact items into KContacts::Addressee objects
+ *
+ *  Used for contacts which have no MIME content to parse. The properties returned by
+ *  contactProperties() need to be requested from the server for the conversion to be complete.
+ */
+class EwsContactConverter
+{
+public:
+    static QList<EwsPropertyField> contactProperties();
+    static void readContact(KContacts::Addressee &contact, const EwsItem &ewsItem);
+};
+
+#endif
@@ -21,10 +21,14 @@
 
 #include <KContacts/Addressee>
 #include <KContacts/ContactGroup>
+#include <KContacts/VCardConverter>
+#include <AkonadiCore/Item>
 
+#include "ewscontactconverter.h"
 #include "ewsfetchcontactdetailjob.h"
 #include "ewsmodifycontactjob.h"
 #include "ewscreatecontactjob.h"
+#include "ewsclient_debug.h"
 
 using namespace Akonadi;
 
@@ -60,8 +64,21 @@ QString EwsContactHandler::mimeType()
 
 bool EwsContactHandler::setItemPayload(Akonadi::Item &item, const EwsItem &ewsItem)
 {
-    Q_UNUSED(item)
-    Q_UNUSED(ewsItem)
+    KContacts::Addressee contact;
+
+    QVariant v = ewsItem[EwsItemFieldMimeContent];
+    if (v.isValid()) {
+        KContacts::VCardConverter conv;
+        contact = conv.parseVCard(v.toByteArray());
+        if (contact.isEmpty()) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to parse vCard for item %1").arg(item.remoteId());
+            return false;
+        }
+    } else {
+        EwsContactConverter::readContact(contact, ewsItem);
+    }
+
+    item.setPayload<KContacts::Addressee>(contact);
 
     return true;
 }
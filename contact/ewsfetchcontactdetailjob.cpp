@@ -18,9 +18,12 @@
 */
 
 #include "ewsfetchcontactdetailjob.h"
+
+#include <KContacts/Addressee>
+
 #include "ewsitemshape.h"
 #include "ewsgetitemrequest.h"
-#include "ewsmailbox.h"
+#include "ewscontactconverter.h"
 #include "ewsclient_debug.h"
 
 using namespace Akonadi;
@@ -29,6 +32,11 @@ EwsFetchContactDetailJob::EwsFetchContactDetailJob(EwsClient &client, QObject *p
     : EwsFetchItemDetailJob(client, parent, collection)
 {
     EwsItemShape shape(EwsShapeIdOnly);
+    shape.setBodyType(EwsItemShape::BodyText);
+    shape << EwsPropertyField("item:Body");
+    Q_FOREACH(const EwsPropertyField &field, EwsContactConverter::contactProperties()) {
+        shape << field;
+    }
     mRequest->setItemShape(shape);
 }
 
@@ -46,15 +54,18 @@ void EwsFetchContactDetailJob::processItems(const QList<EwsGetItemRequest::Respo
 
         if (!resp.isSuccess()) {
             qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to fetch item %1").arg(item.remoteId());
+            ++it;
             continue;
         }
 
-        //const EwsItem &ewsItem = resp.item();
-
-        // TODO: Implement
+        KContacts::Addressee contact;
+        EwsContactConverter::readContact(contact, resp.item());
+        item.setPayload<KContacts::Addressee>(contact);
 
         ++it;
     }
 
+    qCDebugNC(EWSRES_LOG) << "EwsFetchContactDetailJob::processItems: done";
+
     emitResult();
 }
@@ -0,0 +1,256 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ewsapplyitemeventsjob.h"
+
+#include <AkonadiCore/CollectionFetchJob>
+#include <AkonadiCore/CollectionFetchScope>
+#include <AkonadiCore/ItemCreateJob>
+#include <AkonadiCore/ItemDeleteJob>
+#include <AkonadiCore/ItemFetchJob>
+#include <AkonadiCore/ItemFetchScope>
+#include <AkonadiCore/ItemModifyJob>
+#include <AkonadiCore/ItemMoveJob>
+
+#include "ewsfetchitemdetailjob.h"
+#include "ewsgetitemrequest.h"
+#include "ewsitemhandler.h"
+#include "ewsresource.h"
+#include "ewsclient_debug.h"
+
+using namespace Akonadi;
+
+EwsApplyItemEventsJob::EwsApplyItemEventsJob(EwsClient &client,
+                                             const EwsSubscriptionManager::ItemEventList &events,
+                                             EwsResource *parent)
+    : EwsJob(parent), mClient(client), mResource(parent), mEvents(events)
+{
+}
+
+EwsApplyItemEventsJob::~EwsApplyItemEventsJob()
+{
+}
+
+void EwsApplyItemEventsJob::addEvents(const EwsSubscriptionManager::ItemEventList &events)
+{
+    mEvents += events;
+}
+
+void EwsApplyItemEventsJob::start()
+{
+    processNextEvent();
+}
+
+void EwsApplyItemEventsJob::processNextEvent()
+{
+    if (mEvents.isEmpty()) {
+        emitResult();
+        return;
+    }
+
+    mEvent = mEvents.takeFirst();
+    mItem = Item();
+
+    Collection::List missing;
+    if (!mCollections.contains(mEvent.folderId.id())) {
+        Collection c;
+        c.setRemoteId(mEvent.folderId.id());
+        missing.append(c);
+    }
+    if (mEvent.oldFolderId.type() == EwsId::Real && !mCollections.contains(mEvent.oldFolderId.id())) {
+        Collection c;
+        c.setRemoteId(mEvent.oldFolderId.id());
+        missing.append(c);
+    }
+
+    if (missing.isEmpty()) {
+        applyEvent();
+    } else {
+        CollectionFetchJob *job = new CollectionFetchJob(missing, CollectionFetchJob::Base, this);
+        job->fetchScope().setResource(mResource->identifier());
+        connect(job, &CollectionFetchJob::result, this, &EwsApplyItemEventsJob::collectionsFetched);
+    }
+}
+
+void EwsApplyItemEventsJob::collectionsFetched(KJob *job)
+{
+    if (job->error()) {
+        eventFailed(job->errorString());
+        return;
+    }
+
+    CollectionFetchJob *fetchJob = qobject_cast<CollectionFetchJob*>(job);
+    Q_ASSERT(fetchJob);
+    Q_FOREACH(const Collection &col, fetchJob->collections()) {
+        mCollections.insert(col.remoteId(), col);
+    }
+
+    if (!mCollections.contains(mEvent.folderId.id())
+        || (mEvent.oldFolderId.type() == EwsId::Real && !mCollections.contains(mEvent.oldFolderId.id()))) {
+        eventFailed(QStringLiteral("Collection not found"));
+        return;
+    }
+
+    applyEvent();
+}
+
+void EwsApplyItemEventsJob::applyEvent()
+{
+    switch (mEvent.type) {
+    case EwsNewMailEvent:
+    case EwsCreatedEvent:
+    {
+        /* The event doesn't tell what kind of item has been created. */
+        EwsGetItemRequest *req = new EwsGetItemRequest(mClient, this);
+        req->setItemIds(EwsId::List() << mEvent.itemId);
+        req->setItemShape(EwsItemShape(EwsShapeIdOnly));
+        connect(req, &EwsGetItemRequest::result, this, &EwsApplyItemEventsJob::itemTypeFetched);
+        req->start();
+        break;
+    }
+    case EwsDeletedEvent:
+    case EwsMovedEvent:
+    {
+        bool moved = mEvent.type == EwsMovedEvent;
+        Item item;
+        item.setRemoteId(moved ? mEvent.oldItemId.id() : mEvent.itemId.id());
+        ItemFetchJob *job = new ItemFetchJob(item, this);
+        job->setCollection(mCollections[moved ? mEvent.oldFolderId.id() : mEvent.folderId.id()]);
+        job->fetchScope().setCacheOnly(true);
+        job->fetchScope().fetchFullPayload(false);
+        connect(job, &ItemFetchJob::result, this, &EwsApplyItemEventsJob::itemFetched);
+        break;
+    }
+    default:
+        eventFailed(QStringLiteral("Unsupported event type %1").arg(mEvent.type));
+        break;
+    }
+}
+
+void EwsApplyItemEventsJob::itemTypeFetched(KJob *job)
+{
+    EwsGetItemRequest *req = qobject_cast<EwsGetItemRequest*>(job);
+    if (job->error() || !req || req->responses().size() != 1 || !req->responses().first().isSuccess()) {
+        eventFailed(QStringLiteral("Failed to retrieve item"));
+        return;
+    }
+
+    /* Meeting messages and other kinds of items need more than the message headers. Leave them to
+     * the folder sync. */
+    EwsItemType type = req->responses().first().item().internalType();
+    if (type != EwsItemTypeMessage) {
+        eventFailed(QStringLiteral("Item type %1 not applied directly").arg(type));
+        return;
+    }
+
+    /* Only the headers are retrieved, just as for a regular folder sync. */
+    EwsItemHandler *handler = EwsItemHandler::itemHandler(type);
+    const Collection &col = mCollections[mEvent.folderId.id()];
+    Item item(handler->mimeType());
+    item.setParentCollection(col);
+    item.setRemoteId(mEvent.itemId.id());
+    item.setRemoteRevision(mEvent.itemId.changeKey());
+    EwsFetchItemDetailJob *detailJob = handler->fetchItemDetailJob(mClient, this, col);
+    detailJob->setItemLists(Item::List() << item, Q_NULLPTR);
+    connect(detailJob, &EwsFetchItemDetailJob::result, this, &EwsApplyItemEventsJob::itemDetailFetched);
+    detailJob->start();
+}
+
+void EwsApplyItemEventsJob::itemDetailFetched(KJob *job)
+{
+    EwsFetchItemDetailJob *detailJob = qobject_cast<EwsFetchItemDetailJob*>(job);
+    if (job->error() || !detailJob || detailJob->changedItems().isEmpty()
+        || !detailJob->changedItems().first().hasPayload()) {
+        eventFailed(QStringLiteral("Failed to retrieve item details"));
+        return;
+    }
+
+    /* Merge by remote identifier in case a concurrent folder sync has already added the item. */
+    const Item &item = detailJob->changedItems().first();
+    ItemCreateJob *createJob = new ItemCreateJob(item, mCollections[mEvent.folderId.id()], this);
+    createJob->setMerge(ItemCreateJob::RID);
+    connect(createJob, &ItemCreateJob::result, this, &EwsApplyItemEventsJob::itemApplied);
+}
+
+void EwsApplyItemEventsJob::itemFetched(KJob *job)
+{
+    ItemFetchJob *fetchJob = qobject_cast<ItemFetchJob*>(job);
+    if (job->error() || !fetchJob || fetchJob->items().isEmpty()) {
+        eventFailed(QStringLiteral("Item not found in local store"));
+        return;
+    }
+
+    mItem = fetchJob->items().first();
+    if (mEvent.type == EwsDeletedEvent) {
+        ItemDeleteJob *deleteJob = new ItemDeleteJob(mItem, this);
+        connect(deleteJob, &ItemDeleteJob::result, this, &EwsApplyItemEventsJob::itemApplied);
+    } else {
+        ItemMoveJob *moveJob = new ItemMoveJob(mItem, mCollections[mEvent.folderId.id()], this);
+        connect(moveJob, &ItemMoveJob::result, this, &EwsApplyItemEventsJob::itemMoved);
+    }
+}
+
+void EwsApplyItemEventsJob::itemMoved(KJob *job)
+{
+    if (job->error()) {
+        eventFailed(job->errorString());
+        return;
+    }
+
+    /* Exchange assigns a new identifier to a moved item. */
+    mItem.setParentCollection(mCollections[mEvent.folderId.id()]);
+    mItem.setRemoteId(mEvent.itemId.id());
+    mItem.setRemoteRevision(mEvent.itemId.changeKey());
+    ItemModifyJob *modifyJob = new ItemModifyJob(mItem, this);
+    modifyJob->disableRevisionCheck();
+    modifyJob->setIgnorePayload(true);
+    connect(modifyJob, &ItemModifyJob::result, this, &EwsApplyItemEventsJob::itemApplied);
+}
+
+void EwsApplyItemEventsJob::itemApplied(KJob *job)
+{
+    if (job->error()) {
+        eventFailed(job->errorString());
+        return;
+    }
+
+    if (mEvent.type == EwsDeletedEvent) {
+        mRemovedItems[mEvent.folderId.id()].append(mEvent.itemId.id());
+    } else if (mEvent.type == EwsMovedEvent) {
+        mRemovedItems[mEvent.oldFolderId.id()].append(mEvent.oldItemId.id());
+    }
+
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Applied event %1 for item %2").arg(mEvent.type)
+                    .arg(ewsHash(mEvent.itemId.id()));
+
+    processNextEvent();
+}
+
+void EwsApplyItemEventsJob::eventFailed(const QString &reason)
+{
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Failed to apply event %1 for item %2: %3").arg(mEvent.type)
+                    .arg(ewsHash(mEvent.itemId.id())).arg(reason);
+
+    mFailedFolders.append(mEvent.folderId);
+    if (mEvent.oldFolderId.type() == EwsId::Real) {
+        mFailedFolders.append(mEvent.oldFolderId);
+    }
+
+    processNextEvent();
+}
@@ -0,0 +1,91 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#ifndef EWSAPPLYITEMEVENTSJOB_H
+#define EWSAPPLYITEMEVENTSJOB_H
+
+#include <QHash>
+#include <QStringList>
+
+#include <AkonadiCore/Collection>
+#include <AkonadiCore/Item>
+
+#include "ewsid.h"
+#include "ewsjob.h"
+#include "ewssubscriptionmanager.h"
+
+class EwsClient;
+class EwsResource;
+
+/**
+ *  @brief  Job applying item change events directly to the Akonadi database
+ *
+ *  This job takes a list of item events reported by the subscription manager and applies each of
+ *  them to Akonadi without synchronizing the affected folders:
+ *   - for new messages the headers are retrieved and the item is created in Akonadi (other kinds
+ *     of new items, such as meeting requests, are left to the folder sync),
+ *   - for deleted items the local copy is removed,
+ *   - for moved items the local copy is moved to the destination collection and its remote
+ *     identifier is updated.
+ *
+ *  Events are processed one at a time in the order in which they were received. Further events can
+ *  be added while the job is still running. Whenever an event cannot be applied (for example when
+ *  the item is not present in the local store) the folders concerned are added to the list of
+ *  failed folders, which the caller is expected to synchronize the regular way.
+ *
+ *  As the server will also report the applied deletions and moves during the next incremental sync
+ *  of the source folder the list of removed items is available for the caller to queue.
+ */
+class EwsApplyItemEventsJob : public EwsJob
+{
+    Q_OBJECT
+public:
+    EwsApplyItemEventsJob(EwsClient &client, const EwsSubscriptionManager::ItemEventList &events,
+                          EwsResource *parent);
+    virtual ~EwsApplyItemEventsJob();
+
+    void addEvents(const EwsSubscriptionManager::ItemEventList &events);
+
+    const EwsId::List &failedFolders() const { return mFailedFolders; };
+    const QHash<QString, QStringList> &removedItems() const { return mRemovedItems; };
+
+    virtual void start() Q_DECL_OVERRIDE;
+private Q_SLOTS:
+    void collectionsFetched(KJob *job);
+    void itemTypeFetched(KJob *job);
+    void itemDetailFetched(KJob *job);
+    void itemFetched(KJob *job);
+    void itemMoved(KJob *job);
+    void itemApplied(KJob *job);
+private:
+    void processNextEvent();
+    void applyEvent();
+    void eventFailed(const QString &reason);
+
+    EwsClient &mClient;
+    EwsResource *mResource;
+    EwsSubscriptionManager::ItemEventList mEvents;
+    EwsSubscriptionManager::ItemEvent mEvent;
+    Akonadi::Item mItem;
+    QHash<QString, Akonadi::Collection> mCollections;
+    EwsId::List mFailedFolders;
+    QHash<QString, QStringList> mRemovedItems;
+};
+
+#endif
@@ -37,30 +37,36 @@ EwsDeleteItemRequest::~EwsDeleteItemRequest()
 
 void EwsDeleteItemRequest::start()
 {
-    QString reqString;
-    QXmlStreamWriter writer(&reqString);
+    int pos = 0;
+    do {
+        const EwsId::List ids = mIds.mid(pos, chunkSize());
+        pos += chunkSize();
 
-    startSoapDocument(writer);
+        QString reqString;
+        QXmlStreamWriter writer(&reqString);
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("DeleteItem"));
+        startSoapDocument(writer);
 
-    writer.writeAttribute(QStringLiteral("DeleteType"), deleteTypes[mType]);
+        writer.writeStartElement(ewsMsgNsUri, QStringLiteral("DeleteItem"));
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ItemIds"));
-    Q_FOREACH(const EwsId &id, mIds) {
-        id.writeItemIds(writer);
-    }
-    writer.writeEndElement();
+        writer.writeAttribute(QStringLiteral("DeleteType"), deleteTypes[mType]);
+
+        writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ItemIds"));
+        Q_FOREACH(const EwsId &id, ids) {
+            id.writeItemIds(writer);
+        }
+        writer.writeEndElement();
 
-    writer.writeEndElement();
+        writer.writeEndElement();
 
-    endSoapDocument(writer);
+        endSoapDocument(writer);
 
-    qCDebugNCS(EWSRES_REQUEST_LOG) << QStringLiteral("Starting DeleteItem request (") << mIds << ")";
+        qCDebugNCS(EWSRES_REQUEST_LOG) << QStringLiteral("Starting DeleteItem request (") << ids << ")";
 
-    qCDebug(EWSRES_PROTO_LOG) << reqString;
+        qCDebug(EWSRES_PROTO_LOG) << reqString;
 
-    prepare(reqString);
+        prepare(reqString);
+    } while (pos < mIds.size());
 
     doSend();
 }
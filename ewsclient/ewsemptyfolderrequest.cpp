@@ -0,0 +1,120 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ewsemptyfolderrequest.h"
+#include "ewsclient_debug.h"
+
+static const QVector<QString> deleteTypes = {
+    QStringLiteral("HardDelete"),
+    QStringLiteral("SoftDelete"),
+    QStringLiteral("MoveToDeletedItems")
+};
+
+EwsEmptyFolderRequest::EwsEmptyFolderRequest(EwsClient &client, QObject *parent)
+    : EwsRequest(client, parent), mType(SoftDelete), mDeleteSubFolders(false)
+{
+}
+
+EwsEmptyFolderRequest::~EwsEmptyFolderRequest()
+{
+}
+
+void EwsEmptyFolderRequest::start()
+{
+    QString reqString;
+    QXmlStreamWriter writer(&reqString);
+
+    if (!serverVersion().supports(EwsServerVersion::EmptyFolder)) {
+        setServerVersion(EwsServerVersion::minSupporting(EwsServerVersion::EmptyFolder));
+    }
+
+    startSoapDocument(writer);
+
+    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("EmptyFolder"));
+
+    writer.writeAttribute(QStringLiteral("DeleteType"), deleteTypes[mType]);
+    writer.writeAttribute(QStringLiteral("DeleteSubFolders"),
+                          mDeleteSubFolders ? QStringLiteral("true") : QStringLiteral("false"));
+
+    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("FolderIds"));
+    Q_FOREACH(const EwsId &id, mIds) {
+        id.writeFolderIds(writer);
+    }
+    writer.writeEndElement();
+
+    writer.writeEndElement();
+
+    endSoapDocument(writer);
+
+    qCDebugNCS(EWSRES_REQUEST_LOG) << QStringLiteral("Starting EmptyFolder request (") << mIds << ")";
+
+    qCDebug(EWSRES_PROTO_LOG) << reqString;
+
+    prepare(reqString);
+
+    doSend();
+}
+
+bool EwsEmptyFolderRequest::parseResult(QXmlStreamReader &reader)
+{
+    return parseResponseMessage(reader, QStringLiteral("EmptyFolder"),
+                                [this](QXmlStreamReader &reader) {return parseItemsResponse(reader);});
+}
+
+bool EwsEmptyFolderRequest::parseItemsResponse(QXmlStreamReader &reader)
+{
+    Response resp(reader);
+    if (resp.responseClass() == EwsResponseUnknown) {
+        return false;
+    }
+
+    if (EWSRES_REQUEST_LOG().isDebugEnabled()) {
+        if (resp.isSuccess()) {
+            qCDebug(EWSRES_REQUEST_LOG) << QStringLiteral("Got EmptyFolder response - OK");
+        }
+        else {
+            qCDebug(EWSRES_REQUEST_LOG) << QStringLiteral("Got EmptyFolder response - %1")
+                            .arg(resp.responseMessage());
+        }
+    }
+
+    mResponses.append(resp);
+    return true;
+}
+
+EwsEmptyFolderRequest::Response::Response(QXmlStreamReader &reader)
+    : EwsRequest::Response::Response(reader)
+{
+    if (mClass == EwsResponseParseError) {
+        return;
+    }
+
+    while (reader.readNextStartElement()) {
+        if (reader.namespaceUri() != ewsMsgNsUri && reader.namespaceUri() != ewsTypeNsUri) {
+            setErrorMsg(QStringLiteral("Unexpected namespace in %1 element: %2")
+                .arg(QStringLiteral("ResponseMessage")).arg(reader.namespaceUri().toString()));
+            return;
+        }
+
+        if (!readResponseElement(reader)) {
+            setErrorMsg(QStringLiteral("Failed to read EWS request - invalid response element."));
+            return;
+        }
+    }
+}
@@ -126,6 +126,18 @@ EwsEventRequestBase::Response::Response(QXmlStreamReader &reader)
         else if (reader.name() == QStringLiteral("ConnectionStatus")) {
             reader.skipCurrentElement();
         }
+        else if (reader.name() == QStringLiteral("ErrorSubscriptionIds")) {
+            /* When multiple subscriptions are retrieved at once this element lists the ones that
+             * caused the error. */
+            while (reader.readNextStartElement()) {
+                if (reader.name() == QStringLiteral("SubscriptionId")) {
+                    mErrorSubscriptionIds.append(reader.readElementText());
+                }
+                else {
+                    reader.skipCurrentElement();
+                }
+            }
+        }
         else if (!readResponseElement(reader)) {
             setErrorMsg(QStringLiteral("Failed to read EWS request - invalid response element '%1'")
                 .arg(reader.name().toString()));
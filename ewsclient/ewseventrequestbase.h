@@ -23,6 +23,7 @@
 #include <QDateTime>
 #include <QList>
 #include <QSharedPointer>
+#include <QStringList>
 
 #include "ewsid.h"
 #include "ewsrequest.h"
@@ -97,11 +98,13 @@ public:
     {
     public:
         const Notification::List &notifications() const { return mNotifications; };
+        const QStringList &errorSubscriptionIds() const { return mErrorSubscriptionIds; };
         bool operator==(const Response &other) const;
     protected:
         Response(QXmlStreamReader &reader);
 
         Notification::List mNotifications;
+        QStringList mErrorSubscriptionIds;
 
         friend class EwsEventRequestBase;
     };
@@ -50,7 +50,7 @@ public:
 EwsFindItemRequest::EwsFindItemRequest(EwsClient& client, QObject *parent)
     : EwsRequest(client, parent), mTraversal(EwsTraversalShallow), mPagination(false),
       mPageBasePoint(EwsBasePointBeginning), mPageOffset(0), mFractional(false), mMaxItems(-1),
-      mFracNumerator(0), mFracDenominator(0), mTotalItems(0), mNextOffset(-1), mNextNumerator(-1),
+      mFracNumerator(0), mFracDenominator(0), mCalendarView(false), mTotalItems(0), mNextOffset(-1), mNextNumerator(-1),
       mNextDenominator(-1), mIncludesLastItem(false)
 {
 }
@@ -100,6 +100,15 @@ void EwsFindItemRequest::start()
         writer.writeAttribute(QStringLiteral("Denominator"), QString::number(mFracDenominator));
         writer.writeEndElement();
     }
+    else if (mCalendarView) {
+        writer.writeStartElement(ewsMsgNsUri, QStringLiteral("CalendarView"));
+        if (mMaxItems > 0) {
+            writer.writeAttribute(QStringLiteral("MaxEntriesReturned"), QString::number(mMaxItems));
+        }
+        writer.writeAttribute(QStringLiteral("StartDate"), mViewStart.toUTC().toString(Qt::ISODate));
+        writer.writeAttribute(QStringLiteral("EndDate"), mViewEnd.toUTC().toString(Qt::ISODate));
+        writer.writeEndElement();
+    }
 
     writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ParentFolderIds"));
     mFolderId.writeFolderIds(writer);
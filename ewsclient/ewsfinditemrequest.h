@@ -20,6 +20,8 @@
 #ifndef EWSFINDITEMREQUEST_H
 #define EWSFINDITEMREQUEST_H
 
+#include <QDateTime>
+
 #include "ewsitem.h"
 #include "ewsrequest.h"
 #include "ewstypes.h"
@@ -38,6 +40,7 @@ public:
     void setPagination(EwsIndexedViewBasePoint basePoint, unsigned offset, int maxItems = -1)
     {
         mFractional = false;
+        mCalendarView = false;
         mMaxItems = maxItems;
         mPageBasePoint = basePoint;
         mPageOffset = offset;
@@ -46,11 +49,23 @@ public:
     void setFractional(unsigned numerator, unsigned denominator, int maxItems = -1)
     {
         mPagination = false;
+        mCalendarView = false;
         mMaxItems = maxItems;
         mFracNumerator = numerator;
         mFracDenominator = denominator;
         mFractional = true;
     }
+    /* Restricts the result to calendar items within the given time window. Recurring items are
+     * expanded into their individual occurrences and exceptions. */
+    void setCalendarView(const QDateTime &start, const QDateTime &end, int maxItems = -1)
+    {
+        mPagination = false;
+        mFractional = false;
+        mMaxItems = maxItems;
+        mViewStart = start;
+        mViewEnd = end;
+        mCalendarView = true;
+    }
 
     virtual void start() Q_DECL_OVERRIDE;
 
@@ -74,6 +89,9 @@ private:
     int mMaxItems;
     unsigned mFracNumerator;
     unsigned mFracDenominator;
+    bool mCalendarView;
+    QDateTime mViewStart;
+    QDateTime mViewEnd;
     QList<EwsItem> mItems;
     unsigned mTotalItems;
     int mNextOffset;
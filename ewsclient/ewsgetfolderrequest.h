@@ -44,6 +44,7 @@ public:
     virtual ~EwsGetFolderRequest();
 
     void setFolderIds(const EwsId::List &ids);
+    const EwsId::List &folderIds() const { return mIds; };
     void setFolderShape(const EwsFolderShape &shape);
 
     virtual void start() Q_DECL_OVERRIDE;
@@ -41,24 +41,23 @@ void EwsGetItemRequest::setItemShape(const EwsItemShape &shape)
 
 void EwsGetItemRequest::start()
 {
-    QString reqString;
-    QXmlStreamWriter writer(&reqString);
+    QString reqString = soapDocument(QStringLiteral("GetItem"), mShape,
+        [this](QXmlStreamWriter &writer) {
+            writer.writeStartElement(ewsMsgNsUri, QStringLiteral("GetItem"));
 
-    startSoapDocument(writer);
+            mShape.write(writer);
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("GetItem"));
+            writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ItemIds"));
+            writeSplicePoint(writer);
+            writer.writeEndElement();
 
-    mShape.write(writer);
-
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ItemIds"));
-    Q_FOREACH(const EwsId &id, mIds) {
-        id.writeItemIds(writer);
-    }
-    writer.writeEndElement();
-
-    writer.writeEndElement();
-
-    endSoapDocument(writer);
+            writer.writeEndElement();
+        },
+        [this](QXmlStreamWriter &writer) {
+            Q_FOREACH(const EwsId &id, mIds) {
+                id.writeItemIds(writer);
+            }
+        });
 
     qCDebug(EWSRES_PROTO_LOG) << reqString;
 
@@ -20,18 +20,15 @@
 #include "ewsgetstreamingeventsrequest.h"
 
 #include <QTemporaryFile>
+#include <QTextCodec>
 
 #include "ewsclient_debug.h"
 #include "ewsxml.h"
 
-static Q_CONSTEXPR uint respChunkTimeout = 250; /* ms */
-
 EwsGetStreamingEventsRequest::EwsGetStreamingEventsRequest(EwsClient &client, QObject *parent)
     : EwsEventRequestBase(client, QStringLiteral("GetStreamingEvents"), parent), mTimeout(30),
-      mRespTimer(this)
+      mDecoder(QTextCodec::codecForName("UTF-8")->makeDecoder()), mDepth(0), mEnvelopeCount(0)
 {
-    mRespTimer.setInterval(respChunkTimeout);
-    connect(&mRespTimer, &QTimer::timeout, this, &EwsGetStreamingEventsRequest::requestDataTimeout);
 }
 
 EwsGetStreamingEventsRequest::~EwsGetStreamingEventsRequest()
@@ -51,8 +48,15 @@ void EwsGetStreamingEventsRequest::start()
 
     writer.writeStartElement(ewsMsgNsUri, QStringLiteral("GetStreamingEvents"));
 
+    QStringList ids = mSubscriptionIds;
+    if (ids.isEmpty()) {
+        ids.append(mSubscriptionId);
+    }
+
     writer.writeStartElement(ewsMsgNsUri, QStringLiteral("SubscriptionIds"));
-    writer.writeTextElement(ewsTypeNsUri, QStringLiteral("SubscriptionId"), mSubscriptionId);
+    Q_FOREACH(const QString &id, ids) {
+        writer.writeTextElement(ewsTypeNsUri, QStringLiteral("SubscriptionId"), id);
+    }
     writer.writeEndElement();
 
     writer.writeTextElement(ewsMsgNsUri, QStringLiteral("ConnectionTimeout"), QString::number(mTimeout));
@@ -61,8 +65,14 @@ void EwsGetStreamingEventsRequest::start()
 
     endSoapDocument(writer);
 
-    qCDebugNC(EWSRES_REQUEST_LOG) << QStringLiteral("Starting GetStreamingEvents request (subId: %1, timeout: %2)")
-                    .arg(ewsHash(mSubscriptionId)).arg(mTimeout);
+    if (EWSRES_REQUEST_LOG().isDebugEnabled()) {
+        QStringList hashes;
+        Q_FOREACH(const QString &id, ids) {
+            hashes.append(ewsHash(id));
+        }
+        qCDebugNC(EWSRES_REQUEST_LOG) << QStringLiteral("Starting GetStreamingEvents request (subIds: %1, timeout: %2)")
+                        .arg(hashes.join(QStringLiteral(","))).arg(mTimeout);
+    }
 
     qCDebug(EWSRES_PROTO_LOG) << reqString;
 
@@ -73,44 +83,85 @@ void EwsGetStreamingEventsRequest::start()
 
 void EwsGetStreamingEventsRequest::requestData(KIO::Job *job, const QByteArray &data)
 {
-    Q_UNUSED(job);
-
-    mRespTimer.stop();
     qCDebug(EWSRES_PROTO_LOG) << "data" << job << data;
-    mResponseData += QString::fromUtf8(data);
-    mRespTimer.start();
+
+    /* Use a stateful decoder as the data may be split in the middle of a multi-byte sequence. */
+    const QString text = mDecoder->toUnicode(data);
+    mResponseData += text;
+    mScanner.addData(text);
+
+    while (!mScanner.atEnd()) {
+        QXmlStreamReader::TokenType token = mScanner.readNext();
+        if (token == QXmlStreamReader::StartElement) {
+            mDepth++;
+        }
+        else if (token == QXmlStreamReader::EndElement && --mDepth == 0) {
+            /* A complete envelope has been received - process it right away and restart the
+             * scanner with whatever data has been received past its end. */
+            int end = mScanner.characterOffset();
+            QString envelope = mResponseData.left(end);
+            int next = end;
+            while (next < mResponseData.size() && mResponseData.at(next).isSpace()) {
+                next++;
+            }
+            mResponseData.remove(0, next);
+            mScanner.clear();
+            mScanner.addData(mResponseData);
+
+            if (!processEnvelope(envelope)) {
+                Q_FOREACH(KJob *subjob, subjobs()) {
+                    removeSubjob(subjob);
+                    subjob->kill();
+                }
+                emitResult();
+                return;
+            }
+        }
+        else if (token == QXmlStreamReader::Invalid) {
+            if (mScanner.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
+                /* Let the response be parsed once it completes in order to report the error. */
+                qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to parse streaming response: %1")
+                                .arg(mScanner.errorString());
+            }
+            break;
+        }
+    }
 }
 
-void EwsGetStreamingEventsRequest::requestDataTimeout()
+bool EwsGetStreamingEventsRequest::processEnvelope(const QString &envelope)
 {
-    if (mResponseData.isEmpty()) {
-        return;
-    }
     if (EWSRES_PROTO_LOG().isDebugEnabled()) {
         ewsLogDir.setAutoRemove(false);
         if (ewsLogDir.isValid()) {
             QTemporaryFile dumpFile(ewsLogDir.path() + "/ews_xmldump_XXXXXXX.xml");
             dumpFile.open();
             dumpFile.setAutoRemove(false);
-            dumpFile.write(mResponseData.toUtf8());
+            dumpFile.write(envelope.toUtf8());
             qCDebug(EWSRES_PROTO_LOG) << "response dumped to" << dumpFile.fileName();
             dumpFile.close();
         }
     }
 
-    QXmlStreamReader reader(mResponseData);
+    QXmlStreamReader reader(envelope);
     if (!readResponse(reader)) {
-        Q_FOREACH(KJob *job, subjobs()) {
-            removeSubjob(job);
-            job->kill();
-        }
-        emitResult();
+        return false;
     }
-    else {
-        Q_EMIT eventsReceived(this);
+
+    mEnvelopeCount++;
+    Q_EMIT eventsReceived(this);
+    return true;
+}
+
+void EwsGetStreamingEventsRequest::requestResult(KJob *job)
+{
+    /* All complete envelopes have already been processed as they arrived. Unless the request failed
+     * or the connection was closed in the middle of an envelope there is nothing more to parse. */
+    if (job->error() == 0 && mEnvelopeCount > 0 && mResponseData.trimmed().isEmpty()) {
+        emitResult();
+        return;
     }
 
-    mResponseData.clear();
+    EwsEventRequestBase::requestResult(job);
 }
 
 void EwsGetStreamingEventsRequest::eventsProcessed(const Response &resp)
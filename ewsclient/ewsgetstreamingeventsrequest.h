@@ -21,14 +21,16 @@
 #define EWSGETSTREAMINGEVENTSREQUEST_H
 
 #include <QList>
+#include <QScopedPointer>
 #include <QSharedPointer>
-#include <QTimer>
+#include <QStringList>
+#include <QXmlStreamReader>
 
 #include "ewseventrequestbase.h"
 #include "ewsid.h"
 #include "ewstypes.h"
 
-class QXmlStreamReader;
+class QTextDecoder;
 class QXmlStreamWriter;
 
 class EwsGetStreamingEventsRequest : public EwsEventRequestBase
@@ -39,6 +41,7 @@ public:
     virtual ~EwsGetStreamingEventsRequest();
 
     void setTimeout(uint timeout) { mTimeout = timeout; };
+    void setSubscriptionIds(const QStringList &ids) { mSubscriptionIds = ids; };
 
     virtual void start() Q_DECL_OVERRIDE;
 public Q_SLOTS:
@@ -46,11 +49,19 @@ public Q_SLOTS:
 Q_SIGNALS:
     void eventsReceived(KJob *job);
 protected Q_SLOTS:
-    void requestData(KIO::Job *job, const QByteArray &data);
-    void requestDataTimeout();
+    void requestData(KIO::Job *job, const QByteArray &data) Q_DECL_OVERRIDE;
+    void requestResult(KJob *job) Q_DECL_OVERRIDE;
 protected:
+    bool processEnvelope(const QString &envelope);
+
     uint mTimeout;
-    QTimer mRespTimer;
+    QStringList mSubscriptionIds;
+    /* The streaming response is a sequence of SOAP envelopes sent as the events arrive. The
+     * scanner tokenizes the data incrementally in order to find the end of each envelope. */
+    QXmlStreamReader mScanner;
+    QScopedPointer<QTextDecoder> mDecoder;
+    int mDepth;
+    uint mEnvelopeCount;
 };
 
 #endif
@@ -58,6 +58,8 @@ public:
     static bool occurrencesReader(QXmlStreamReader &reader, QVariant &val);
     static bool recurrenceReader(QXmlStreamReader &reader, QVariant &val);
     static bool categoriesReader(QXmlStreamReader &reader, QVariant &val);
+    static bool dictionaryReader(QXmlStreamReader &reader, QVariant &val);
+    static bool physicalAddressesReader(QXmlStreamReader &reader, QVariant &val);
     static bool categoriesWriter(QXmlStreamWriter &writer, const QVariant &val);
     static bool attachmentsReader(QXmlStreamReader &reader, QVariant &val);
 
@@ -91,6 +93,9 @@ static const QVector<EwsItemPrivate::Reader::Item> ewsItemItems = {
     {EwsItemFieldExtendedProperties, QStringLiteral("ExtendedProperty"),
         &EwsItemBasePrivate::extendedPropertyReader, &EwsItemBasePrivate::extendedPropertyWriter},
     {EwsItemFieldHasAttachments, QStringLiteral("HasAttachments"), &ewsXmlBoolReader},
+    {EwsItemFieldReminderIsSet, QStringLiteral("ReminderIsSet"), &ewsXmlBoolReader},
+    {EwsItemFieldReminderMinutesBeforeStart, QStringLiteral("ReminderMinutesBeforeStart"),
+        &ewsXmlUIntReader},
     // Message fields
     {EwsItemFieldToRecipients, QStringLiteral("ToRecipients"), &EwsItemPrivate::recipientsReader},
     {EwsItemFieldCcRecipients, QStringLiteral("CcRecipients"), &EwsItemPrivate::recipientsReader},
@@ -100,12 +105,22 @@ static const QVector<EwsItemPrivate::Reader::Item> ewsItemItems = {
     {EwsItemFieldIsRead, QStringLiteral("IsRead"), &ewsXmlBoolReader, &ewsXmlBoolWriter},
     {EwsItemFieldReferences, QStringLiteral("References"), &ewsXmlTextReader},
     {EwsItemFieldReplyTo, QStringLiteral("ReplyTo"), &EwsItemPrivate::mailboxReader},
+    // Task fields
+    {EwsItemFieldCompleteDate, QStringLiteral("CompleteDate"), &ewsXmlDateTimeReader},
+    {EwsItemFieldDueDate, QStringLiteral("DueDate"), &ewsXmlDateTimeReader},
+    {EwsItemFieldIsComplete, QStringLiteral("IsComplete"), &ewsXmlBoolReader},
+    {EwsItemFieldPercentComplete, QStringLiteral("PercentComplete"), &ewsXmlTextReader},
+    {EwsItemFieldStartDate, QStringLiteral("StartDate"), &ewsXmlDateTimeReader},
+    {EwsItemFieldStatus, QStringLiteral("Status"), &ewsXmlTaskStatusReader},
+    {EwsItemFieldStatusDescription, QStringLiteral("StatusDescription"), &ewsXmlTextReader},
     // CalendarItem fields
     {EwsItemFieldCalendarItemType, QStringLiteral("CalendarItemType"),
         &ewsXmlCalendarItemTypeReader},
     {EwsItemFieldUID, QStringLiteral("UID"), &ewsXmlTextReader},
     {EwsItemFieldCulture, QStringLiteral("Culture"), &ewsXmlTextReader},
     {EwsItemFieldStartTimeZone, QStringLiteral("StartTimeZone"), &EwsItemPrivate::timezoneReader},
+    {EwsItemFieldEndTimeZone, QStringLiteral("EndTimeZone"), &EwsItemPrivate::timezoneReader},
+    {EwsItemFieldLocation, QStringLiteral("Location"), &ewsXmlTextReader},
     {EwsItemFieldOrganizer, QStringLiteral("Organizer"), &EwsItemPrivate::mailboxReader},
     {EwsItemFieldRequiredAttendees, QStringLiteral("RequiredAttendees"),
         &EwsItemPrivate::attendeesReader},
@@ -115,6 +130,7 @@ static const QVector<EwsItemPrivate::Reader::Item> ewsItemItems = {
     {EwsItemFieldStart, QStringLiteral("Start"), &ewsXmlDateTimeReader},
     {EwsItemFieldEnd, QStringLiteral("End"), &ewsXmlDateTimeReader},
     {EwsItemFieldRecurrenceId, QStringLiteral("RecurrenceId"), &ewsXmlDateTimeReader},
+    {EwsItemFieldOriginalStart, QStringLiteral("OriginalStart"), &ewsXmlDateTimeReader},
     {EwsItemFieldIsAllDayEvent, QStringLiteral("IsAllDayEvent"), &ewsXmlBoolReader},
     {EwsItemFieldLegacyFreeBusyStatus, QStringLiteral("LegacyFreeBusyStatus"),
         &ewsXmlLegacyFreeBusyStatusReader},
@@ -133,6 +149,32 @@ static const QVector<EwsItemPrivate::Reader::Item> ewsItemItems = {
     {EwsItemFieldTimeZone, QStringLiteral("TimeZone"), &ewsXmlTextReader},
     {EwsItemFieldExchangePersonIdGuid, QStringLiteral("ExchangePersonIdGuid"), &ewsXmlTextReader},
     {EwsItemFieldDoNotForwardMeeting, QStringLiteral("DoNotForwardMeeting"), &ewsXmlBoolReader},
+    // Contact fields
+    {EwsItemFieldFileAs, QStringLiteral("FileAs"), &ewsXmlTextReader},
+    {EwsItemFieldDisplayName, QStringLiteral("DisplayName"), &ewsXmlTextReader},
+    {EwsItemFieldGivenName, QStringLiteral("GivenName"), &ewsXmlTextReader},
+    {EwsItemFieldInitials, QStringLiteral("Initials"), &ewsXmlTextReader},
+    {EwsItemFieldMiddleName, QStringLiteral("MiddleName"), &ewsXmlTextReader},
+    {EwsItemFieldNickname, QStringLiteral("Nickname"), &ewsXmlTextReader},
+    {EwsItemFieldCompanyName, QStringLiteral("CompanyName"), &ewsXmlTextReader},
+    {EwsItemFieldEmailAddresses, QStringLiteral("EmailAddresses"), &EwsItemPrivate::dictionaryReader},
+    {EwsItemFieldPhysicalAddresses, QStringLiteral("PhysicalAddresses"),
+        &EwsItemPrivate::physicalAddressesReader},
+    {EwsItemFieldPhoneNumbers, QStringLiteral("PhoneNumbers"), &EwsItemPrivate::dictionaryReader},
+    {EwsItemFieldAssistantName, QStringLiteral("AssistantName"), &ewsXmlTextReader},
+    {EwsItemFieldBirthday, QStringLiteral("Birthday"), &ewsXmlDateTimeReader},
+    {EwsItemFieldBusinessHomePage, QStringLiteral("BusinessHomePage"), &ewsXmlTextReader},
+    {EwsItemFieldChildren, QStringLiteral("Children"), &EwsItemPrivate::categoriesReader},
+    {EwsItemFieldDepartment, QStringLiteral("Department"), &ewsXmlTextReader},
+    {EwsItemFieldGeneration, QStringLiteral("Generation"), &ewsXmlTextReader},
+    {EwsItemFieldImAddresses, QStringLiteral("ImAddresses"), &EwsItemPrivate::dictionaryReader},
+    {EwsItemFieldJobTitle, QStringLiteral("JobTitle"), &ewsXmlTextReader},
+    {EwsItemFieldManager, QStringLiteral("Manager"), &ewsXmlTextReader},
+    {EwsItemFieldOfficeLocation, QStringLiteral("OfficeLocation"), &ewsXmlTextReader},
+    {EwsItemFieldProfession, QStringLiteral("Profession"), &ewsXmlTextReader},
+    {EwsItemFieldSpouseName, QStringLiteral("SpouseName"), &ewsXmlTextReader},
+    {EwsItemFieldSurname, QStringLiteral("Surname"), &ewsXmlTextReader},
+    {EwsItemFieldWeddingAnniversary, QStringLiteral("WeddingAnniversary"), &ewsXmlDateTimeReader},
 };
 
 const EwsItemPrivate::Reader EwsItemPrivate::mStaticEwsXml(ewsItemItems);
@@ -366,6 +408,88 @@ bool EwsItemPrivate::categoriesWriter(QXmlStreamWriter &writer, const QVariant &
     return true;
 }
 
+bool EwsItemPrivate::dictionaryReader(QXmlStreamReader &reader, QVariant &val)
+{
+    EwsItem::EntryMap map;
+    QString elmName = reader.name().toString();
+
+    while (reader.readNextStartElement()) {
+        if (reader.namespaceUri() != ewsTypeNsUri) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Unexpected namespace in %1 element:").arg(elmName)
+                            << reader.namespaceUri();
+            return false;
+        }
+
+        if (reader.name() != QStringLiteral("Entry")) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Unexpected child element in %1 element:").arg(elmName)
+                            << reader.name();
+            return false;
+        }
+
+        QStringRef keyRef = reader.attributes().value(QStringLiteral("Key"));
+        if (keyRef.isNull()) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Missing Key attribute in %1/Entry element.").arg(elmName);
+            return false;
+        }
+        QString key = keyRef.toString();
+        QString value = reader.readElementText();
+        if (reader.error() != QXmlStreamReader::NoError) {
+            qCWarning(EWSRES_LOG) << QStringLiteral("Failed to read EWS request - invalid %1 element.")
+                                    .arg(QStringLiteral("%1/Entry").arg(elmName));
+            return false;
+        }
+        if (!value.isEmpty()) {
+            map.insert(key, value);
+        }
+    }
+
+    val = QVariant::fromValue<EwsItem::EntryMap>(map);
+
+    return true;
+}
+
+bool EwsItemPrivate::physicalAddressesReader(QXmlStreamReader &reader, QVariant &val)
+{
+    EwsItem::PhysicalAddressMap map;
+
+    while (reader.readNextStartElement()) {
+        if (reader.namespaceUri() != ewsTypeNsUri || reader.name() != QStringLiteral("Entry")) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Unexpected child element in PhysicalAddresses element:")
+                            << reader.namespaceUri() << reader.name();
+            return false;
+        }
+
+        QStringRef keyRef = reader.attributes().value(QStringLiteral("Key"));
+        if (keyRef.isNull()) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Missing Key attribute in PhysicalAddresses/Entry element.");
+            return false;
+        }
+        QString key = keyRef.toString();
+
+        EwsItem::EntryMap address;
+        while (reader.readNextStartElement()) {
+            if (reader.namespaceUri() != ewsTypeNsUri) {
+                qCWarningNC(EWSRES_LOG) << QStringLiteral("Unexpected namespace in PhysicalAddresses/Entry element:")
+                                << reader.namespaceUri();
+                return false;
+            }
+            QString name = reader.name().toString();
+            QString value = reader.readElementText();
+            if (reader.error() != QXmlStreamReader::NoError) {
+                qCWarning(EWSRES_LOG) << QStringLiteral("Failed to read EWS request - invalid %1 element.")
+                                        .arg(QStringLiteral("PhysicalAddresses/Entry/%1").arg(name));
+                return false;
+            }
+            address.insert(name, value);
+        }
+        map.insert(key, address);
+    }
+
+    val = QVariant::fromValue<EwsItem::PhysicalAddressMap>(map);
+
+    return true;
+}
+
 bool EwsItemPrivate::recurrenceReader(QXmlStreamReader &reader, QVariant &val)
 {
     EwsRecurrence recurrence(reader);
@@ -412,6 +536,8 @@ EwsItem::EwsItem(QXmlStreamReader &reader)
     : EwsItemBase(QSharedDataPointer<EwsItemBasePrivate>(new EwsItemPrivate()))
 {
     qRegisterMetaType<EwsItem::HeaderMap>();
+    qRegisterMetaType<EwsItem::EntryMap>();
+    qRegisterMetaType<EwsItem::PhysicalAddressMap>();
     qRegisterMetaType<EwsMailbox>();
     qRegisterMetaType<EwsMailbox::List>();
     qRegisterMetaType<EwsAttendee>();
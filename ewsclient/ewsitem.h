@@ -33,6 +33,8 @@ class EwsItem : public EwsItemBase
 public:
     typedef QList<EwsItem> List;
     typedef QMultiMap<QString, QString> HeaderMap;
+    typedef QMap<QString, QString> EntryMap;
+    typedef QMap<QString, EntryMap> PhysicalAddressMap;
 
     EwsItem();
     explicit EwsItem(QXmlStreamReader &reader);
@@ -57,5 +59,7 @@ protected:
 Q_DECLARE_METATYPE(EwsItem)
 Q_DECLARE_METATYPE(EwsItem::List)
 Q_DECLARE_METATYPE(EwsItem::HeaderMap)
+Q_DECLARE_METATYPE(EwsItem::EntryMap)
+Q_DECLARE_METATYPE(EwsItem::PhysicalAddressMap)
 
 #endif
@@ -147,10 +147,10 @@ bool EwsItemBasePrivate::operator==(const EwsItemBasePrivate &other) const
 
 QVariant EwsItemBase::operator[](const EwsPropertyField &prop) const
 {
-    EwsItemBasePrivate::PropertyHash propHash =
+    const EwsItemBasePrivate::PropertyHash propHash =
         d->mFields[EwsItemFieldExtendedProperties].value<EwsItemBasePrivate::PropertyHash>();
-    EwsItemBasePrivate::PropertyHash::iterator it = propHash.find(prop);
-    if (it != propHash.end()) {
+    EwsItemBasePrivate::PropertyHash::const_iterator it = propHash.constFind(prop);
+    if (it != propHash.cend()) {
         return it.value();
     }
     else {
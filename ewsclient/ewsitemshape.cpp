@@ -66,3 +66,12 @@ void EwsItemShape::write(QXmlStreamWriter &writer) const
     writer.writeEndElement();
 }
 
+uint qHash(const EwsItemShape &shape, uint seed)
+{
+    uint hash = seed ^ (shape.mBaseShape | (static_cast<uint>(shape.mFlags) << 4)
+        | (shape.mBodyType << 8));
+    Q_FOREACH(const EwsPropertyField &prop, shape.mProps) {
+        hash = (hash << 1) ^ qHash(prop, seed);
+    }
+    return hash;
+}
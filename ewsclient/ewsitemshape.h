@@ -43,7 +43,7 @@ public:
 
     explicit EwsItemShape(EwsBaseShape shape = EwsShapeDefault) : EwsFolderShape(shape), mBodyType(BodyNone) {};
     EwsItemShape(const EwsItemShape &other)
-        : EwsFolderShape(other), mBodyType(BodyNone) {};
+        : EwsFolderShape(other), mFlags(other.mFlags), mBodyType(other.mBodyType) {};
     explicit EwsItemShape(EwsFolderShape &&other)
         : EwsFolderShape(other), mBodyType(BodyNone) {};
     EwsItemShape& operator=(EwsItemShape &&other) {
@@ -70,12 +70,21 @@ public:
     }
 
     void write(QXmlStreamWriter &writer) const;
+
+    bool operator==(const EwsItemShape &other) const
+    {
+        return (mBaseShape == other.mBaseShape) && (mFlags == other.mFlags)
+            && (mBodyType == other.mBodyType) && (mProps == other.mProps);
+    }
 protected:
     Flags mFlags;
     BodyType mBodyType;
 
+    friend uint qHash(const EwsItemShape &shape, uint seed);
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(EwsItemShape::Flags)
 
+uint qHash(const EwsItemShape &shape, uint seed);
+
 #endif
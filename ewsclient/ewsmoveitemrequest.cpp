@@ -31,32 +31,38 @@ EwsMoveItemRequest::~EwsMoveItemRequest()
 
 void EwsMoveItemRequest::start()
 {
-    QString reqString;
-    QXmlStreamWriter writer(&reqString);
+    int pos = 0;
+    do {
+        const EwsId::List ids = mIds.mid(pos, chunkSize());
+        pos += chunkSize();
 
-    startSoapDocument(writer);
+        QString reqString;
+        QXmlStreamWriter writer(&reqString);
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("MoveItem"));
+        startSoapDocument(writer);
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ToFolderId"));
-    mDestFolderId.writeFolderIds(writer);
-    writer.writeEndElement();
+        writer.writeStartElement(ewsMsgNsUri, QStringLiteral("MoveItem"));
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ItemIds"));
-    Q_FOREACH(const EwsId &id, mIds) {
-        id.writeItemIds(writer);
-    }
-    writer.writeEndElement();
+        writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ToFolderId"));
+        mDestFolderId.writeFolderIds(writer);
+        writer.writeEndElement();
+
+        writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ItemIds"));
+        Q_FOREACH(const EwsId &id, ids) {
+            id.writeItemIds(writer);
+        }
+        writer.writeEndElement();
 
-    writer.writeEndElement();
+        writer.writeEndElement();
 
-    endSoapDocument(writer);
+        endSoapDocument(writer);
 
-    qCDebugNCS(EWSRES_REQUEST_LOG) << QStringLiteral("Starting MoveItem request (") << mIds << "to" << mDestFolderId << ")";
+        qCDebugNCS(EWSRES_REQUEST_LOG) << QStringLiteral("Starting MoveItem request (") << ids << "to" << mDestFolderId << ")";
 
-    qCDebug(EWSRES_PROTO_LOG) << reqString;
+        qCDebug(EWSRES_PROTO_LOG) << reqString;
 
-    prepare(reqString);
+        prepare(reqString);
+    } while (pos < mIds.size());
 
     doSend();
 }
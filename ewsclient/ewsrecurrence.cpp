@@ -107,7 +107,7 @@ EwsRecurrence::EwsRecurrence(QXmlStreamReader &reader)
             }
         }
         else if (reader.name() == QStringLiteral("DailyRecurrence")) {
-            if (!readWeeklyRecurrence(reader)) {
+            if (!readDailyRecurrence(reader)) {
                 return;
             }
         }
@@ -473,6 +473,7 @@ bool EwsRecurrence::readDailyRecurrence(QXmlStreamReader &reader)
                                 .arg(QStringLiteral("Interval").arg(text));
                 return false;
             }
+            hasInterval = true;
         }
         else {
             qCWarning(EWSRES_LOG) << QStringLiteral("Failed to read recurrence element - unknown element: %1.")
@@ -25,8 +25,37 @@
 #include "ewsclient_debug.h"
 #include "ewsserverversion.h"
 
+/* Request templates contain the serialized invariant part of a request (SOAP envelope, item shape,
+ * etc.) split into a prefix and suffix at the point where the variable content of a request
+ * (item ids, sync state) is to be inserted. Templates are cached per server version (as it is
+ * part of the SOAP header), request name and item shape. */
+struct SoapTemplate {
+    QString prefix;
+    QString suffix;
+};
+
+typedef QHash<EwsItemShape, SoapTemplate> SoapTemplateHash;
+
+static QHash<QString, SoapTemplateHash> soapTemplates;
+
+static const QString splicePointMarker = QStringLiteral("splice");
+
+/* Upper limit for the number of different shapes cached for a single request type. Normally the
+ * number of shapes is small and constant, so reaching the limit means that something is creating
+ * shapes dynamically. In such case dump the cache and start over. */
+static Q_CONSTEXPR int maxTemplatesPerRequest = 32;
+
+/* Default number of items per request chunk. Exchange rejects or times out requests operating on
+ * very large item batches, while too small chunks waste time on the HTTP round trips. */
+static Q_CONSTEXPR int defaultChunkSize = 250;
+
+/* Maximum number of request chunks in flight at the same time. Kept well below the default
+ * Exchange throttling policy concurrency limit, which is shared with other requests. */
+static Q_CONSTEXPR int maxParallelChunks = 3;
+
 EwsRequest::EwsRequest(EwsClient& client, QObject *parent)
-    : EwsJob(parent), mClient(client), mServerVersion(EwsServerVersion::ewsVersion2007Sp1)
+    : EwsJob(parent), mClient(client), mServerVersion(EwsServerVersion::ewsVersion2007Sp1),
+      mChunkSize(defaultChunkSize), mChunksStarted(0), mChunksParsed(0)
 {
 }
 
@@ -36,8 +65,26 @@ EwsRequest::~EwsRequest()
 
 void EwsRequest::doSend()
 {
-    Q_FOREACH(KJob *job, subjobs()) {
-        job->start();
+    while (mChunksStarted < mChunks.size() && mChunksStarted < maxParallelChunks) {
+        startNextChunk();
+    }
+}
+
+void EwsRequest::startNextChunk()
+{
+    if (mChunksStarted < mChunks.size()) {
+        mChunks[mChunksStarted++].job->start();
+    }
+}
+
+void EwsRequest::abortChunks(KJob *currentJob)
+{
+    for (int i = mChunksParsed; i < mChunks.size(); ++i) {
+        KIO::TransferJob *job = mChunks[i].job;
+        if (job != currentJob && !mChunks[i].finished) {
+            removeSubjob(job);
+            job->kill(KJob::Quietly);
+        }
     }
 }
 
@@ -74,9 +121,70 @@ void EwsRequest::endSoapDocument(QXmlStreamWriter &writer)
     writer.writeEndDocument();
 }
 
+QString EwsRequest::soapDocument(const QString &reqName, const EwsItemShape &shape,
+                                 ContentWriterFn templateWriter, ContentWriterFn contentWriter)
+{
+    SoapTemplateHash &templates = soapTemplates[mServerVersion.name() + QLatin1Char('/') + reqName];
+    SoapTemplateHash::const_iterator it = templates.constFind(shape);
+    if (it == templates.cend()) {
+        if (templates.size() >= maxTemplatesPerRequest) {
+            templates.clear();
+        }
+
+        QString tmplString;
+        QXmlStreamWriter writer(&tmplString);
+        startSoapDocument(writer);
+        templateWriter(writer);
+        endSoapDocument(writer);
+
+        const QString marker = QStringLiteral("<!--") + splicePointMarker + QStringLiteral("-->");
+        int pos = tmplString.indexOf(marker);
+        Q_ASSERT(pos >= 0);
+        SoapTemplate tmpl = {tmplString.left(pos), tmplString.mid(pos + marker.size())};
+        it = templates.insert(shape, tmpl);
+    }
+
+    /* The variable content is written using a separate writer. In order for it to use the same
+     * namespace prefixes as the template they need to be declared on a dummy element, which is
+     * then stripped. */
+    QString content;
+    QXmlStreamWriter writer(&content);
+    writer.writeNamespace(soapEnvNsUri, QStringLiteral("soap"));
+    writer.writeNamespace(ewsMsgNsUri, QStringLiteral("m"));
+    writer.writeNamespace(ewsTypeNsUri, QStringLiteral("t"));
+    writer.writeStartElement(soapEnvNsUri, QStringLiteral("Body"));
+    // Force the start element to be closed so that the content begins at a known position.
+    writer.writeCharacters(QString());
+    int contentStart = content.size();
+    contentWriter(writer);
+
+    QString doc;
+    doc.reserve(it->prefix.size() + content.size() - contentStart + it->suffix.size());
+    doc.append(it->prefix).append(content.midRef(contentStart)).append(it->suffix);
+    return doc;
+}
+
+int EwsRequest::soapTemplateCount()
+{
+    int count = 0;
+    Q_FOREACH(const SoapTemplateHash &templates, soapTemplates) {
+        count += templates.size();
+    }
+    return count;
+}
+
+void EwsRequest::writeSplicePoint(QXmlStreamWriter &writer)
+{
+    writer.writeComment(splicePointMarker);
+}
+
 void EwsRequest::prepare(const QString body)
 {
-    mBody = body;
+    /* Each call prepares one chunk of the request. The first chunk is the one that will be
+     * parsed first, so its body and response go directly to mBody and mResponseData. */
+    if (mChunks.isEmpty()) {
+        mBody = body;
+    }
     KIO::TransferJob *job = KIO::http_post(mClient.url(), body.toUtf8(),
                           KIO::HideProgressInfo);
     job->addMetaData(QStringLiteral("content-type"), QStringLiteral("text/xml"));
@@ -92,6 +200,9 @@ void EwsRequest::prepare(const QString body)
     connect(job, &KIO::TransferJob::result, this, &EwsRequest::requestResult);
     connect(job, &KIO::TransferJob::data, this, &EwsRequest::requestData);
 
+    Chunk chunk = {job, mChunks.isEmpty() ? QString() : body, QString(), false};
+    mChunks.append(chunk);
+
     addSubjob(job);
 }
 
@@ -107,17 +218,15 @@ void EwsRequest::addMetaData(QString key, QString value)
 
 void EwsRequest::requestResult(KJob *job)
 {
-    if (EWSRES_PROTO_LOG().isDebugEnabled()) {
-        ewsLogDir.setAutoRemove(false);
-        if (ewsLogDir.isValid()) {
-            QTemporaryFile dumpFile(ewsLogDir.path() + "/ews_xmldump_XXXXXXX.xml");
-            dumpFile.open();
-            dumpFile.setAutoRemove(false);
-            dumpFile.write(mResponseData.toUtf8());
-            qCDebug(EWSRES_PROTO_LOG) << "response dumped to" << dumpFile.fileName();
-            dumpFile.close();
+    int index;
+    for (index = mChunksParsed; index < mChunks.size(); ++index) {
+        if (mChunks[index].job == job) {
+            break;
         }
     }
+    if (index == mChunks.size()) {
+        return;
+    }
 
     KIO::TransferJob *trJob = qobject_cast<KIO::TransferJob*>(job);
     int resp = trJob->metaData()["responsecode"].toUInt();
@@ -131,12 +240,50 @@ void EwsRequest::requestResult(KJob *job)
         setErrorMsg(QStringLiteral("Failed to process EWS request - HTTP code %1").arg(resp));
         setError(resp);
     }
-    else {
+
+    if (error() != 0) {
+        abortChunks(job);
+        emitResult();
+        return;
+    }
+
+    mChunks[index].finished = true;
+
+    /* Chunks may complete out of order. Parse them in order so that the responses stay aligned
+     * with the items passed to the request. */
+    while (mChunksParsed < mChunks.size() && mChunks[mChunksParsed].finished) {
+        if (EWSRES_PROTO_LOG().isDebugEnabled()) {
+            ewsLogDir.setAutoRemove(false);
+            if (ewsLogDir.isValid()) {
+                QTemporaryFile dumpFile(ewsLogDir.path() + "/ews_xmldump_XXXXXXX.xml");
+                dumpFile.open();
+                dumpFile.setAutoRemove(false);
+                dumpFile.write(mResponseData.toUtf8());
+                qCDebug(EWSRES_PROTO_LOG) << "response dumped to" << dumpFile.fileName();
+                dumpFile.close();
+            }
+        }
+
         QXmlStreamReader reader(mResponseData);
         readResponse(reader);
+        if (error() != 0) {
+            abortChunks(job);
+            emitResult();
+            return;
+        }
+
+        if (++mChunksParsed < mChunks.size()) {
+            Chunk &next = mChunks[mChunksParsed];
+            mBody.swap(next.body);
+            mResponseData.swap(next.responseData);
+        }
     }
 
-    emitResult();
+    if (mChunksParsed == mChunks.size()) {
+        emitResult();
+    } else {
+        startNextChunk();
+    }
 }
 
 bool EwsRequest::readResponse(QXmlStreamReader &reader)
@@ -209,9 +356,18 @@ bool EwsRequest::readSoapFault(QXmlStreamReader &reader)
 
 void EwsRequest::requestData(KIO::Job *job, const QByteArray &data)
 {
-    Q_UNUSED(job);
-
     qCDebug(EWSRES_PROTO_LOG) << "data" << job << data;
+
+    /* Data for the chunk due to be parsed next goes directly to the response buffer. Data of
+     * any further chunks is kept aside until all preceding chunks have been parsed. */
+    if (mChunksParsed < mChunks.size() && mChunks[mChunksParsed].job != job) {
+        for (int i = mChunksParsed + 1; i < mChunks.size(); ++i) {
+            if (mChunks[i].job == job) {
+                mChunks[i].responseData += QString::fromUtf8(data);
+                return;
+            }
+        }
+    }
     mResponseData += QString::fromUtf8(data);
 }
 
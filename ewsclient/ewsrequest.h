@@ -24,12 +24,14 @@
 
 #include <QPointer>
 #include <QSharedPointer>
+#include <QVector>
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 
 #include <KIO/TransferJob>
 
 #include "ewsclient.h"
+#include "ewsitemshape.h"
 #include "ewsjob.h"
 #include "ewsserverversion.h"
 #include "ewstypes.h"
@@ -64,16 +66,29 @@ public:
     void setServerVersion(const EwsServerVersion &version);
     const EwsServerVersion &serverVersion() const { return mServerVersion; };
 
+    /* Maximum number of items (ids, changes) sent in a single SOAP request. Requests operating
+     * on item batches larger than this are split into several HTTP requests, which are then
+     * executed with a bounded parallelism. Responses are always returned in item order. */
+    void setChunkSize(int size) { mChunkSize = size; };
+    int chunkSize() const { return mChunkSize; };
+
     void dump() const;
 
+    /* Total number of cached request templates. Used for diagnostics. */
+    static int soapTemplateCount();
+
 protected:
     typedef std::function<bool(QXmlStreamReader &reader)> ContentReaderFn;
+    typedef std::function<void(QXmlStreamWriter &writer)> ContentWriterFn;
 
     void doSend();
     void prepare(const QString body);
     virtual bool parseResult(QXmlStreamReader &reader) = 0;
     void startSoapDocument(QXmlStreamWriter &writer);
     void endSoapDocument(QXmlStreamWriter &writer);
+    QString soapDocument(const QString &reqName, const EwsItemShape &shape,
+                         ContentWriterFn templateWriter, ContentWriterFn contentWriter);
+    static void writeSplicePoint(QXmlStreamWriter &writer);
     bool parseResponseMessage(QXmlStreamReader &reader, QString reqName,
                               ContentReaderFn contentReader);
     bool readResponse(QXmlStreamReader &reader);
@@ -81,17 +96,30 @@ protected:
     KIO::MetaData mMd;
     QString mResponseData;
 protected Q_SLOTS:
-    void requestResult(KJob *job);
-    void requestData(KIO::Job *job, const QByteArray &data);
+    virtual void requestResult(KJob *job);
+    virtual void requestData(KIO::Job *job, const QByteArray &data);
 private:
     bool readSoapBody(QXmlStreamReader &reader);
     bool readSoapFault(QXmlStreamReader &reader);
     bool readHeader(QXmlStreamReader &reader);
     bool readResponseAttr(const QXmlStreamAttributes &attrs, EwsResponseClass &responseClass);
+    void startNextChunk();
+    void abortChunks(KJob *currentJob);
+
+    struct Chunk {
+        KIO::TransferJob *job;
+        QString body;
+        QString responseData;
+        bool finished;
+    };
 
     QString mBody;
     EwsClient &mClient;
     EwsServerVersion mServerVersion;
+    int mChunkSize;
+    QVector<Chunk> mChunks;
+    int mChunksStarted;
+    int mChunksParsed;
 };
 
 #endif
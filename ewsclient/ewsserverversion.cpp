@@ -108,7 +108,11 @@ const EwsServerVersion& EwsServerVersion::minSupporting(ServerFeature feature)
     switch (feature) {
     case StreamingSubscription:
     case FreeBusyChangedEvent:
+    case EmptyFolder:
+    case SubscribeToAllFolders:
         return ewsVersion2010Sp1;
+    case StartEndTimeZones:
+        return ewsVersion2010;
     default:
         return ewsNullVersion;
     }
@@ -31,6 +31,9 @@ public:
     enum ServerFeature {
         StreamingSubscription,
         FreeBusyChangedEvent,
+        EmptyFolder,
+        SubscribeToAllFolders,
+        StartEndTimeZones,
     };
 
     EwsServerVersion() : mMajor(0), mMinor(0), mMajorBuild(0), mMinorBuild(0) {};
@@ -61,6 +61,9 @@ void EwsSubscribeRequest::start()
         && !serverVersion().supports(EwsServerVersion::FreeBusyChangedEvent)) {
         setServerVersion(EwsServerVersion::minSupporting(EwsServerVersion::FreeBusyChangedEvent));
     }
+    if (mAllFolders && !serverVersion().supports(EwsServerVersion::SubscribeToAllFolders)) {
+        setServerVersion(EwsServerVersion::minSupporting(EwsServerVersion::SubscribeToAllFolders));
+    }
 
     startSoapDocument(writer);
 
@@ -71,12 +74,13 @@ void EwsSubscribeRequest::start()
     if (mAllFolders) {
         writer.writeAttribute(QStringLiteral("SubscribeToAllFolders"), QStringLiteral("true"));
     }
-
-    writer.writeStartElement(ewsTypeNsUri, QStringLiteral("FolderIds"));
-    Q_FOREACH(const EwsId &id, mFolderIds) {
-        id.writeFolderIds(writer);
+    else {
+        writer.writeStartElement(ewsTypeNsUri, QStringLiteral("FolderIds"));
+        Q_FOREACH(const EwsId &id, mFolderIds) {
+            id.writeFolderIds(writer);
+        }
+        writer.writeEndElement();
     }
-    writer.writeEndElement();
 
     writer.writeStartElement(ewsTypeNsUri, QStringLiteral("EventTypes"));
     Q_FOREACH(const EwsEventType type, mEventTypes) {
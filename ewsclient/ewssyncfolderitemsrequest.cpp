@@ -83,29 +83,28 @@ void EwsSyncFolderItemsRequest::setMaxChanges(uint max)
 
 void EwsSyncFolderItemsRequest::start()
 {
-    QString reqString;
-    QXmlStreamWriter writer(&reqString);
+    QString reqString = soapDocument(QStringLiteral("SyncFolderItems"), mShape,
+        [this](QXmlStreamWriter &writer) {
+            writer.writeStartElement(ewsMsgNsUri, QStringLiteral("SyncFolderItems"));
 
-    startSoapDocument(writer);
+            mShape.write(writer);
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("SyncFolderItems"));
+            writeSplicePoint(writer);
 
-    mShape.write(writer);
+            writer.writeEndElement();
+        },
+        [this](QXmlStreamWriter &writer) {
+            writer.writeStartElement(ewsMsgNsUri, QStringLiteral("SyncFolderId"));
+            mFolderId.writeFolderIds(writer);
+            writer.writeEndElement();
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("SyncFolderId"));
-    mFolderId.writeFolderIds(writer);
-    writer.writeEndElement();
-
-    if (!mSyncState.isNull()) {
-        writer.writeTextElement(ewsMsgNsUri, QStringLiteral("SyncState"), mSyncState);
-    }
-
-    writer.writeTextElement(ewsMsgNsUri, QStringLiteral("MaxChangesReturned"),
-        QString::number(mMaxChanges));
-
-    writer.writeEndElement();
+            if (!mSyncState.isNull()) {
+                writer.writeTextElement(ewsMsgNsUri, QStringLiteral("SyncState"), mSyncState);
+            }
 
-    endSoapDocument(writer);
+            writer.writeTextElement(ewsMsgNsUri, QStringLiteral("MaxChangesReturned"),
+                QString::number(mMaxChanges));
+        });
 
     qCDebug(EWSRES_PROTO_LOG) << reqString;
 
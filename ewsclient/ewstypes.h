@@ -467,6 +467,14 @@ typedef enum {
     EwsLfbNoData
 } EwsLegacyFreeBusyStatus;
 
+typedef enum {
+    EwsTaskStatusNotStarted = 0,
+    EwsTaskStatusInProgress,
+    EwsTaskStatusCompleted,
+    EwsTaskStatusWaitingOnOthers,
+    EwsTaskStatusDeferred
+} EwsTaskStatus;
+
 typedef enum {
     EwsDispSaveOnly = 0,
     EwsDispSendOnly,
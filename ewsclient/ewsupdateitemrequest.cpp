@@ -58,47 +58,52 @@ EwsUpdateItemRequest::~EwsUpdateItemRequest()
 
 void EwsUpdateItemRequest::start()
 {
-    QString reqString;
-    QXmlStreamWriter writer(&reqString);
+    int pos = 0;
+    do {
+        const QList<ItemChange> changes = mChanges.mid(pos, chunkSize());
+        pos += chunkSize();
 
-    startSoapDocument(writer);
+        QString reqString;
+        QXmlStreamWriter writer(&reqString);
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("UpdateItem"));
+        startSoapDocument(writer);
 
-    writer.writeAttribute(QStringLiteral("ConflictResolution"),
-        conflictResolutionNames[mConflictResol]);
+        writer.writeStartElement(ewsMsgNsUri, QStringLiteral("UpdateItem"));
 
-    writer.writeAttribute(QStringLiteral("MessageDisposition"),
-        messageDispositionNames[mMessageDisp]);
+        writer.writeAttribute(QStringLiteral("ConflictResolution"),
+            conflictResolutionNames[mConflictResol]);
 
-    if (mMeetingDisp != EwsMeetingDispUnspecified) {
-        writer.writeAttribute(QStringLiteral("SendMeetingInvitationsOrCancellations"),
-            meetingDispositionNames[mMeetingDisp]);
-    }
+        writer.writeAttribute(QStringLiteral("MessageDisposition"),
+            messageDispositionNames[mMessageDisp]);
 
-    if (mSavedFolderId.type() != EwsId::Unspecified) {
-        writer.writeStartElement(ewsMsgNsUri, QStringLiteral("SavedItemFolderId"));
-        mSavedFolderId.writeFolderIds(writer);
-        writer.writeEndElement();
-    }
+        if (mMeetingDisp != EwsMeetingDispUnspecified) {
+            writer.writeAttribute(QStringLiteral("SendMeetingInvitationsOrCancellations"),
+                meetingDispositionNames[mMeetingDisp]);
+        }
 
-    writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ItemChanges"));
-    Q_FOREACH(const ItemChange &ch, mChanges) {
-        qDebug() << "writing change";
-        ch.write(writer);
-    }
-    writer.writeEndElement();
+        if (mSavedFolderId.type() != EwsId::Unspecified) {
+            writer.writeStartElement(ewsMsgNsUri, QStringLiteral("SavedItemFolderId"));
+            mSavedFolderId.writeFolderIds(writer);
+            writer.writeEndElement();
+        }
 
-    writer.writeEndElement();
+        writer.writeStartElement(ewsMsgNsUri, QStringLiteral("ItemChanges"));
+        Q_FOREACH(const ItemChange &ch, changes) {
+            ch.write(writer);
+        }
+        writer.writeEndElement();
+
+        writer.writeEndElement();
 
-    endSoapDocument(writer);
+        endSoapDocument(writer);
 
-    qCDebugNC(EWSRES_REQUEST_LOG) << QStringLiteral("Starting UpdateItem request (%1 changes)")
-                    .arg(mChanges.size());
+        qCDebugNC(EWSRES_REQUEST_LOG) << QStringLiteral("Starting UpdateItem request (%1 changes)")
+                        .arg(changes.size());
 
-    qCDebug(EWSRES_PROTO_LOG) << reqString;
+        qCDebug(EWSRES_PROTO_LOG) << reqString;
 
-    prepare(reqString);
+        prepare(reqString);
+    } while (pos < mChanges.size());
 
     doSend();
 }
@@ -56,6 +56,14 @@ static const QVector<QString> legacyFreeBusyStatusNames = {
     QStringLiteral("NoData")
 };
 
+static const QVector<QString> taskStatusNames = {
+    QStringLiteral("NotStarted"),
+    QStringLiteral("InProgress"),
+    QStringLiteral("Completed"),
+    QStringLiteral("WaitingOnOthers"),
+    QStringLiteral("Deferred")
+};
+
 static const QVector<QString> responseTypeNames = {
     QStringLiteral("Unknown"),
     QStringLiteral("Organizer"),
@@ -278,6 +286,11 @@ bool ewsXmlResponseTypeReader(QXmlStreamReader &reader, QVariant &val)
     return ewsXmlEnumReader(reader, val, responseTypeNames);
 }
 
+bool ewsXmlTaskStatusReader(QXmlStreamReader &reader, QVariant &val)
+{
+    return ewsXmlEnumReader(reader, val, taskStatusNames);
+}
+
 template <>
 QString readXmlElementValue(QXmlStreamReader &reader, bool &ok, const QString &parentElement)
 {
@@ -19,12 +19,15 @@
 
 #include "ewsfetchfoldersincrjob.h"
 
+#include <QSet>
+
 #include <KMime/Message>
 #include <KCalCore/Event>
 #include <KCalCore/Todo>
 #include <KContacts/Addressee>
 #include <KContacts/ContactGroup>
 #include <AkonadiCore/CollectionStatistics>
+#include <AkonadiCore/CollectionCreateJob>
 #include <AkonadiCore/CollectionFetchJob>
 #include <AkonadiCore/CollectionFetchScope>
 #include <AkonadiCore/CollectionMoveJob>
@@ -33,6 +36,7 @@
 #include "ewsgetfolderrequest.h"
 #include "ewseffectiverights.h"
 #include "ewsclient.h"
+#include "ewsfoldertree.h"
 #include "ewsclient_debug.h"
 
 using namespace Akonadi;
@@ -64,48 +68,45 @@ using namespace Akonadi;
  *    will be known as part of the current collection once retrieved from Akonadi).
  *  * For deleted folders the current (corresponding to the EWS deleted folder) is retrieved.
  *
+ * If a snapshot of the folder tree (EwsFolderTree) is available the local collections are
+ * reconstructed from it instead of being fetched from Akonadi. This is not possible when some
+ * folder is missing from the snapshot or when a folder has been moved, as moving a collection
+ * requires the real Akonadi collection. In such cases the job falls back to the fetch.
+ *
  * After the local Akonadi collections are retrieved the objects are put into their corresponding
  * folder descriptors in the folder hash.
  *
  * Having information about all remote changed folders and their local Akonadi collections the main
  * part of the synchronization process can be started.
  *
- * In the first pass the processRemoteFolders() method looks at all folders in the hash table.
- * Setting the parent-child relationships is performed at this stage only when the relevant parent
- * collection has already been processed (the FolderDescr::Processed flag is set). This ensures
- * that the parent-child relationships are set in the down-the-tree order. In case this condition
- * is not met for a collection the need for an extra reparenting pass is flagged and the parent
- * collection setting is not performed.
+ * The processRemoteFolders() method then reconstructs the changed part of the tree in a single
+ * pass. The folders in the hash are visited in topological (down-the-tree) order - starting from
+ * the folders whose parent is not in the hash and descending into their children using the
+ * parent->child map (mParentMap). This ensures that a parent collection is always complete before
+ * it is set as the parent of its children, which is necessary as each child holds a copy of its
+ * parent collection object. Each folder is visited exactly once.
  *
  * Two types of folders are of main interest:
  *
  *  * For created folders the Akonadi collection object is created and populated with data obtained
- *    from Exchange. If the parent collection has alredy been processed in this pass the parent is
- *    set on the newly created collection.
+ *    from Exchange and the parent is set.
  *  * For modified folders the Akonadi collection object that was retrieved previously is updated
  *    with data obtained from Exchange. If the folder was moved (the Akonadi parent differs from the
- *    Exchange parent) a collection move is attempted. This needs to be done explicitly using a
- *    CollectionMoveJob as Akonadi is unable to detect collection moves in the sync code. Similar
- *    to the created folder case the move is only performed in case the new parent is flagged as
- *    processed. Additionally the code checks if the new parent is a newly created folder. In such
- *    case the whole incremental sync is aborted as handling this rare corner case would introduce
- *    extra complexity. In case of incremental sync failure the resource will fallback to a full
- *    sync that will handle the case.
- *
- * Regardless of collection type the first pass also builds a list of top-level collections
- * (i.e. ones for which the parent is not in the folder hash) and a hash containing the parent-child
- * relationship. Both lists will be needed in case a reparenting pass is needed.
+ *    Exchange parent) a collection move is scheduled. This needs to be done explicitly using a
+ *    CollectionMoveJob as Akonadi is unable to detect collection moves in the sync code. In case
+ *    a folder has been moved to a newly created folder, the new parent does not exist in Akonadi
+ *    yet. Such parent (and any of its newly created ancestors) is therefore created explicitly
+ *    using a CollectionCreateJob before the move.
  *
- * The optional reparenting pass follows the first pass. It is performed if processing of at least
- * one collection failed due to an unprocessed parent. The reparenting pass focuses on the top-level
- * folders and starting from each recursively goes into its children setting their parent to itself.
- * The pass also processes any delayed collection moves in case executing them was impossible in the
- * first pass.
+ * The scheduled operations are executed sequentially in the order they were scheduled, which is
+ * also down-the-tree. Once a collection has been created explicitly the created collection
+ * (including its Akonadi identifier) replaces the one in the folder hash, so that any following
+ * operation can refer to it.
  *
  * The final stage of the synchronization process builds a list of changed and deleted collections
- * for Akonadi. At this stage all collections must be processed, otherwise an error is raised. If
- * no collection moves have been executed the job is completed. Otherwise the completion is
- * singalled once all moves are done.
+ * for Akonadi. At this stage all collections must be processed, otherwise an error is raised
+ * (this can only happen in case of a parent loop). The list is returned once all scheduled
+ * operations are done.
  */
 
 static const EwsPropertyField propPidTagContainerClass(0x3613, EwsPropTypeString);
@@ -142,21 +143,36 @@ public:
                                   const Collection &rootCollection);
     ~EwsFetchFoldersIncrJobPrivate();
 
+    bool resolveLocalFolders(const QStringList &ids, Collection::List &collections);
+    void localFoldersRetrieved(const Collection::List &collections);
     bool processRemoteFolders();
     void updateFolderCollection(Collection &collection, const EwsFolder &folder);
 
-    void reparentRemoteFolder(const QString &id);
-    void moveCollection(const FolderDescr &fd);
+    bool processRemoteFolder(const QString &id, FolderDescr &fd);
+    void scheduleParentCreation(const QString &id);
+    void startNextOperation();
 public Q_SLOTS:
     void remoteFolderIncrFetchDone(KJob *job);
     void localFolderFetchDone(KJob *job);
+    void localFolderCreateDone(KJob *job);
     void localFolderMoveDone(KJob *job);
 public:
+    /* Akonadi-side operations needed to apply the changes, in execution order. */
+    struct Operation {
+        enum Type {
+            Create,
+            Move
+        } type;
+        QString id;
+    };
+
     EwsClient& mClient;
-    int mPendingMoveJobs;
+    QList<Operation> mOperations;
+    QSet<QString> mCreateScheduled;
     EwsId::List mRemoteFolderIds;
 
     const Collection &mRootCollection;
+    const EwsFolderTree *mFolderTree;
 
     QMultiHash<QString, QString> mParentMap;
 
@@ -168,9 +184,9 @@ public:
 
 EwsFetchFoldersIncrJobPrivate::EwsFetchFoldersIncrJobPrivate(EwsFetchFoldersIncrJob *parent, EwsClient &client,
                                                              const Collection &rootCollection)
-    : QObject(parent), mClient(client), mRootCollection(rootCollection), q_ptr(parent)
+    : QObject(parent), mClient(client), mRootCollection(rootCollection), mFolderTree(Q_NULLPTR),
+      q_ptr(parent)
 {
-    mPendingMoveJobs = 0;
 }
 
 EwsFetchFoldersIncrJobPrivate::~EwsFetchFoldersIncrJobPrivate()
@@ -264,6 +280,13 @@ void EwsFetchFoldersIncrJobPrivate::remoteFolderIncrFetchDone(KJob *job)
 
     q->mSyncState = req->syncState();
 
+    Collection::List collections;
+    if (resolveLocalFolders(localFetchHash.keys(), collections)) {
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Local folders resolved from folder tree snapshot");
+        localFoldersRetrieved(collections);
+        return;
+    }
+
     CollectionFetchJob *fetchJob = new CollectionFetchJob(localFetchHash.values().toVector(),
         CollectionFetchJob::Base);
     CollectionFetchScope scope;
@@ -287,7 +310,40 @@ void EwsFetchFoldersIncrJobPrivate::localFolderFetchDone(KJob *job)
     CollectionFetchJob *fetchJob = qobject_cast<CollectionFetchJob*>(job);
     Q_ASSERT(fetchJob);
 
-    Q_FOREACH(const Collection &col, fetchJob->collections()) {
+    localFoldersRetrieved(fetchJob->collections());
+}
+
+bool EwsFetchFoldersIncrJobPrivate::resolveLocalFolders(const QStringList &ids, Collection::List &collections)
+{
+    if (!mFolderTree || mFolderTree->isEmpty()) {
+        return false;
+    }
+
+    Q_FOREACH(const QString &id, ids) {
+        Collection col = (id == mRootCollection.remoteId()) ? mRootCollection
+            : mFolderTree->collection(id, mRootCollection);
+        if (col.remoteId().isEmpty()) {
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("Folder %1 not found in folder tree snapshot").arg(ewsHash(id));
+            return false;
+        }
+
+        auto it = mFolderHash.constFind(id);
+        if (it != mFolderHash.cend() && it->isModified() && it->parent() != col.parentCollection().remoteId()) {
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("Folder %1 moved - fetching local folders").arg(ewsHash(id));
+            return false;
+        }
+
+        collections.append(col);
+    }
+
+    return true;
+}
+
+void EwsFetchFoldersIncrJobPrivate::localFoldersRetrieved(const Collection::List &collections)
+{
+    Q_Q(EwsFetchFoldersIncrJob);
+
+    Q_FOREACH(const Collection &col, collections) {
         /* Retrieve the folder descriptor for this collection. Note that a new descriptor will be
          * created if it does not yet exist. */
         FolderDescr &fd = mFolderHash[col.remoteId()];
@@ -303,123 +359,47 @@ void EwsFetchFoldersIncrJobPrivate::localFolderFetchDone(KJob *job)
     if (!processRemoteFolders()) {
         q->setErrorMsg(QStringLiteral("Failed to process remote folder list."));
         q->emitResult();
+        return;
     }
 
-    if (!mPendingMoveJobs) {
-        q->emitResult();
-    }
-    /* Otherwise wait for the move requests to finish. */
+    /* Apply any collection creations and moves before returning the changes. */
+    startNextOperation();
 }
 
 bool EwsFetchFoldersIncrJobPrivate::processRemoteFolders()
 {
     Q_Q(EwsFetchFoldersIncrJob);
 
-    /* The list of top-level collections. It contains identifiers of collections for which the
-     * parent collection is not in the folder hash. This list is used at a later stage when
-     * setting collections parents. Building a top-level list is necessary as those updates can
-     * only be safely performed down the tree. */
-    QStringList topLevelList;
-
-    bool reparentPassNeeded = false;
-
-    /* Iterate over all changed folders. */
-    for (auto it = mFolderHash.begin(); it != mFolderHash.end(); ++it) {
-        qCDebugNC(EWSRES_LOG) << QStringLiteral("Processing: ") << it.key();
-
-        if (it->isModified()) {
-            qCDebugNC(EWSRES_LOG) << QStringLiteral("Collection was modified");
-            updateFolderCollection(it->collection, it->ewsFolder);
-
-            if (it->parent() != it->collection.parentCollection().remoteId()) {
-                /* This collection has been moved. Since Akonadi currently cannot handle collection
-                 * moves the resource needs to manually move it. */
-                qCDebugNC(EWSRES_LOG) << QStringLiteral("Collection was moved");
-
-                /* Before moving check if the parent exists and has been processed. */
-                auto parentIt = mFolderHash.find(it->parent());
-                if (parentIt == mFolderHash.end()) {
-                    q->setErrorMsg(QStringLiteral("Found moved collection without new parent."));
-                    return false;
-                }
-
-                if (parentIt->isCreated()) {
-                    /* Further workarounds could be done here to ensure that the parent is manually
-                     * created before triggering a move but this would just unnecessarily complicate
-                     * matters. Instead just surrender and retry with a full sync. */
-                    q->setErrorMsg(QStringLiteral("Found moved collection to a just created parent."));
-                    return false;
-                }
-
-                if (!parentIt->isProcessed()) {
-                    qCDebugNC(EWSRES_LOG) << QStringLiteral("Parent not yet processed - delaying");
-                    /* The new parent collection is not yet processed - defer the move to make
-                     * sure all the oprtations are done in down-the-tree order. */
-                    reparentPassNeeded = true;
-                } else {
-                    moveCollection(*it);
-                    it->collection.setParentCollection(parentIt->collection);
-                    it->flags |= FolderDescr::Processed;
-                }
-            } else {
-                /* No collection move happening so nothing else to for this one. */
-                it->flags |= FolderDescr::Processed;
-            }
-        } else if (it->isCreated()) {
-            qCDebugNC(EWSRES_LOG) << QStringLiteral("Collection was created");
-            it->collection.setRemoteId(it.key());
-            updateFolderCollection(it->collection, it->ewsFolder);
-
-            auto parentIt = mFolderHash.find(it->parent());
-            if (parentIt == mFolderHash.end()) {
-                q->setErrorMsg(QStringLiteral("Found created collection without parent."));
-                return false;
-            }
-
-            /* Check if the parent has already been processed. If yes, set the parent of this
-             * collection and mark this one as done. Otherwise a second pass will be needed later. */
-            if (parentIt->isProcessed()) {
-                qCDebugNC(EWSRES_LOG) << QStringLiteral("Processing");
-                it->collection.setParentCollection(parentIt->collection);
-                it->flags |= FolderDescr::Processed;
-            } else {
-                qCDebugNC(EWSRES_LOG) << QStringLiteral("Parent not yet processed - delaying");
-                reparentPassNeeded = true;
-            }
+    /* Build the parent->child map and find the starting points of the traversal - the folders,
+     * for which the parent is not in the folder hash. */
+    QStringList pending;
+    for (auto it = mFolderHash.cbegin(); it != mFolderHash.cend(); ++it) {
+        QString parent = it->parent();
+        if (!parent.isNull() && mFolderHash.contains(parent)) {
+            mParentMap.insert(parent, it.key());
         } else {
-            qCDebugNC(EWSRES_LOG) << QStringLiteral("Collection is not remotely changed");
-            /* This is either a deleted folder or a parent to an added collection. No processing
-             * needed for either of those. */
-            it->flags |= FolderDescr::Processed;
-        }
-
-        /* Check if this collection is a top-level collection. */
-        if (!mFolderHash.contains(it->parent())) {
-            qCDebugNC(EWSRES_LOG) << QStringLiteral("Collection is top level");
-            topLevelList.append(it.key());
-        }
-
-        /* Put the collection into the parent map. This will help running the reparent pass. */
-        if (!it->parent().isNull()) {
-            mParentMap.insert(it->parent(), it.key());
+            pending.append(it.key());
         }
     }
 
-    if (reparentPassNeeded) {
-        qCDebugNC(EWSRES_LOG) << QStringLiteral("Executing reparent pass") << topLevelList;
-        Q_FOREACH(const QString &id, topLevelList) {
-            reparentRemoteFolder(id);
+    /* Visit all folders down-the-tree. */
+    while (!pending.isEmpty()) {
+        QString id = pending.takeLast();
+        FolderDescr &fd = mFolderHash[id];
+        if (!processRemoteFolder(id, fd)) {
+            return false;
         }
+        pending.append(mParentMap.values(id));
     }
 
     /* Build the resulting collection list. */
-    for (auto it = mFolderHash.begin(); it != mFolderHash.end(); ++it) {
+    for (auto it = mFolderHash.cbegin(); it != mFolderHash.cend(); ++it) {
         if (it->isRemoved()) {
             q->mDeletedFolders.append(it->collection);
         } else if (it->isProcessed()) {
             q->mChangedFolders.append(it->collection);
         } else {
-            qCWarningNC(EWSRES_LOG) << QStringLiteral("Found unprocessed collection %1").arg(it.key());
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Found unprocessed collection %1").arg(ewsHash(it.key()));
             return false;
         }
     }
@@ -427,50 +407,131 @@ bool EwsFetchFoldersIncrJobPrivate::processRemoteFolders()
     return true;
 }
 
-void EwsFetchFoldersIncrJobPrivate::reparentRemoteFolder(const QString &id)
+bool EwsFetchFoldersIncrJobPrivate::processRemoteFolder(const QString &id, FolderDescr &fd)
 {
-    qCDebugNC(EWSRES_LOG) << QStringLiteral("Reparenting") << id;
-    QStringList children = mParentMap.values(id);
-    FolderDescr &fd = mFolderHash[id];
-    Q_FOREACH(const QString &childId, children) {
-        FolderDescr &childFd = mFolderHash[childId];
-        if (!childFd.isProcessed() && childFd.isModified() &&
-            childFd.parent() != childFd.collection.parentCollection().remoteId()) {
-            qCDebugNC(EWSRES_LOG) << QStringLiteral("Found moved collection");
-            /* Found unprocessed collection move. */
-            moveCollection(childFd);
-        }
+    Q_Q(EwsFetchFoldersIncrJob);
+
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Processing: ") << ewsHash(id);
 
-        childFd.collection.setParentCollection(fd.collection);
-        reparentRemoteFolder(childId);
+    if (fd.isProcessed()) {
+        /* Reference collection (parent of a created folder) - nothing to do. */
+    } else if (fd.isModified()) {
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Collection was modified");
+        updateFolderCollection(fd.collection, fd.ewsFolder);
+
+        if (fd.parent() != fd.collection.parentCollection().remoteId()) {
+            /* This collection has been moved. Since Akonadi currently cannot handle collection
+             * moves the resource needs to manually move it. */
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("Collection was moved");
+
+            auto parentIt = mFolderHash.constFind(fd.parent());
+            if (parentIt == mFolderHash.cend()) {
+                q->setErrorMsg(QStringLiteral("Found moved collection without new parent."));
+                return false;
+            }
+
+            if (parentIt->isCreated()) {
+                /* The new parent does not exist in Akonadi yet - create it first. */
+                scheduleParentCreation(fd.parent());
+            }
+            mOperations.append({Operation::Move, id});
+
+            fd.collection.setParentCollection(parentIt->collection);
+        }
+    } else if (fd.isCreated()) {
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Collection was created");
+        fd.collection.setRemoteId(id);
+        updateFolderCollection(fd.collection, fd.ewsFolder);
+
+        auto parentIt = mFolderHash.constFind(fd.parent());
+        if (parentIt == mFolderHash.cend()) {
+            q->setErrorMsg(QStringLiteral("Found created collection without parent."));
+            return false;
+        }
+        fd.collection.setParentCollection(parentIt->collection);
+    } else {
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Collection is not remotely changed");
+        /* This is a deleted folder. No processing needed. */
     }
+
     fd.flags |= FolderDescr::Processed;
+
+    return true;
 }
 
-void EwsFetchFoldersIncrJobPrivate::moveCollection(const FolderDescr &fd)
+void EwsFetchFoldersIncrJobPrivate::scheduleParentCreation(const QString &id)
 {
-    qCDebugNC(EWSRES_LOG) << QStringLiteral("Moving collection") << fd.collection.remoteId() <<
-                    QStringLiteral("from") << fd.collection.parentCollection().remoteId() <<
-                    QStringLiteral("to") << fd.parent();
-    CollectionMoveJob *job = new CollectionMoveJob(fd.collection, mFolderHash[fd.parent()].collection);
-    connect(job, &CollectionMoveJob::result, this, &EwsFetchFoldersIncrJobPrivate::localFolderMoveDone);
-    mPendingMoveJobs++;
-    job->start();
+    /* Walk up the chain of newly created folders and schedule their creation top-down. Since the
+     * folders are processed down-the-tree all of them have already been processed. */
+    QList<Operation> ops;
+    QString curId = id;
+    while (mFolderHash.value(curId).isCreated() && !mCreateScheduled.contains(curId)) {
+        mCreateScheduled.insert(curId);
+        ops.prepend({Operation::Create, curId});
+        curId = mFolderHash.value(curId).parent();
+    }
+    mOperations += ops;
 }
 
-void EwsFetchFoldersIncrJobPrivate::localFolderMoveDone(KJob *job)
+void EwsFetchFoldersIncrJobPrivate::startNextOperation()
+{
+    Q_Q(EwsFetchFoldersIncrJob);
+
+    if (mOperations.isEmpty()) {
+        q->emitResult();
+        return;
+    }
+
+    Operation op = mOperations.takeFirst();
+    const FolderDescr &fd = mFolderHash[op.id];
+    /* Always refer to the current parent object, as it may have been created in the meantime. */
+    const Collection &parent = mFolderHash[fd.parent()].collection;
+
+    if (op.type == Operation::Create) {
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Creating collection") << ewsHash(op.id);
+        Collection col = fd.collection;
+        col.setParentCollection(parent);
+        CollectionCreateJob *job = new CollectionCreateJob(col, this);
+        job->setProperty("folderId", op.id);
+        connect(job, &CollectionCreateJob::result, this, &EwsFetchFoldersIncrJobPrivate::localFolderCreateDone);
+        job->start();
+    } else {
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Moving collection") << ewsHash(op.id) <<
+                        QStringLiteral("to") << ewsHash(fd.parent());
+        CollectionMoveJob *job = new CollectionMoveJob(fd.collection, parent, this);
+        connect(job, &CollectionMoveJob::result, this, &EwsFetchFoldersIncrJobPrivate::localFolderMoveDone);
+        job->start();
+    }
+}
+
+void EwsFetchFoldersIncrJobPrivate::localFolderCreateDone(KJob *job)
 {
     Q_Q(EwsFetchFoldersIncrJob);
 
     if (job->error()) {
-        q->setErrorMsg(QStringLiteral("Failed to move collection."));
+        q->setErrorMsg(QStringLiteral("Failed to create collection."));
         q->emitResult();
         return;
     }
 
-    if (--mPendingMoveJobs == 0) {
+    CollectionCreateJob *createJob = qobject_cast<CollectionCreateJob*>(job);
+    Q_ASSERT(createJob);
+    mFolderHash[job->property("folderId").toString()].collection = createJob->collection();
+
+    startNextOperation();
+}
+
+void EwsFetchFoldersIncrJobPrivate::localFolderMoveDone(KJob *job)
+{
+    Q_Q(EwsFetchFoldersIncrJob);
+
+    if (job->error()) {
+        q->setErrorMsg(QStringLiteral("Failed to move collection."));
         q->emitResult();
+        return;
     }
+
+    startNextOperation();
 }
 
 void EwsFetchFoldersIncrJobPrivate::updateFolderCollection(Collection &collection, const EwsFolder &folder)
@@ -535,6 +596,13 @@ EwsFetchFoldersIncrJob::~EwsFetchFoldersIncrJob()
 {
 }
 
+void EwsFetchFoldersIncrJob::setFolderTree(const EwsFolderTree *tree)
+{
+    Q_D(EwsFetchFoldersIncrJob);
+
+    d->mFolderTree = tree;
+}
+
 void EwsFetchFoldersIncrJob::start()
 {
     Q_D(const EwsFetchFoldersIncrJob);
@@ -29,6 +29,7 @@
 
 class EwsClient;
 class EwsFetchFoldersIncrJobPrivate;
+class EwsFolderTree;
 
 class EwsFetchFoldersIncrJob : public EwsJob
 {
@@ -42,6 +43,8 @@ public:
     Akonadi::Collection::List deletedFolders() const { return mDeletedFolders; };
     const QString &syncState() const { return mSyncState; };
 
+    void setFolderTree(const EwsFolderTree *tree);
+
     virtual void start() Q_DECL_OVERRIDE;
 Q_SIGNALS:
     void status(int status, const QString &message = QString());
@@ -19,6 +19,8 @@
 
 #include "ewsfetchfoldersjob.h"
 
+#include <QElapsedTimer>
+
 #include <KMime/Message>
 #include <KCalCore/Event>
 #include <KCalCore/Todo>
@@ -39,7 +41,17 @@ using namespace Akonadi;
 
 static const EwsPropertyField propPidTagContainerClass(0x3613, EwsPropTypeString);
 
-static Q_CONSTEXPR int fetchBatchSize = 50;
+/* Initial number of folders to retrieve details for in a single request. The batch size is
+ * adjusted later depending on how fast the server responds. */
+static Q_CONSTEXPR int initialFetchBatchSize = 50;
+static Q_CONSTEXPR int minFetchBatchSize = 10;
+static Q_CONSTEXPR int maxFetchBatchSize = 200;
+
+/* Maximum number of folder detail requests running in parallel. */
+static Q_CONSTEXPR int maxParallelFetches = 4;
+
+/* Batches answered faster than half of this time grow, batches answered slower shrink. */
+static Q_CONSTEXPR qint64 targetFetchTime = 5000; /* milliseconds */
 
 class EwsFetchFoldersJobPrivate : public QObject
 {
@@ -48,11 +60,12 @@ public:
                               const Collection &rootCollection);
     ~EwsFetchFoldersJobPrivate();
 
-    void processRemoteFolders();
+    void addRemoteFolders(const EwsFolder::List &folders);
+    void addCollection(Collection col);
     Collection createFolderCollection(const EwsFolder &folder);
 
-    void buildCollectionList();
-    void buildChildCollectionList(const Collection &col);
+    void startDetailFetches();
+    void finishCollectionList();
 public Q_SLOTS:
     void remoteFolderFullFetchDone(KJob *job);
     void remoteFolderIdFullFetchDone(KJob *job);
@@ -62,11 +75,16 @@ public:
     int mPendingFetchJobs;
     int mPendingMoveJobs;
     EwsId::List mRemoteFolderIds;
+    int mNextFetchIndex;
+    bool mRemoteFolderIdsComplete;
+    EwsId::List mRetryFolderIds;
+    int mFetchBatchSize;
 
     const Collection &mRootCollection;
 
-    EwsFolder::List mRemoteChangedFolders;  // Contains details of folders that need update
-                                            // (either created or changed)
+    /* Collections already attached to the tree, keyed by the EWS ID. */
+    QHash<QString, Akonadi::Collection> mTreeCollections;
+    /* Collections waiting for their parent to arrive, keyed by the EWS ID. */
     QHash<QString, Akonadi::Collection> mCollectionMap;
     QMultiHash<QString, QString> mParentMap;
 
@@ -80,6 +98,9 @@ EwsFetchFoldersJobPrivate::EwsFetchFoldersJobPrivate(EwsFetchFoldersJob *parent,
 {
     mPendingFetchJobs = 0;
     mPendingMoveJobs = 0;
+    mNextFetchIndex = 0;
+    mRemoteFolderIdsComplete = false;
+    mFetchBatchSize = initialFetchBatchSize;
 }
 
 EwsFetchFoldersJobPrivate::~EwsFetchFoldersJobPrivate()
@@ -104,6 +125,13 @@ void EwsFetchFoldersJobPrivate::remoteFolderFullFetchDone(KJob *job)
          * try to fallback to fetching just the folder identifiers and retrieve the details later. */
         qCDebug(EWSRES_LOG) << QStringLiteral("Full fetch failed. Trying to fetch ids only.");
 
+        /* Start over - drop anything retrieved so far. */
+        q->mFolders.clear();
+        mTreeCollections.clear();
+        mCollectionMap.clear();
+        mParentMap.clear();
+        addCollection(mRootCollection);
+
         EwsSyncFolderHierarchyRequest *syncFoldersReq = new EwsSyncFolderHierarchyRequest(mClient, this);
         syncFoldersReq->setFolderId(EwsId(EwsDIdMsgFolderRoot));
         EwsFolderShape shape(EwsShapeIdOnly);
@@ -116,20 +144,20 @@ void EwsFetchFoldersJobPrivate::remoteFolderFullFetchDone(KJob *job)
         return;
     }
 
+    EwsFolder::List folders;
     Q_FOREACH(const EwsSyncFolderHierarchyRequest::Change &ch, req->changes()) {
         if (ch.type() == EwsSyncFolderHierarchyRequest::Create) {
-            mRemoteChangedFolders.append(ch.folder());
+            folders.append(ch.folder());
         } else {
             q->setErrorMsg(QStringLiteral("Got non-create change for full sync."));
             q->emitResult();
             return;
         }
     }
+    addRemoteFolders(folders);
 
     if (req->includesLastItem()) {
-        processRemoteFolders();
-
-        buildCollectionList();
+        finishCollectionList();
 
         q->mSyncState = req->syncState();
 
@@ -175,27 +203,16 @@ void EwsFetchFoldersJobPrivate::remoteFolderIdFullFetchDone(KJob *job)
         }
     }
 
-    if (req->includesLastItem()) {
-        EwsFolderShape shape(EwsShapeDefault);
-        shape << propPidTagContainerClass;
-        shape << EwsPropertyField("folder:EffectiveRights");
-        shape << EwsPropertyField("folder:ParentFolderId");
-        mPendingFetchJobs = 0;
-
-        for (int i = 0; i < mRemoteFolderIds.size(); i += fetchBatchSize) {
-            EwsGetFolderRequest *req = new EwsGetFolderRequest(mClient, this);
-            req->setFolderIds(mRemoteFolderIds.mid(i, fetchBatchSize));
-            req->setFolderShape(shape);
-            connect(req, &EwsSyncFolderHierarchyRequest::result, this,
-                    &EwsFetchFoldersJobPrivate::remoteFolderDetailFetchDone);
-            req->start();
-            q->addSubjob(req);
-            mPendingFetchJobs++;
-        }
-
-        qCDebugNC(EWSRES_LOG) << QStringLiteral("Starting %1 folder fetch jobs.").arg(mPendingFetchJobs);
+    /* Start retrieving folder details while the remaining identifiers are still coming in. */
+    startDetailFetches();
 
+    if (req->includesLastItem()) {
         q->mSyncState = req->syncState();
+        mRemoteFolderIdsComplete = true;
+        if (mPendingFetchJobs == 0) {
+            finishCollectionList();
+            q->emitResult();
+        }
     } else {
         EwsSyncFolderHierarchyRequest *syncFoldersReq = new EwsSyncFolderHierarchyRequest(mClient, this);
         syncFoldersReq->setFolderId(EwsId(EwsDIdMsgFolderRoot));
@@ -209,6 +226,43 @@ void EwsFetchFoldersJobPrivate::remoteFolderIdFullFetchDone(KJob *job)
     }
 }
 
+void EwsFetchFoldersJobPrivate::startDetailFetches()
+{
+    EwsFolderShape shape(EwsShapeDefault);
+    shape << propPidTagContainerClass;
+    shape << EwsPropertyField("folder:EffectiveRights");
+    shape << EwsPropertyField("folder:ParentFolderId");
+
+    while (mPendingFetchJobs < maxParallelFetches) {
+        EwsId::List ids;
+        if (!mRetryFolderIds.isEmpty()) {
+            ids = mRetryFolderIds.mid(0, mFetchBatchSize);
+            mRetryFolderIds = mRetryFolderIds.mid(ids.size());
+        } else if (mNextFetchIndex < mRemoteFolderIds.size()) {
+            ids = mRemoteFolderIds.mid(mNextFetchIndex, mFetchBatchSize);
+            mNextFetchIndex += ids.size();
+        } else {
+            break;
+        }
+
+        /* Requests are not added as subjobs as failed batches are retried rather than failing
+         * the whole job. */
+        EwsGetFolderRequest *req = new EwsGetFolderRequest(mClient, this);
+        req->setFolderIds(ids);
+        req->setFolderShape(shape);
+        QElapsedTimer timer;
+        timer.start();
+        req->setProperty("startTime", timer.msecsSinceReference());
+        connect(req, &EwsGetFolderRequest::result, this,
+                &EwsFetchFoldersJobPrivate::remoteFolderDetailFetchDone);
+        req->start();
+        mPendingFetchJobs++;
+    }
+
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("%1 folder fetch jobs pending (batch size %2).")
+                    .arg(mPendingFetchJobs).arg(mFetchBatchSize);
+}
+
 void EwsFetchFoldersJobPrivate::remoteFolderDetailFetchDone(KJob *job)
 {
     Q_Q(EwsFetchFoldersJob);
@@ -221,79 +275,103 @@ void EwsFetchFoldersJobPrivate::remoteFolderDetailFetchDone(KJob *job)
         return;
     }
 
-    if (req->error()) {
+    if (q->error()) {
+        /* The job has already failed - ignore any stragglers. */
         return;
     }
 
-    Q_FOREACH(const EwsGetFolderRequest::Response& resp, req->responses()) {
-        if (resp.isSuccess()) {
-            mRemoteChangedFolders.append(resp.folder());
-        } else {
-            qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to fetch folder details.");
+    mPendingFetchJobs--;
+
+    int batchSize = req->folderIds().size();
+    if (req->error()) {
+        /* Large batches are the most likely cause of server-side failures - retry the folders
+         * using smaller batches unless they are already at the minimum. */
+        if (batchSize <= minFetchBatchSize) {
+            q->setErrorMsg(req->errorString());
+            q->emitResult();
+            return;
+        }
+        mFetchBatchSize = qMax(batchSize / 2, minFetchBatchSize);
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Folder fetch failed - retrying with batch size %1.")
+                        .arg(mFetchBatchSize);
+        mRetryFolderIds = req->folderIds() + mRetryFolderIds;
+    } else {
+        QElapsedTimer timer;
+        timer.start();
+        qint64 elapsed = timer.msecsSinceReference() - req->property("startTime").toLongLong();
+        if (elapsed > targetFetchTime) {
+            mFetchBatchSize = qMax(mFetchBatchSize / 2, minFetchBatchSize);
+        } else if (elapsed < targetFetchTime / 2 && batchSize >= mFetchBatchSize) {
+            mFetchBatchSize = qMin(mFetchBatchSize * 2, maxFetchBatchSize);
+        }
+
+        EwsFolder::List folders;
+        Q_FOREACH(const EwsGetFolderRequest::Response& resp, req->responses()) {
+            if (resp.isSuccess()) {
+                folders.append(resp.folder());
+            } else {
+                qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to fetch folder details.");
+            }
         }
+        addRemoteFolders(folders);
     }
 
-    mPendingFetchJobs--;
-    qCDebugNC(EWSRES_LOG) << QStringLiteral("%1 folder fetch jobs pending").arg(mPendingFetchJobs);
+    startDetailFetches();
 
-    if (mPendingFetchJobs == 0) {
+    if (mPendingFetchJobs == 0 && mRemoteFolderIdsComplete) {
         qCDebugNC(EWSRES_LOG) << QStringLiteral("All folder fetch jobs complete");
 
-        processRemoteFolders();
-
-        buildCollectionList();
-
+        finishCollectionList();
 
         q->emitResult();
-   }
+    }
 }
 
-void EwsFetchFoldersJobPrivate::processRemoteFolders()
+void EwsFetchFoldersJobPrivate::addRemoteFolders(const EwsFolder::List &folders)
 {
-    /* mCollectionMap contains the global collection list keyed by the EWS ID. */
-    /* mParentMap contains the parent->child map for each collection. */
-
-    /* Iterate over all changed folders. */
-    Q_FOREACH(const EwsFolder &folder, mRemoteChangedFolders) {
-        /* Create a collection for each folder. */
+    /* The collection tree is assembled as folders come in. Each folder is attached to the tree as
+     * soon as its parent is known. Otherwise it waits in mCollectionMap and mParentMap holds the
+     * parent->child relationship until the parent arrives. */
+    Q_FOREACH(const EwsFolder &folder, folders) {
         Collection c = createFolderCollection(folder);
-
-        /* Insert it into the global collection list. */
-        mCollectionMap.insert(c.remoteId(), c);
-
-        /* Determine the parent and insert a parent->child relationship.
-         * Don't use Collection::setParentCollection() yet as the collection object will be updated
-         * which will cause the parent->child relationship to be broken. This happens because the
-         * collection object holds a copy of the parent collection object. An update to that
-         * object in the list will not be visible in the copy inside of the child object. */
         EwsId parentId = folder[EwsFolderFieldParentFolderId].value<EwsId>();
-        mParentMap.insert(parentId.id(), c.remoteId());
+
+        QHash<QString, Collection>::const_iterator it = mTreeCollections.constFind(parentId.id());
+        if (it != mTreeCollections.cend()) {
+            c.setParentCollection(*it);
+            addCollection(c);
+        } else {
+            mCollectionMap.insert(c.remoteId(), c);
+            mParentMap.insert(parentId.id(), c.remoteId());
+        }
     }
 }
 
-void EwsFetchFoldersJobPrivate::buildCollectionList()
+void EwsFetchFoldersJobPrivate::addCollection(Collection col)
 {
     Q_Q(EwsFetchFoldersJob);
 
+    /* The collection is final once added to the tree. This is important as each child holds
+     * a copy of its parent collection object. Any later update to the parent would not be
+     * visible in the copy inside of the child object. */
+    q->mFolders.append(col);
+    mTreeCollections.insert(col.remoteId(), col);
 
-    q->mFolders.append(mRootCollection);
-    buildChildCollectionList(mRootCollection);
-
-    if (!mCollectionMap.isEmpty()) {
-        q->setErrorMsg(QStringLiteral("Found orphaned collections"));
+    QStringList children = mParentMap.values(col.remoteId());
+    mParentMap.remove(col.remoteId());
+    Q_FOREACH(const QString &childId, children) {
+        Collection child(mCollectionMap.take(childId));
+        child.setParentCollection(col);
+        addCollection(child);
     }
 }
 
-void EwsFetchFoldersJobPrivate::buildChildCollectionList(const Collection &col)
+void EwsFetchFoldersJobPrivate::finishCollectionList()
 {
     Q_Q(EwsFetchFoldersJob);
 
-    QStringList children = mParentMap.values(col.remoteId());
-    Q_FOREACH(const QString &childId, children) {
-        Collection child(mCollectionMap.take(childId));
-        child.setParentCollection(col);
-        q->mFolders.append(child);
-        buildChildCollectionList(child);
+    if (!mCollectionMap.isEmpty()) {
+        q->setErrorMsg(QStringLiteral("Found orphaned collections"));
     }
 }
 
@@ -364,7 +442,7 @@ EwsFetchFoldersJob::~EwsFetchFoldersJob()
 
 void EwsFetchFoldersJob::start()
 {
-    Q_D(const EwsFetchFoldersJob);
+    Q_D(EwsFetchFoldersJob);
 
     EwsSyncFolderHierarchyRequest *syncFoldersReq = new EwsSyncFolderHierarchyRequest(d->mClient, this);
     syncFoldersReq->setFolderId(EwsId(EwsDIdMsgFolderRoot));
@@ -378,6 +456,7 @@ void EwsFetchFoldersJob::start()
     }
     connect(syncFoldersReq, &EwsSyncFolderHierarchyRequest::result, d,
             &EwsFetchFoldersJobPrivate::remoteFolderFullFetchDone);
+    d->addCollection(d->mRootCollection);
     // Don't add this as a subjob as the error is handled in its own way rather than throwing an
     // error code to the parent.
 
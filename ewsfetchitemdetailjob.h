@@ -47,12 +47,20 @@ public:
         return mChangedItems;
     }
 
+    /* Items discovered while processing the details, which need to be fetched as well (for
+     * example exceptions of recurring calendar items). */
+    Akonadi::Item::List additionalItems() const
+    {
+        return mAdditionalItems;
+    }
+
     virtual void start() Q_DECL_OVERRIDE;
 protected:
     virtual void processItems(const QList<EwsGetItemRequest::Response> &responses) = 0;
 
     QPointer<EwsGetItemRequest> mRequest;
     Akonadi::Item::List mChangedItems;
+    Akonadi::Item::List mAdditionalItems;
     Akonadi::Item::List *mDeletedItems;
     EwsClient &mClient;
     const Akonadi::Collection mCollection;
@@ -21,6 +21,7 @@
 
 #include <AkonadiCore/ItemFetchJob>
 #include <AkonadiCore/ItemFetchScope>
+#include <AkonadiCore/ItemSync>
 
 #include "ewsfinditemrequest.h"
 #include "ewssyncfolderitemsrequest.h"
@@ -38,6 +39,12 @@ using namespace Akonadi;
 static Q_CONSTEXPR int listBatchSize = 100;
 static Q_CONSTEXPR int fetchBatchSize = 50;
 
+/* Number of item ids retrieved at once when listing the whole folder content. */
+static Q_CONSTEXPR int idListBatchSize = 1000;
+
+/* Maximum number of item detail batches fetched in parallel. */
+static Q_CONSTEXPR int maxParallelDetailFetches = 3;
+
 /**
  * The fetch items job is processed in two stages.
  *
@@ -81,14 +88,44 @@ static Q_CONSTEXPR int fetchBatchSize = 50;
  * any more) and the incremental sync returns a delete event for this item. Typically this would
  * result in an error and force a full sync. Providing this list allows for this particular error
  * to be safely ignored.
+ *
+ * The remote item list is retrieved in pages of listBatchSize changes. Each page is processed
+ * through stage 2 on its own and all pages except the last one are written to Akonadi straight
+ * away using an ItemSync job. Once such page is committed the sync state returned with it is
+ * reported as a checkpoint so that an interrupted sync of a large folder can be resumed from the
+ * last applied page instead of starting from scratch. The last page is returned as the job result
+ * and applied by the resource. In case of a full sync the local items not matched by any page are
+ * only deleted once the last page has been processed. Checkpoints of a full sync are flagged as
+ * such and the resource resumes them with resumeFullSync(), so that the sync stays a full one. The
+ * resumed job cannot tell the local items matched before the interruption from the stale ones.
+ * Therefore once it reaches the last page it lists the ids of all items in the remote folder and
+ * only deletes the local items missing from that list.
+ *
+ * Item details are fetched in batches of fetchBatchSize items, with up to maxParallelDetailFetches
+ * batches in flight. Processing a batch may reveal further items to fetch, such as exceptions of
+ * recurring calendar items. These are collected across batches and fed into the same pipeline,
+ * so that they neither require a separate round trip per batch nor delay the other batches.
+ *
+ * For calendar folders the job can be limited to a time window around the current date. In such
+ * case an additional EwsFindItemRequest with a calendar view is issued in stage 1 to determine
+ * which items have occurrences within the window. Items which are new to Akonadi and lie outside
+ * of the window are stored without payload, which is retrieved later when the item is accessed.
+ * Unchanged local items outside of the window are not refetched during a full sync. As the window
+ * moves on, items which entered it since the last sync and have no cached payload are fetched
+ * during an incremental sync.
+ *
+ * A sync can be preempted to make way for a more important folder. In such case the job finishes
+ * as soon as the current page has been applied and returns the checkpoint as its sync state.
  */
 
 EwsFetchItemsJob::EwsFetchItemsJob(const Collection &collection, EwsClient &client,
                                    const QString &syncState, const EwsId::List &itemsToCheck,
                                    EwsTagStore *tagStore, EwsResource *parent)
     : EwsJob(parent), mCollection(collection), mClient(client), mItemsToCheck(itemsToCheck),
-      mPendingJobs(0), mTotalItems(0), mSyncState(syncState), mFullSync(syncState.isNull()),
-      mTagStore(tagStore), mTagsSynced(false)
+      mRunningDetailJobs(0), mPendingJobs(0), mTotalItems(0), mSyncState(syncState), mFullSync(syncState.isNull()),
+      mResumedFullSync(false), mRemoteIdsListed(false),
+      mIncludesLastItem(false), mCheckpointed(false), mPreemptRequested(false), mPreempted(false), mTagStore(tagStore), mTagsSynced(false),
+      mWindowRolled(false)
 {
     qRegisterMetaType<EwsId::List>();
 }
@@ -100,28 +137,23 @@ EwsFetchItemsJob::~EwsFetchItemsJob()
 void EwsFetchItemsJob::start()
 {
     /* Begin stage 1 - query item list from local and remote side. */
-    EwsSyncFolderItemsRequest *syncItemsReq = new EwsSyncFolderItemsRequest(mClient, this);
-    syncItemsReq->setFolderId(EwsId(mCollection.remoteId(), mCollection.remoteRevision()));
-    EwsItemShape shape(EwsShapeIdOnly);
-    shape << EwsResource::tagsProperty;
-    syncItemsReq->setItemShape(shape);
-    if (!mSyncState.isNull()) {
-        syncItemsReq->setSyncState(mSyncState);
-    }
-    syncItemsReq->setMaxChanges(listBatchSize);
-    connect(syncItemsReq, &EwsSyncFolderItemsRequest::result, this, &EwsFetchItemsJob::remoteItemFetchDone);
-    addSubjob(syncItemsReq);
-
     ItemFetchJob *itemJob = new ItemFetchJob(mCollection);
     ItemFetchScope itemScope;
     itemScope.setCacheOnly(true);
-    itemScope.fetchFullPayload(false);
+    if (mWindowStart.isValid()) {
+        /* Needed to find the in-window items, which have no payload cached. */
+        itemScope.fetchFullPayload(true);
+        itemScope.setCheckForCachedPayloadPartsOnly(true);
+        itemScope.setFetchGid(true);
+    } else {
+        itemScope.fetchFullPayload(false);
+    }
     itemJob->setFetchScope(itemScope);
     connect(itemJob, &ItemFetchJob::result, this, &EwsFetchItemsJob::localItemFetchDone);
     addSubjob(itemJob);
 
     mPendingJobs = 2;
-    syncItemsReq->start();
+    startSyncRequest();
     itemJob->start();
 
     if (!mItemsToCheck.isEmpty()) {
@@ -132,6 +164,18 @@ void EwsFetchItemsJob::start()
         ++mPendingJobs;
         getItemReq->start();
     }
+
+    if (mWindowStart.isValid()) {
+        EwsFindItemRequest *findItemReq = new EwsFindItemRequest(mClient, this);
+        findItemReq->setFolderId(EwsId(mCollection.remoteId()));
+        EwsItemShape shape(EwsShapeIdOnly);
+        shape << EwsPropertyField("calendar:UID");
+        findItemReq->setItemShape(shape);
+        findItemReq->setCalendarView(mWindowStart, mWindowEnd);
+        connect(findItemReq, &EwsFindItemRequest::result, this, &EwsFetchItemsJob::calendarViewFetchDone);
+        ++mPendingJobs;
+        findItemReq->start();
+    }
 }
 
 void EwsFetchItemsJob::localItemFetchDone(KJob *job)
@@ -148,7 +192,9 @@ void EwsFetchItemsJob::localItemFetchDone(KJob *job)
 
     if (!fetchJob->error()) {
         removeSubjob(job);
-        mLocalItems = fetchJob->items();
+        Q_FOREACH(const Item& item, fetchJob->items()) {
+            mLocalItems.insert(item.remoteId(), item);
+        }
         --mPendingJobs;
         if (mPendingJobs == 0) {
             compareItemLists();
@@ -189,25 +235,11 @@ void EwsFetchItemsJob::remoteItemFetchDone(KJob *job)
             }
         }
 
-        if (!itemReq->includesLastItem()) {
-            EwsSyncFolderItemsRequest *syncItemsReq = new EwsSyncFolderItemsRequest(mClient, this);
-            syncItemsReq->setFolderId(EwsId(mCollection.remoteId(), mCollection.remoteRevision()));
-            EwsItemShape shape(EwsShapeIdOnly);
-            shape << EwsResource::tagsProperty;
-            syncItemsReq->setItemShape(shape);
-            syncItemsReq->setSyncState(itemReq->syncState());
-            syncItemsReq->setMaxChanges(listBatchSize);
-            connect(syncItemsReq, SIGNAL(result(KJob*)), SLOT(remoteItemFetchDone(KJob*)));
-            addSubjob(syncItemsReq);
-            syncItemsReq->start();
-            qDebug() << "remoteItemFetchDone: started next batch";
-        }
-        else {
-            mSyncState = itemReq->syncState();
-            --mPendingJobs;
-            if (mPendingJobs == 0) {
-                compareItemLists();
-            }
+        mPageSyncState = itemReq->syncState();
+        mIncludesLastItem = itemReq->includesLastItem();
+        --mPendingJobs;
+        if (mPendingJobs == 0) {
+            compareItemLists();
         }
     }
 }
@@ -248,8 +280,57 @@ void EwsFetchItemsJob::checkedItemsFetchFinished(KJob *job)
     }
 }
 
+void EwsFetchItemsJob::calendarViewFetchDone(KJob *job)
+{
+    EwsFindItemRequest *req = qobject_cast<EwsFindItemRequest*>(job);
+
+    if (!req) {
+        setErrorMsg(QStringLiteral("Invalid find item request pointer."));
+        doKill();
+        emitResult();
+        return;
+    }
+
+    if (req->error()) {
+        /* The calendar view may fail for instance when the window contains too many items. In
+         * such case just fall back to a regular sync. */
+        qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to retrieve calendar view of folder %1 - syncing all items: %2")
+                        .arg(ewsHash(mCollection.remoteId())).arg(req->errorString());
+        mWindowStart = QDateTime();
+        mWindowEnd = QDateTime();
+    } else {
+        Q_FOREACH(const EwsItem &item, req->items()) {
+            mWindowIds.insert(item[EwsItemFieldItemId].value<EwsId>().id());
+            QString uid = item[EwsItemFieldUID].toString();
+            if (!uid.isEmpty()) {
+                mWindowUids.insert(uid);
+            }
+        }
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Calendar window of folder %1 contains %2 items")
+                        .arg(ewsHash(mCollection.remoteId())).arg(mWindowIds.size());
+    }
+
+    --mPendingJobs;
+    if (mPendingJobs == 0) {
+        compareItemLists();
+    }
+}
+
+/* Occurrences of recurring items are reported by the calendar view with their own ids, therefore
+ * recurring masters are matched by UID. */
+bool EwsFetchItemsJob::inCalendarWindow(const QString &id, const QString &uid) const
+{
+    return mWindowIds.contains(id) || (!uid.isEmpty() && mWindowUids.contains(uid));
+}
+
 void EwsFetchItemsJob::compareItemLists()
 {
+    if (mResumedFullSync && mIncludesLastItem && !mRemoteIdsListed) {
+        /* Needed to find the stale local items - see the description above. */
+        startRemoteIdListing(0);
+        return;
+    }
+
     /* Begin stage 2 - determine list of new/changed items and fetch details about them. */
 
     Item::List toFetchItems[EwsItemTypeUnknown + 1];
@@ -257,23 +338,27 @@ void EwsFetchItemsJob::compareItemLists()
     Q_EMIT status(1, QStringLiteral("Retrieving items"));
     Q_EMIT percent(0);
 
-    QHash<QString, Item> itemHash;
-    Q_FOREACH(const Item& item, mLocalItems) {
-        itemHash.insert(item.remoteId(), item);
-    }
+    /* Local items matched by this page. They are only removed from the local item list once the
+     * whole page has been processed as the comparison may need to be restarted after a tag sync. */
+    QStringList matchedIds;
+
+    /* New calendar items outside of the sync window, which are stored without payload. */
+    Item::List lazyItems;
 
     Q_FOREACH(const EwsItem &ewsItem, mRemoteAddedItems) {
         /* In case of a full sync all existing items appear as added on the remote side. Therefore
          * look for the item in the local list before creating a new copy. */
         EwsId id(ewsItem[EwsItemFieldItemId].value<EwsId>());
-        QHash<QString, Item>::iterator it = itemHash.find(id.id());
+        QHash<QString, Item>::const_iterator it = mLocalItems.constFind(id.id());
         EwsItemType type = ewsItem.internalType();
         if (type == EwsItemTypeUnknown) {
             /* Ignore unknown items. */
             continue;
         }
         QString mimeType = EwsItemHandler::itemHandler(type)->mimeType();
-        if (it == itemHash.end()) {
+        bool outOfWindow = mWindowStart.isValid() && type == EwsItemTypeCalendarItem &&
+                           !inCalendarWindow(id.id(), ewsItem[EwsItemFieldUID].toString());
+        if (it == mLocalItems.cend()) {
             Item item(mimeType);
             item.setParentCollection(mCollection);
             EwsId id = ewsItem[EwsItemFieldItemId].value<EwsId>();
@@ -284,10 +369,19 @@ void EwsFetchItemsJob::compareItemLists()
                 syncTags();
                 return;
             }
-            toFetchItems[type].append(item);
+            if (outOfWindow) {
+                item.setGid(ewsItem[EwsItemFieldUID].toString());
+                lazyItems.append(item);
+            } else {
+                toFetchItems[type].append(item);
+            }
+        }
+        else if (outOfWindow && it->remoteRevision() == id.changeKey()) {
+            /* Unchanged item outside of the sync window - no need to refetch it. */
+            matchedIds.append(id.id());
         }
         else {
-            Item &item = *it;
+            Item item = *it;
             item.clearPayload();
             item.setRemoteRevision(id.changeKey());
             if (!mTagStore->readEwsProperties(item, ewsItem, mTagsSynced)) {
@@ -296,29 +390,38 @@ void EwsFetchItemsJob::compareItemLists()
                 return;
             }
             toFetchItems[type].append(item);
-            itemHash.erase(it);
+            matchedIds.append(id.id());
         }
     }
 
     if (mFullSync) {
         /* In case of a full sync all items that are still on the local item list do not exist
-         * remotely and need to be deleted locally. */
-        QHash<QString, Item>::iterator it;
-        for (it = itemHash.begin(); it != itemHash.end(); ++it) {
-            mDeletedItems.append(it.value());
+         * remotely and need to be deleted locally. This can only be determined once all pages
+         * have been retrieved. */
+        if (mIncludesLastItem) {
+            Q_FOREACH(const QString &id, matchedIds) {
+                mLocalItems.remove(id);
+            }
+            matchedIds.clear();
+            QHash<QString, Item>::const_iterator it;
+            for (it = mLocalItems.cbegin(); it != mLocalItems.cend(); ++it) {
+                if (!mResumedFullSync || !mRemoteIds.contains(it.key())) {
+                    mDeletedItems.append(it.value());
+                }
+            }
         }
     }
     else {
         Q_FOREACH(const EwsItem &ewsItem, mRemoteChangedItems) {
             EwsId id(ewsItem[EwsItemFieldItemId].value<EwsId>());
-            QHash<QString, Item>::iterator it = itemHash.find(id.id());
-            if (it == itemHash.end()) {
+            QHash<QString, Item>::const_iterator it = mLocalItems.constFind(id.id());
+            if (it == mLocalItems.cend()) {
                 setErrorMsg(QStringLiteral("Got update for item %1, but item not found in local store.")
                                 .arg(ewsHash(id.id())));
                 emitResult();
                 return;
             }
-            Item &item = *it;
+            Item item = *it;
             item.clearPayload();
             item.setRemoteRevision(id.changeKey());
             if (!mTagStore->readEwsProperties(item, ewsItem, mTagsSynced)) {
@@ -328,17 +431,17 @@ void EwsFetchItemsJob::compareItemLists()
             }
             EwsItemType type = ewsItem.internalType();
             toFetchItems[type].append(item);
-            itemHash.erase(it);
+            matchedIds.append(id.id());
         }
 
         // In case of an incremental sync deleted items will be given explicitly. */
         Q_FOREACH(const EwsId &id, mRemoteDeletedIds) {
-            QHash<QString, Item>::iterator it = itemHash.find(id.id());
+            QHash<QString, Item>::const_iterator it = mLocalItems.constFind(id.id());
             /* If one or more items marked as deleted are not found it means that the folder is out
              * of sync. The only way to fix this is to issue a full sync.
              * The only exception is when an item is checked explicitly. In such case the absence
              * of this item can be ignored. */
-            if (it == itemHash.end()) {
+            if (it == mLocalItems.cend()) {
                 QHash<QString, QString>::iterator qit = mQueuedUpdates[EwsDeletedEvent].find(id.id());
                 if (EWSRES_LOG().isDebugEnabled() && qit != mQueuedUpdates[EwsDeletedEvent].end()) {
                     qCDebugNC(EWSRES_LOG) << QStringLiteral("Match for queued deletion of item %1").arg(ewsHash(id.id()));
@@ -351,24 +454,43 @@ void EwsFetchItemsJob::compareItemLists()
                 }
             } else {
                 mDeletedItems.append(*it);
+                matchedIds.append(id.id());
             }
         }
 
         QHash<EwsId, bool>::const_iterator it;
         EwsItemHandler *handler = EwsItemHandler::itemHandler(EwsItemTypeMessage);
         for (it = mRemoteFlagChangedIds.cbegin(); it != mRemoteFlagChangedIds.cend(); ++it) {
-            QHash<QString, Item>::iterator iit = itemHash.find(it.key().id());
-            if (iit == itemHash.end()) {
+            QHash<QString, Item>::const_iterator iit = mLocalItems.constFind(it.key().id());
+            if (iit == mLocalItems.cend()) {
                 setErrorMsg(QStringLiteral("Got read flag change for item %1, but item not found in local store.")
                                 .arg(it.key().id()));
                 emitResult();
                 return;
             }
-            Item &item = *iit;
+            Item item = *iit;
             handler->setSeenFlag(item, it.value());
             mChangedItems.append(item);
-            itemHash.erase(iit);
+            matchedIds.append(it.key().id());
+        }
+    }
+
+    Q_FOREACH(const QString &id, matchedIds) {
+        mLocalItems.remove(id);
+    }
+    mChangedItems += lazyItems;
+
+    if (mWindowStart.isValid() && !mFullSync && !mWindowRolled) {
+        /* Fetch items which have entered the sync window since the last sync. */
+        const QString eventMimeType = EwsItemHandler::itemHandler(EwsItemTypeCalendarItem)->mimeType();
+        QHash<QString, Item>::const_iterator it;
+        for (it = mLocalItems.cbegin(); it != mLocalItems.cend(); ++it) {
+            if (it->mimeType() == eventMimeType && it->cachedPayloadParts().isEmpty() &&
+                inCalendarWindow(it.key(), it->gid())) {
+                toFetchItems[EwsItemTypeCalendarItem].append(*it);
+            }
         }
+        mWindowRolled = true;
     }
 
     qCDebugNC(EWSRES_LOG) << QStringLiteral("Changed %2, deleted %3, new %4")
@@ -379,55 +501,216 @@ void EwsFetchItemsJob::compareItemLists()
     for (unsigned iType = 0; iType < sizeof(toFetchItems) / sizeof(toFetchItems[0]); ++iType) {
         if (!toFetchItems[iType].isEmpty()) {
             qDebug() << "compareItemLists: fetching" << iType;
-            for (int i = 0; i < toFetchItems[iType].size(); i += fetchBatchSize) {
-                EwsItemHandler *handler = EwsItemHandler::itemHandler(static_cast<EwsItemType>(iType));
-                if (!handler) {
-                    // TODO: Temporarily ignore unsupported item types.
-                    qCWarning(EWSRES_LOG) << QStringLiteral("Unable to initialize fetch for item type %1")
-                                    .arg(iType);
-                    /*setErrorMsg(QStringLiteral("Unable to initialize fetch for item type %1").arg(iType));
-                    emitResult();
-                    return;*/
-                }
-                else {
-                    EwsFetchItemDetailJob *job = handler->fetchItemDetailJob(mClient, this, mCollection);
-                    Item::List itemList = toFetchItems[iType].mid(i, fetchBatchSize);
-                    job->setItemLists(itemList, &mDeletedItems);
-                    connect(job, SIGNAL(result(KJob*)), SLOT(itemDetailFetchDone(KJob*)));
-                    addSubjob(job);
-                    qDebug() << "compareItemLists: job created";
-                    fetch = true;
-                }
-            }
+            fetch |= queueDetailFetch(static_cast<EwsItemType>(iType), toFetchItems[iType]);
         }
     }
     if (!fetch) {
-        // Nothing to fetch - we're done here.
-        emitResult();
+        // Nothing to fetch - we're done with this page.
+        pageDone();
     }
     else {
-        qDebug() << "compareItemLists: jobs" << subjobs().size();
-        subjobs().first()->start();
+        startDetailFetches();
+    }
+}
+
+bool EwsFetchItemsJob::queueDetailFetch(EwsItemType type, const Item::List &items)
+{
+    EwsItemHandler *handler = EwsItemHandler::itemHandler(type);
+    if (!handler) {
+        // TODO: Temporarily ignore unsupported item types.
+        qCWarning(EWSRES_LOG) << QStringLiteral("Unable to initialize fetch for item type %1").arg(type);
+        return false;
+    }
+
+    for (int i = 0; i < items.size(); i += fetchBatchSize) {
+        EwsFetchItemDetailJob *job = handler->fetchItemDetailJob(mClient, this, mCollection);
+        job->setItemLists(items.mid(i, fetchBatchSize), &mDeletedItems);
+        job->setProperty("itemType", static_cast<int>(type));
+        connect(job, SIGNAL(result(KJob*)), SLOT(itemDetailFetchDone(KJob*)));
+        addSubjob(job);
+        mDetailJobQueue.append(job);
+    }
+
+    return !items.isEmpty();
+}
+
+void EwsFetchItemsJob::startDetailFetches()
+{
+    if (mDetailJobQueue.isEmpty() && mRunningDetailJobs == 0) {
+        /* The pipeline has drained - fetch any remaining partial batches of additional items. */
+        bool fetch = false;
+        for (auto it = mAdditionalItems.cbegin(); it != mAdditionalItems.cend(); ++it) {
+            fetch |= queueDetailFetch(it.key(), it.value());
+        }
+        mAdditionalItems.clear();
+        if (!fetch) {
+            pageDone();
+            return;
+        }
     }
+
+    while (!mDetailJobQueue.isEmpty() && mRunningDetailJobs < maxParallelDetailFetches) {
+        mDetailJobQueue.takeFirst()->start();
+        ++mRunningDetailJobs;
+    }
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Detail fetches: %1 running, %2 queued")
+                    .arg(mRunningDetailJobs).arg(mDetailJobQueue.size());
 }
 
 void EwsFetchItemsJob::itemDetailFetchDone(KJob *job)
 {
     removeSubjob(job);
+    --mRunningDetailJobs;
 
     if (!job->error()) {
         EwsFetchItemDetailJob *detailJob = qobject_cast<EwsFetchItemDetailJob*>(job);
         if (detailJob) {
             mChangedItems += detailJob->changedItems();
+
+            const Item::List additionalItems = detailJob->additionalItems();
+            if (!additionalItems.isEmpty()) {
+                EwsItemType type = static_cast<EwsItemType>(job->property("itemType").toInt());
+                Item::List &pending = mAdditionalItems[type];
+                pending += additionalItems;
+                while (pending.size() >= fetchBatchSize) {
+                    queueDetailFetch(type, pending.mid(0, fetchBatchSize));
+                    pending = pending.mid(fetchBatchSize);
+                }
+            }
         }
 
-        qDebug() << "itemDetailFetchDone: jobs" << subjobs().size();
-        if (subjobs().size() == 0) {
-            emitResult();
+        startDetailFetches();
+    }
+}
+
+void EwsFetchItemsJob::startSyncRequest()
+{
+    EwsSyncFolderItemsRequest *syncItemsReq = new EwsSyncFolderItemsRequest(mClient, this);
+    syncItemsReq->setFolderId(EwsId(mCollection.remoteId(), mCollection.remoteRevision()));
+    EwsItemShape shape(EwsShapeIdOnly);
+    shape << EwsResource::tagsProperty;
+    if (mWindowStart.isValid()) {
+        shape << EwsPropertyField("calendar:UID");
+    }
+    syncItemsReq->setItemShape(shape);
+    if (!mSyncState.isNull()) {
+        syncItemsReq->setSyncState(mSyncState);
+    }
+    syncItemsReq->setMaxChanges(listBatchSize);
+    connect(syncItemsReq, &EwsSyncFolderItemsRequest::result, this, &EwsFetchItemsJob::remoteItemFetchDone);
+    addSubjob(syncItemsReq);
+    syncItemsReq->start();
+}
+
+void EwsFetchItemsJob::pageDone()
+{
+    if (mIncludesLastItem) {
+        /* The last page is handed over to the resource together with the final sync state. */
+        mSyncState = mPageSyncState;
+        emitResult();
+        return;
+    }
+
+    if (mChangedItems.isEmpty() && mDeletedItems.isEmpty()) {
+        pageApplied();
+        return;
+    }
+
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Applying page: changed %1, deleted %2")
+                    .arg(mChangedItems.size()).arg(mDeletedItems.size());
+    ItemSync *syncJob = new ItemSync(mCollection, this);
+    syncJob->setTransactionMode(ItemSync::SingleTransaction);
+    syncJob->setIncrementalSyncItems(mChangedItems, mDeletedItems);
+    connect(syncJob, &ItemSync::result, this, &EwsFetchItemsJob::pageSyncFinished);
+}
+
+void EwsFetchItemsJob::pageSyncFinished(KJob *job)
+{
+    if (job->error()) {
+        setErrorMsg(job->errorText());
+        emitResult();
+        return;
+    }
+
+    pageApplied();
+}
+
+void EwsFetchItemsJob::pageApplied()
+{
+    /* The page is now in Akonadi - it is safe to continue from its sync state should the sync be
+     * interrupted. */
+    mSyncState = mPageSyncState;
+    mCheckpointed = true;
+    Q_EMIT syncStateCheckpoint(mSyncState, mFullSync);
+
+    mRemoteAddedItems.clear();
+    mRemoteChangedItems.clear();
+    mRemoteDeletedIds.clear();
+    mRemoteFlagChangedIds.clear();
+    mChangedItems.clear();
+    mDeletedItems.clear();
+
+    if (mPreemptRequested) {
+        mPreempted = true;
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Sync of folder %1 preempted")
+                        .arg(ewsHash(mCollection.remoteId()));
+        emitResult();
+        return;
+    }
+
+    mPendingJobs = 1;
+    startSyncRequest();
+}
+
+void EwsFetchItemsJob::preempt()
+{
+    mPreemptRequested = true;
+}
+
+void EwsFetchItemsJob::resumeFullSync()
+{
+    /* The sync state is a checkpoint of an interrupted full sync. */
+    mFullSync = true;
+    mResumedFullSync = true;
+}
+
+void EwsFetchItemsJob::startRemoteIdListing(int offset)
+{
+    EwsFindItemRequest *req = new EwsFindItemRequest(mClient, this);
+    req->setFolderId(EwsId(mCollection.remoteId()));
+    req->setItemShape(EwsItemShape(EwsShapeIdOnly));
+    req->setPagination(EwsBasePointBeginning, offset, idListBatchSize);
+    connect(req, &EwsFindItemRequest::result, this, &EwsFetchItemsJob::remoteIdListFetchDone);
+    addSubjob(req);
+    req->start();
+}
+
+void EwsFetchItemsJob::remoteIdListFetchDone(KJob *job)
+{
+    EwsFindItemRequest *req = qobject_cast<EwsFindItemRequest*>(job);
+
+    if (!req) {
+        setErrorMsg(QStringLiteral("Invalid find item request pointer."));
+        doKill();
+        emitResult();
+        return;
+    }
+
+    if (!req->error()) {
+        removeSubjob(job);
+        Q_FOREACH(const EwsItem &item, req->items()) {
+            mRemoteIds.insert(item[EwsItemFieldItemId].value<EwsId>().id());
         }
-        else {
-            subjobs().first()->start();
+
+        if (!req->includesLastItem()) {
+            startRemoteIdListing(req->nextOffset());
+            return;
         }
+
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Listed %1 items of folder %2")
+                        .arg(mRemoteIds.size()).arg(ewsHash(mCollection.remoteId()));
+        mRemoteIdsListed = true;
+        compareItemLists();
     }
 }
 
@@ -440,6 +723,12 @@ void EwsFetchItemsJob::setQueuedUpdates(const QueuedUpdateList &updates)
     }
 }
 
+void EwsFetchItemsJob::setCalendarWindow(const QDateTime &start, const QDateTime &end)
+{
+    mWindowStart = start;
+    mWindowEnd = end;
+}
+
 void EwsFetchItemsJob::syncTags()
 {
     if (mTagsSynced) {
@@ -20,11 +20,15 @@
 #ifndef EWSFETCHITEMSJOB_H
 #define EWSFETCHITEMSJOB_H
 
+#include <QSet>
+
 #include <AkonadiCore/ItemFetchJob>
 
 #include "ewsjob.h"
 #include "ewsfinditemrequest.h"
 
+class EwsFetchItemDetailJob;
+
 namespace Akonadi {
 class Collection;
 }
@@ -53,8 +57,15 @@ public:
     Akonadi::Item::List deletedItems() const { return mDeletedItems; };
     const QString &syncState() const { return mSyncState; };
     const Akonadi::Collection &collection() const { return mCollection; };
+    bool fullSync() const { return mFullSync; };
+    bool checkpointed() const { return mCheckpointed; };
+    bool preempted() const { return mPreempted; };
+
+    void preempt();
+    void resumeFullSync();
 
     void setQueuedUpdates(const QueuedUpdateList &updates);
+    void setCalendarWindow(const QDateTime &start, const QDateTime &end);
 
     virtual void start() Q_DECL_OVERRIDE;
 private Q_SLOTS:
@@ -62,13 +73,24 @@ private Q_SLOTS:
     void remoteItemFetchDone(KJob *job);
     void itemDetailFetchDone(KJob *job);
     void checkedItemsFetchFinished(KJob *job);
+    void calendarViewFetchDone(KJob *job);
     void tagSyncFinished(KJob *job);
+    void pageSyncFinished(KJob *job);
+    void remoteIdListFetchDone(KJob *job);
 Q_SIGNALS:
     void status(int status, const QString &message = QString());
     void percent(int progress);
+    void syncStateCheckpoint(const QString &syncState, bool fullSync);
 private:
+    void startSyncRequest();
+    void startRemoteIdListing(int offset);
     void compareItemLists();
+    bool queueDetailFetch(EwsItemType type, const Akonadi::Item::List &items);
+    void startDetailFetches();
+    void pageDone();
+    void pageApplied();
     void syncTags();
+    bool inCalendarWindow(const QString &id, const QString &uid) const;
 
     /*struct QueuedUpdateInt {
         QString changeKey;
@@ -79,18 +101,34 @@ private:
     const Akonadi::Collection mCollection;
     EwsClient& mClient;
     EwsId::List mItemsToCheck;
-    Akonadi::Item::List mLocalItems;
+    QHash<QString, Akonadi::Item> mLocalItems;
     EwsItem::List mRemoteAddedItems;
     EwsItem::List mRemoteChangedItems;
     EwsId::List mRemoteDeletedIds;
     QHash<EwsId, bool> mRemoteFlagChangedIds;
+    QList<EwsFetchItemDetailJob*> mDetailJobQueue;
+    int mRunningDetailJobs;
+    QHash<EwsItemType, Akonadi::Item::List> mAdditionalItems;
     int mPendingJobs;
     unsigned mTotalItems;
     QString mSyncState;
     bool mFullSync;
+    bool mResumedFullSync;
+    bool mRemoteIdsListed;
+    QSet<QString> mRemoteIds;
+    QString mPageSyncState;
+    bool mIncludesLastItem;
+    bool mCheckpointed;
+    bool mPreemptRequested;
+    bool mPreempted;
     QueuedUpdateHash mQueuedUpdates;
     EwsTagStore *mTagStore;
     bool mTagsSynced;
+    QDateTime mWindowStart;
+    QDateTime mWindowEnd;
+    QSet<QString> mWindowIds;
+    QSet<QString> mWindowUids;
+    bool mWindowRolled;
 
     Akonadi::Item::List mChangedItems;
     Akonadi::Item::List mDeletedItems;
@@ -0,0 +1,291 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ewsflagschangecoalescer.h"
+
+#include <QDataStream>
+
+#include "ewsmodifyitemflagsjob.h"
+#include "ewsstatestore.h"
+#include "ewsclient_debug.h"
+
+using namespace Akonadi;
+
+/* Time to wait for further flag changes before sending the batch. */
+static Q_CONSTEXPR int coalesceWindow = 500; /* milliseconds */
+
+/* Maximum time a change can be held back waiting for further ones. */
+static Q_CONSTEXPR int maxLatency = 3000; /* milliseconds */
+
+/* Number of items after which the batch is sent straight away. */
+static Q_CONSTEXPR int maxBatchSize = 1000;
+
+/* Version of the serialized unsent change. */
+static Q_CONSTEXPR quint32 stateVersion = 1;
+
+const QString EwsFlagsChangeCoalescer::stateKeyPrefix = QStringLiteral("PendingFlagChanges/");
+
+EwsFlagsChangeCoalescer::EwsFlagsChangeCoalescer(EwsClient &client, EwsStateStore *stateStore,
+                                                 QObject *parent)
+    : QObject(parent), mClient(client), mStateStore(stateStore), mOnline(false)
+{
+    mWindowTimer.setSingleShot(true);
+    mWindowTimer.setInterval(coalesceWindow);
+    connect(&mWindowTimer, &QTimer::timeout, this, &EwsFlagsChangeCoalescer::flush);
+    mLatencyTimer.setSingleShot(true);
+    mLatencyTimer.setInterval(maxLatency);
+    connect(&mLatencyTimer, &QTimer::timeout, this, &EwsFlagsChangeCoalescer::flush);
+
+    restoreState();
+}
+
+EwsFlagsChangeCoalescer::~EwsFlagsChangeCoalescer()
+{
+}
+
+void EwsFlagsChangeCoalescer::queueChange(const Item::List &items, const QSet<QByteArray> &addedFlags,
+                                          const QSet<QByteArray> &removedFlags)
+{
+    Q_FOREACH(const Item &item, items) {
+        auto it = mPendingItems.find(item.remoteId());
+        if (it == mPendingItems.end()) {
+            /* Reconstruct the state of the flags before the change. This is what the server
+             * currently has. */
+            Item::Flags origFlags = item.flags();
+            origFlags.subtract(addedFlags);
+            origFlags.unite(removedFlags);
+            mPendingItems.insert(item.remoteId(), {item, origFlags});
+        } else {
+            it->item = item;
+        }
+        saveItem(item.remoteId());
+    }
+
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Queued flag change for %1 items (%2 pending)")
+                    .arg(items.size()).arg(mPendingItems.size());
+
+    /* The change is committed to Akonadi straight after it is queued - make sure it survives a
+     * crash. Only the items changed above are appended to the state journal. */
+    if (mStateStore) {
+        mStateStore->flush();
+    }
+
+    if (!mOnline) {
+        return;
+    }
+
+    if (mPendingItems.size() >= maxBatchSize) {
+        flush();
+    } else {
+        mWindowTimer.start();
+        if (!mLatencyTimer.isActive()) {
+            mLatencyTimer.start();
+        }
+    }
+}
+
+void EwsFlagsChangeCoalescer::setOnline(bool online)
+{
+    mOnline = online;
+    if (!mOnline) {
+        /* Keep the changes in the state store until the resource is back online. */
+        mWindowTimer.stop();
+        mLatencyTimer.stop();
+    } else if (!mPendingItems.isEmpty()) {
+        mWindowTimer.start();
+    }
+}
+
+void EwsFlagsChangeCoalescer::flush()
+{
+    mWindowTimer.stop();
+    mLatencyTimer.stop();
+
+    if (!mOnline) {
+        runWaiters();
+        return;
+    }
+
+    Item::List items;
+    QHash<QString, PendingItem> sentItems;
+    QStringList cancelledIds;
+    for (auto it = mPendingItems.cbegin(); it != mPendingItems.cend(); ++it) {
+        if (it->item.flags() != it->origFlags) {
+            items.append(it->item);
+            sentItems.insert(it.key(), *it);
+        } else {
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("Flag changes for item %1 cancelled out")
+                            .arg(ewsHash(it->item.remoteId()));
+            cancelledIds.append(it.key());
+        }
+    }
+    mPendingItems.clear();
+
+    /* The items being sent keep their stored state until the server has confirmed them. */
+    Q_FOREACH(const QString &remoteId, cancelledIds) {
+        saveItem(remoteId);
+    }
+
+    if (items.isEmpty()) {
+        runWaiters();
+        return;
+    }
+
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Sending flag changes for %1 items").arg(items.size());
+
+    EwsModifyItemFlagsJob *job = new EwsModifyItemFlagsJob(mClient, this, items, QSet<QByteArray>(),
+        QSet<QByteArray>());
+    job->setProperty("items", QVariant::fromValue<Item::List>(items));
+    connect(job, &EwsModifyItemFlagsJob::result, this, &EwsFlagsChangeCoalescer::modifyFlagsJobFinished);
+    mRunningJobs.insert(job, sentItems);
+    job->start();
+}
+
+void EwsFlagsChangeCoalescer::flushAndWait(const DoneFn &done)
+{
+    mWaiters.append(done);
+    flush();
+}
+
+void EwsFlagsChangeCoalescer::runWaiters()
+{
+    if (!mRunningJobs.isEmpty()) {
+        return;
+    }
+
+    const QList<DoneFn> waiters = mWaiters;
+    mWaiters.clear();
+    Q_FOREACH(const DoneFn &done, waiters) {
+        done();
+    }
+}
+
+void EwsFlagsChangeCoalescer::modifyFlagsJobFinished(KJob *job)
+{
+    /* Whatever the outcome the change is no longer pending - failures are handled by a resync of
+     * the affected items. */
+    const QHash<QString, PendingItem> sentItems = mRunningJobs.take(job);
+    for (auto it = sentItems.cbegin(); it != sentItems.cend(); ++it) {
+        saveItem(it.key());
+    }
+
+    if (job->error()) {
+        Q_EMIT changesFailed(job->property("items").value<Item::List>(), job->errorString());
+    } else {
+        EwsModifyItemFlagsJob *req = qobject_cast<EwsModifyItemFlagsJob*>(job);
+        if (!req) {
+            Q_EMIT changesFailed(job->property("items").value<Item::List>(),
+                                 QStringLiteral("Invalid EwsModifyItemFlagsJob job object"));
+        } else {
+            if (!req->items().isEmpty()) {
+                Q_EMIT changesCommitted(req->items());
+            }
+            /* Items rejected by the server individually don't fail the rest of the batch. */
+            if (!req->failedItems().isEmpty()) {
+                Q_EMIT changesFailed(req->failedItems(), QStringLiteral("Item update failed"));
+            }
+        }
+    }
+
+    runWaiters();
+}
+
+/* Each item with unsent changes is stored under a key of its own, so that a change only needs
+ * to write the affected items. An item is stored as its state after the latest change together
+ * with the flags the server had before it. A change still waiting to be sent takes precedence
+ * over the one being sent. */
+void EwsFlagsChangeCoalescer::saveItem(const QString &remoteId)
+{
+    if (!mStateStore) {
+        return;
+    }
+
+    const PendingItem *pending = Q_NULLPTR;
+    auto pendingIt = mPendingItems.constFind(remoteId);
+    if (pendingIt != mPendingItems.cend()) {
+        pending = &(*pendingIt);
+    } else {
+        for (auto jobIt = mRunningJobs.cbegin(); jobIt != mRunningJobs.cend(); ++jobIt) {
+            auto it = jobIt->constFind(remoteId);
+            if (it != jobIt->cend()) {
+                pending = &(*it);
+                break;
+            }
+        }
+    }
+
+    if (!pending) {
+        mStateStore->remove(stateKeyPrefix + remoteId);
+        return;
+    }
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    const Item &item = pending->item;
+    stream << stateVersion << item.id() << item.remoteRevision() << item.mimeType()
+           << item.parentCollection().remoteId() << item.flags() << pending->origFlags;
+    mStateStore->setValue(stateKeyPrefix + remoteId, QString::fromLatin1(data.toBase64()));
+}
+
+void EwsFlagsChangeCoalescer::restoreState()
+{
+    if (!mStateStore) {
+        return;
+    }
+
+    Q_FOREACH(const QString &key, mStateStore->keys()) {
+        if (!key.startsWith(stateKeyPrefix)) {
+            continue;
+        }
+        const QString remoteId = key.mid(stateKeyPrefix.size());
+
+        QDataStream stream(QByteArray::fromBase64(mStateStore->value(key).toLatin1()));
+        stream.setVersion(QDataStream::Qt_5_0);
+        quint32 version;
+        stream >> version;
+        if (version != stateVersion) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Unknown version of pending flag change (%1)").arg(version);
+            mStateStore->remove(key);
+            continue;
+        }
+
+        Item::Id id;
+        QString remoteRevision, mimeType, collectionId;
+        Item::Flags flags, origFlags;
+        stream >> id >> remoteRevision >> mimeType >> collectionId >> flags >> origFlags;
+        if (stream.status() != QDataStream::Ok) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to read pending flag change for item %1")
+                            .arg(ewsHash(remoteId));
+            mStateStore->remove(key);
+            continue;
+        }
+        Item item(id);
+        item.setRemoteId(remoteId);
+        item.setRemoteRevision(remoteRevision);
+        item.setMimeType(mimeType);
+        Collection collection;
+        collection.setRemoteId(collectionId);
+        item.setParentCollection(collection);
+        item.setFlags(flags);
+        mPendingItems.insert(remoteId, {item, origFlags});
+    }
+
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Restored %1 unsent flag changes").arg(mPendingItems.size());
+}
@@ -0,0 +1,110 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#ifndef EWSFLAGSCHANGECOALESCER_H
+#define EWSFLAGSCHANGECOALESCER_H
+
+#include <functional>
+
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+#include <AkonadiCore/Item>
+
+class EwsClient;
+class EwsStateStore;
+class KJob;
+
+/**
+ *  @brief  Item flag change coalescer
+ *
+ *  When the user changes flags on a large selection of items Akonadi can deliver the change in
+ *  multiple chunks, each one as a separate itemsFlagsChanged() call. Processing each chunk
+ *  separately results in a separate UpdateItem request per chunk.
+ *
+ *  This class gathers flag changes coming in within a short time window and sends them to the
+ *  server as one batch. As flags are always written as a whole (not as a delta) only the latest
+ *  state of each item needs to be sent. Items, for which the flags have returned to their original
+ *  state within the window (ex. an item marked as read and then unread again) are dropped
+ *  altogether.
+ *
+ *  Since Akonadi doesn't deliver the next change until the previous one is committed the resource
+ *  needs to commit each change as soon as it is queued here. Results of the actual server
+ *  update are reported afterwards using the changesCommitted() and changesFailed() signals. Items
+ *  rejected by the server are reported as failed individually, without failing the remaining
+ *  items of the batch.
+ *
+ *  The window is restarted with each change, but a batch is never held for longer than the
+ *  maximum latency or after it has reached the maximum batch size.
+ *
+ *  As the changes are already committed to Akonadi they would be lost if the resource was
+ *  stopped or went offline before sending them. Therefore the queued changes and the ones being
+ *  sent are kept in the state store until the server has confirmed them. Each item is stored
+ *  under a key of its own, so that queueing a change only appends the affected items to the state
+ *  journal. Changes restored from the state store are sent once the resource is online.
+ */
+class EwsFlagsChangeCoalescer : public QObject
+{
+    Q_OBJECT
+public:
+    typedef std::function<void()> DoneFn;
+
+    EwsFlagsChangeCoalescer(EwsClient &client, EwsStateStore *stateStore, QObject *parent);
+    virtual ~EwsFlagsChangeCoalescer();
+
+    void queueChange(const Akonadi::Item::List &items, const QSet<QByteArray> &addedFlags,
+                     const QSet<QByteArray> &removedFlags);
+    void setOnline(bool online);
+
+    /* Sends the queued changes straight away and calls @p done once the server has processed all
+     * changes sent so far. This is needed before an operation that changes the item ids, such as
+     * moving the items. */
+    void flushAndWait(const DoneFn &done);
+
+    static const QString stateKeyPrefix;
+public Q_SLOTS:
+    void flush();
+Q_SIGNALS:
+    void changesCommitted(const Akonadi::Item::List &items);
+    void changesFailed(const Akonadi::Item::List &items, const QString &error);
+private Q_SLOTS:
+    void modifyFlagsJobFinished(KJob *job);
+private:
+    struct PendingItem {
+        Akonadi::Item item;
+        Akonadi::Item::Flags origFlags;
+    };
+
+    void saveItem(const QString &remoteId);
+    void restoreState();
+    void runWaiters();
+
+    EwsClient &mClient;
+    EwsStateStore *mStateStore;
+    QHash<QString, PendingItem> mPendingItems;
+    /* Items being sent to the server (keyed by the flags job sending them). */
+    QHash<KJob*, QHash<QString, PendingItem>> mRunningJobs;
+    QList<DoneFn> mWaiters;
+    bool mOnline;
+    QTimer mWindowTimer;
+    QTimer mLatencyTimer;
+};
+
+#endif
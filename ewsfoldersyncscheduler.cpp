@@ -0,0 +1,214 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ewsfoldersyncscheduler.h"
+
+#include <QtMath>
+
+#include "ewsclient_debug.h"
+
+/* Time to wait for further notifications before synchronizing the modified folders. */
+static Q_CONSTEXPR int coalesceWindow = 1000; /* milliseconds */
+
+/* Maximum time a modified folder can be held back waiting for further notifications. */
+static Q_CONSTEXPR int maxLatency = 10000; /* milliseconds */
+
+/* Time after which a requested synchronization that has not started is considered lost (ex. when
+ * the resource went offline in the meantime) and no longer blocks further requests. */
+static Q_CONSTEXPR int requestExpiry = 300000; /* milliseconds */
+
+/* Time after which the weight of a folder change notification drops by half. */
+static Q_CONSTEXPR int activityHalfLife = 600000; /* milliseconds */
+
+/* Activity below which a folder is no longer tracked. It takes a single notification about six
+ * half-lives to decay to this level. */
+static Q_CONSTEXPR double minActivity = 0.01;
+
+/* Number of times in a row an ordinary folder gives way to special folders before it is
+ * synchronized anyway. */
+static Q_CONSTEXPR int maxYields = 3;
+
+/* Priority of the first special folder. Activity of ordinary folders should never reach it. */
+static Q_CONSTEXPR double specialFolderPriority = 1e9;
+
+EwsFolderSyncScheduler::EwsFolderSyncScheduler(QObject *parent)
+    : QObject(parent)
+{
+    mWindowTimer.setSingleShot(true);
+    mWindowTimer.setInterval(coalesceWindow);
+    connect(&mWindowTimer, &QTimer::timeout, this, &EwsFolderSyncScheduler::flush);
+    mLatencyTimer.setSingleShot(true);
+    mLatencyTimer.setInterval(maxLatency);
+    connect(&mLatencyTimer, &QTimer::timeout, this, &EwsFolderSyncScheduler::flush);
+}
+
+EwsFolderSyncScheduler::~EwsFolderSyncScheduler()
+{
+}
+
+void EwsFolderSyncScheduler::queueFolders(const EwsId::List &folders)
+{
+    Q_FOREACH(const EwsId &id, folders) {
+        mModifiedFolders.insert(EwsId(id.id()));
+
+        Activity &act = mActivity[id.id()];
+        act.score = activity(id.id()) + 1;
+        act.timer.start();
+    }
+
+    startTimers();
+}
+
+void EwsFolderSyncScheduler::deferFolder(const QString &folderId)
+{
+    /* Unlike queueFolders() this does not count as activity of the folder. */
+    mModifiedFolders.insert(EwsId(folderId));
+
+    startTimers();
+}
+
+void EwsFolderSyncScheduler::startTimers()
+{
+    mWindowTimer.start();
+    if (!mLatencyTimer.isActive()) {
+        mLatencyTimer.start();
+    }
+}
+
+void EwsFolderSyncScheduler::flush()
+{
+    mWindowTimer.stop();
+    mLatencyTimer.stop();
+
+    EwsId::List folders;
+    Q_FOREACH(const EwsId &id, mModifiedFolders) {
+        auto it = mRequestedFolders.find(id.id());
+        if (it != mRequestedFolders.end() && !it->hasExpired(requestExpiry)) {
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("Synchronization of folder %1 already queued")
+                            .arg(ewsHash(id.id()));
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        mRequestedFolders.insert(id.id(), timer);
+        folders.append(id);
+    }
+    mModifiedFolders.clear();
+
+    for (auto it = mActivity.begin(); it != mActivity.end();) {
+        if (activity(it.key()) < minActivity) {
+            it = mActivity.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (folders.isEmpty()) {
+        return;
+    }
+
+    std::sort(folders.begin(), folders.end(), [this](const EwsId &a, const EwsId &b) {
+        return priority(a.id()) > priority(b.id());
+    });
+
+    if (!mRunningFolder.isNull() && !isSpecialFolder(mRunningFolder) && isSpecialFolder(folders.first().id())) {
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Requesting preemption of folder %1 sync")
+                        .arg(ewsHash(mRunningFolder));
+        Q_EMIT preemptionRequested(mRunningFolder);
+    }
+
+    Q_EMIT syncRequested(folders);
+}
+
+void EwsFolderSyncScheduler::syncStarted(const QString &folderId)
+{
+    mRequestedFolders.remove(folderId);
+    mRunningFolder = folderId;
+}
+
+void EwsFolderSyncScheduler::syncDropped(const QString &folderId)
+{
+    mRequestedFolders.remove(folderId);
+}
+
+void EwsFolderSyncScheduler::syncFinished(const QString &folderId)
+{
+    if (mRunningFolder == folderId) {
+        mRunningFolder.clear();
+    }
+}
+
+void EwsFolderSyncScheduler::setSpecialFolders(const QStringList &folderIds)
+{
+    mSpecialFolders = folderIds;
+}
+
+bool EwsFolderSyncScheduler::isSpecialFolder(const QString &folderId) const
+{
+    return mSpecialFolders.contains(folderId);
+}
+
+double EwsFolderSyncScheduler::activity(const QString &folderId) const
+{
+    auto it = mActivity.find(folderId);
+    if (it == mActivity.end()) {
+        return 0;
+    }
+
+    return it->score * qPow(0.5, static_cast<double>(it->timer.elapsed()) / activityHalfLife);
+}
+
+double EwsFolderSyncScheduler::priority(const QString &folderId) const
+{
+    int index = mSpecialFolders.indexOf(folderId);
+    if (index >= 0) {
+        return specialFolderPriority - index;
+    }
+
+    return activity(folderId);
+}
+
+bool EwsFolderSyncScheduler::shouldYield(const QString &folderId)
+{
+    if (isSpecialFolder(folderId)) {
+        return false;
+    }
+
+    bool specialWaiting = false;
+    for (auto it = mRequestedFolders.cbegin(); it != mRequestedFolders.cend(); ++it) {
+        if (it.key() != folderId && isSpecialFolder(it.key()) && !it->hasExpired(requestExpiry)) {
+            specialWaiting = true;
+            break;
+        }
+    }
+
+    int &count = mYieldCounts[folderId];
+    if (!specialWaiting || count >= maxYields) {
+        if (specialWaiting) {
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("Folder %1 deferred %2 times - not yielding any more")
+                            .arg(ewsHash(folderId)).arg(count);
+        }
+        mYieldCounts.remove(folderId);
+        return false;
+    }
+
+    count++;
+    return true;
+}
@@ -0,0 +1,100 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#ifndef EWSFOLDERSYNCSCHEDULER_H
+#define EWSFOLDERSYNCSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+#include "ewsid.h"
+
+/**
+ *  @brief  Folder synchronization scheduler
+ *
+ *  Change notifications from the server arrive in batches, each of which results in a list of
+ *  modified folders. During a burst of changes (ex. a mailing list flood or a server-side rule
+ *  moving lots of items) the same folders are reported over and over again. Synchronizing each
+ *  folder straight away would result in back-to-back synchronizations of the same folder.
+ *
+ *  This class gathers the modified folders within a short time window and requests a single
+ *  synchronization for each of them once the window expires. The window is restarted with each
+ *  notification, but a folder is never held back for longer than the maximum latency.
+ *
+ *  Additionally the class keeps track of folders, for which synchronization has already been
+ *  requested, but has not started yet. Further modifications of such folders are dropped as the
+ *  queued synchronization will pick them up anyway. The resource is responsible for calling
+ *  syncStarted() once the synchronization of a folder begins (or syncDropped() if it will not
+ *  happen at all).
+ *
+ *  Folders are requested in order of priority. Special folders (Inbox, Sent Items, etc.) always
+ *  come first in the order given to setSpecialFolders(). Other folders are ordered by their recent
+ *  notification activity, which decays over time. Since Akonadi processes item synchronizations in
+ *  a plain queue, a long synchronization of a large background folder can hold up a special folder.
+ *  To avoid this the resource asks shouldYield() before starting a synchronization and defers
+ *  ordinary folders as long as a special folder is waiting. In order not to starve ordinary
+ *  folders during a burst of changes to special folders each of them gives way only a limited
+ *  number of times in a row. A running synchronization of an ordinary folder is additionally asked
+ *  to stop early through preemptionRequested() once a special folder is requested.
+ */
+class EwsFolderSyncScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EwsFolderSyncScheduler(QObject *parent);
+    virtual ~EwsFolderSyncScheduler();
+
+    void queueFolders(const EwsId::List &folders);
+    void syncStarted(const QString &folderId);
+    void syncDropped(const QString &folderId);
+    void syncFinished(const QString &folderId);
+    void deferFolder(const QString &folderId);
+
+    void setSpecialFolders(const QStringList &folderIds);
+    bool isSpecialFolder(const QString &folderId) const;
+    double priority(const QString &folderId) const;
+    bool shouldYield(const QString &folderId);
+public Q_SLOTS:
+    void flush();
+Q_SIGNALS:
+    void syncRequested(const EwsId::List &folders);
+    void preemptionRequested(const QString &folderId);
+private:
+    struct Activity {
+        double score;
+        QElapsedTimer timer;
+    };
+
+    double activity(const QString &folderId) const;
+    void startTimers();
+
+    QSet<EwsId> mModifiedFolders;
+    QHash<QString, QElapsedTimer> mRequestedFolders;
+    QStringList mSpecialFolders;
+    QHash<QString, Activity> mActivity;
+    QHash<QString, int> mYieldCounts;
+    QString mRunningFolder;
+    QTimer mWindowTimer;
+    QTimer mLatencyTimer;
+};
+
+#endif
@@ -0,0 +1,181 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+
+#include "ewsfoldertree.h"
+
+#include <QDataStream>
+
+#include "ewsclient_debug.h"
+
+using namespace Akonadi;
+
+/* Version of the serialized snapshot format. */
+static Q_CONSTEXPR quint32 snapshotVersion = 1;
+
+EwsFolderTree::EwsFolderTree()
+{
+}
+
+EwsFolderTree::~EwsFolderTree()
+{
+}
+
+void EwsFolderTree::clear()
+{
+    mFolders.clear();
+    mChildren.clear();
+}
+
+void EwsFolderTree::setCollections(const Collection::List &collections)
+{
+    clear();
+    Q_FOREACH(const Collection &col, collections) {
+        insert(col);
+    }
+}
+
+void EwsFolderTree::applyChanges(const Collection::List &changed, const Collection::List &deleted)
+{
+    Q_FOREACH(const Collection &col, deleted) {
+        remove(col.remoteId());
+    }
+    Q_FOREACH(const Collection &col, changed) {
+        insert(col);
+    }
+}
+
+void EwsFolderTree::insert(const Collection &collection)
+{
+    QString parentId = collection.parentCollection().remoteId();
+    if (parentId.isEmpty()) {
+        /* This is the root collection, which is not part of the tree. */
+        return;
+    }
+
+    QHash<QString, Folder>::iterator it = mFolders.find(collection.remoteId());
+    if (it != mFolders.end() && it->parentId != parentId) {
+        mChildren.remove(it->parentId, collection.remoteId());
+    }
+    if (it == mFolders.end() || it->parentId != parentId) {
+        mChildren.insert(parentId, collection.remoteId());
+    }
+
+    Folder folder;
+    folder.parentId = parentId;
+    folder.changeKey = collection.remoteRevision();
+    folder.name = collection.name();
+    folder.mimeTypes = collection.contentMimeTypes();
+    folder.rights = static_cast<int>(collection.rights());
+    mFolders.insert(collection.remoteId(), folder);
+}
+
+void EwsFolderTree::remove(const QString &id)
+{
+    QHash<QString, Folder>::iterator it = mFolders.find(id);
+    if (it == mFolders.end()) {
+        return;
+    }
+
+    /* Removing a folder implicitly removes all its subfolders. */
+    Q_FOREACH(const QString &childId, mChildren.values(id)) {
+        remove(childId);
+    }
+    mChildren.remove(id);
+    mChildren.remove(it->parentId, id);
+    mFolders.erase(it);
+}
+
+Collection EwsFolderTree::collection(const QString &id, const Collection &root) const
+{
+    /* Walk up to the root and then build the collection chain top-down. */
+    QStringList chain;
+    QString curId = id;
+    while (curId != root.remoteId()) {
+        QHash<QString, Folder>::const_iterator it = mFolders.constFind(curId);
+        if (it == mFolders.cend() || chain.size() > mFolders.size()) {
+            return Collection();
+        }
+        chain.prepend(curId);
+        curId = it->parentId;
+    }
+
+    Collection parent = root;
+    Q_FOREACH(const QString &folderId, chain) {
+        const Folder &folder = *mFolders.constFind(folderId);
+        Collection col;
+        col.setRemoteId(folderId);
+        col.setRemoteRevision(folder.changeKey);
+        col.setName(folder.name);
+        col.setContentMimeTypes(folder.mimeTypes);
+        col.setRights(static_cast<Collection::Rights>(folder.rights));
+        col.setParentCollection(parent);
+        parent = col;
+    }
+
+    return parent;
+}
+
+QString EwsFolderTree::toString() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << snapshotVersion << static_cast<quint32>(mFolders.size());
+    for (QHash<QString, Folder>::const_iterator it = mFolders.cbegin(); it != mFolders.cend(); ++it) {
+        stream << it.key() << it->parentId << it->changeKey << it->name << it->mimeTypes
+               << static_cast<qint32>(it->rights);
+    }
+
+    return QString::fromLatin1(qCompress(data).toBase64());
+}
+
+bool EwsFolderTree::fromString(const QString &data)
+{
+    clear();
+
+    QByteArray buf = qUncompress(QByteArray::fromBase64(data.toLatin1()));
+    if (buf.isEmpty()) {
+        return false;
+    }
+
+    QDataStream stream(buf);
+    quint32 version, count;
+    stream >> version >> count;
+    if (version != snapshotVersion) {
+        qCWarningNC(EWSRES_LOG) << QStringLiteral("Unsupported folder tree snapshot version %1").arg(version);
+        return false;
+    }
+
+    for (quint32 i = 0; i < count; ++i) {
+        QString id;
+        Folder folder;
+        qint32 rights;
+        stream >> id >> folder.parentId >> folder.changeKey >> folder.name >> folder.mimeTypes >> rights;
+        if (stream.status() != QDataStream::Ok) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Corrupted folder tree snapshot");
+            clear();
+            return false;
+        }
+        folder.rights = rights;
+        mFolders.insert(id, folder);
+        mChildren.insert(folder.parentId, id);
+    }
+
+    return true;
+}
@@ -0,0 +1,77 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+
+#ifndef EWSFOLDERTREE_H
+#define EWSFOLDERTREE_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include <AkonadiCore/Collection>
+
+/**
+ *  @brief  Snapshot of the remote folder tree
+ *
+ *  An incremental folder tree synchronization only receives the list of changed folders from the
+ *  server. In order to pass the changes to Akonadi the resource needs to know the corresponding
+ *  local collections together with their parent chain up to the root.
+ *
+ *  This class keeps a compact copy of the folder tree as last synchronized (folder identifiers,
+ *  parents, change keys, names, content types and rights). It is persisted alongside the folder
+ *  sync state, so that collections affected by an incremental change can be reconstructed from
+ *  memory instead of querying Akonadi for them. Since the resource uses hierarchical remote
+ *  identifiers a collection with a complete chain of remote parents is enough for Akonadi to
+ *  locate the local collection.
+ */
+class EwsFolderTree
+{
+public:
+    EwsFolderTree();
+    ~EwsFolderTree();
+
+    bool isEmpty() const { return mFolders.isEmpty(); };
+    bool contains(const QString &id) const { return mFolders.contains(id); };
+    void clear();
+
+    void setCollections(const Akonadi::Collection::List &collections);
+    void applyChanges(const Akonadi::Collection::List &changed, const Akonadi::Collection::List &deleted);
+
+    Akonadi::Collection collection(const QString &id, const Akonadi::Collection &root) const;
+
+    QString toString() const;
+    bool fromString(const QString &data);
+private:
+    struct Folder {
+        QString parentId;
+        QString changeKey;
+        QString name;
+        QStringList mimeTypes;
+        int rights;
+    };
+
+    void insert(const Akonadi::Collection &collection);
+    void remove(const QString &id);
+
+    QHash<QString, Folder> mFolders;
+    QMultiHash<QString, QString> mChildren;
+};
+
+#endif
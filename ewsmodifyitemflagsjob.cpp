@@ -37,23 +37,24 @@ EwsModifyItemFlagsJob::~EwsModifyItemFlagsJob()
 void EwsModifyItemFlagsJob::itemModifyFinished(KJob *job)
 {
     if (job->error()) {
-        setErrorText(job->errorString());
+        setErrorMsg(job->errorString(), job->error());
         emitResult();
         return;
     }
 
     EwsModifyItemJob *req = qobject_cast<EwsModifyItemJob*>(job);
     if (!req) {
-        setErrorText(QStringLiteral("Invalid EwsModifyItemJob job object"));
+        setErrorMsg(QStringLiteral("Invalid EwsModifyItemJob job object"));
         emitResult();
         return;
     }
 
     mResultItems += req->items();
+    mFailedItems += req->failedItems();
     removeSubjob(job);
 
     if (subjobs().isEmpty()) {
-        Q_ASSERT(mResultItems.size() == mItems.size());
+        Q_ASSERT(mResultItems.size() + mFailedItems.size() == mItems.size());
         emitResult();
     }
 }
@@ -67,7 +68,7 @@ void EwsModifyItemFlagsJob::start()
     Q_FOREACH(const Item &item, mItems) {
         EwsItemType type = EwsItemHandler::mimeToItemType(item.mimeType());
         if (type == EwsItemTypeUnknown) {
-            setErrorText(QStringLiteral("Unknown item type %1 for item %2").arg(item.mimeType()).arg(item.remoteId()));
+            setErrorMsg(QStringLiteral("Unknown item type %1 for item %2").arg(item.mimeType()).arg(item.remoteId()));
             emitResult();
             return;
         } else {
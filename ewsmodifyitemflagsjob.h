@@ -39,11 +39,16 @@ public:
     {
         return mResultItems;
     }
+    Akonadi::Item::List failedItems() const
+    {
+        return mFailedItems;
+    }
 
     virtual void start() Q_DECL_OVERRIDE;
 protected:
     Akonadi::Item::List mItems;
     Akonadi::Item::List mResultItems;
+    Akonadi::Item::List mFailedItems;
     EwsClient &mClient;
     QSet<QByteArray> mAddedFlags;
     QSet<QByteArray> mRemovedFlags;
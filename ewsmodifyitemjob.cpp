@@ -40,3 +40,8 @@ const Akonadi::Item::List &EwsModifyItemJob::items() const
 {
     return mItems;
 }
+
+const Akonadi::Item::List &EwsModifyItemJob::failedItems() const
+{
+    return mFailedItems;
+}
@@ -36,9 +36,12 @@ public:
     void setModifiedFlags(const QSet<QByteArray> &addedFlags, const QSet<QByteArray> &removedFlags);
 
     const Akonadi::Item::List &items() const;
+    /* Items rejected by the server. These are not included in items(). */
+    const Akonadi::Item::List &failedItems() const;
 
 protected:
     Akonadi::Item::List mItems;
+    Akonadi::Item::List mFailedItems;
     const QSet<QByteArray> mParts;
     EwsClient& mClient;
     QSet<QByteArray> mAddedFlags;
@@ -20,31 +20,43 @@
 #include "ewsresource.h"
 
 #include <QDebug>
+#include <QStandardPaths>
 
 #include <KI18n/KLocalizedString>
 #include <AkonadiCore/ChangeRecorder>
 #include <AkonadiCore/CollectionFetchScope>
+#include <AkonadiCore/ItemFetchJob>
 #include <AkonadiCore/ItemFetchScope>
 #include <AkonadiCore/CollectionFetchJob>
 #include <AkonadiCore/CollectionModifyJob>
+#include <AkonadiCore/ItemModifyJob>
 #include <AkonadiCore/EntityDisplayAttribute>
 #include <Akonadi/KMime/SpecialMailCollections>
 #include <KMime/Message>
+#include <KCalCore/Event>
+#include <KCalCore/Todo>
 #include <KWallet/KWallet>
 #include <KWidgetsAddons/KPasswordDialog>
 
+#include "ewsapplyitemeventsjob.h"
 #include "ewsfetchitemsjob.h"
 #include "ewsfetchfoldersjob.h"
 #include "ewsfetchfoldersincrjob.h"
 #include "ewsgetitemrequest.h"
 #include "ewsupdateitemrequest.h"
-#include "ewsmodifyitemflagsjob.h"
+#include "ewsflagschangecoalescer.h"
+#include "ewsfoldersyncscheduler.h"
+#include "ewsfoldertree.h"
 #include "ewsmoveitemrequest.h"
+#include "ewscopyitemrequest.h"
 #include "ewsdeleteitemrequest.h"
+#include "ewsemptyfolderrequest.h"
+#include "ewssyncfolderitemsrequest.h"
 #include "ewscreatefolderrequest.h"
 #include "ewsmovefolderrequest.h"
 #include "ewsupdatefolderrequest.h"
 #include "ewsdeletefolderrequest.h"
+#include "ewsstatestore.h"
 #include "ewssubscriptionmanager.h"
 #include "ewsgetfolderrequest.h"
 #include "ewsitemhandler.h"
@@ -55,6 +67,8 @@
 #ifdef HAVE_SEPARATE_MTA_RESOURCE
 #include "ewscreateitemrequest.h"
 #endif
+#include "calendar/ewscalendarconverter.h"
+#include "task/ewstaskconverter.h"
 #include "tags/ewstagstore.h"
 #include "tags/ewsupdateitemstagsjob.h"
 #include "tags/ewsglobaltagswritejob.h"
@@ -98,9 +112,52 @@ const EwsPropertyField EwsResource::flagsProperty(EwsResource::akonadiEwsPropset
 static Q_CONSTEXPR int InitialReconnectTimeout = 60;
 static Q_CONSTEXPR int ReconnectTimeout = 300;
 
+/* Minimum number of items removed from a single folder for which it is worth checking whether
+ * the whole folder is being emptied. */
+static Q_CONSTEXPR int EmptyFolderMinItems = 100;
+
+/* Keys used to store the synchronization state. */
+static const QString itemSyncStateKeyPrefix = QStringLiteral("ItemSyncState/");
+static const QString fullSyncKeyPrefix = QStringLiteral("FullSyncInProgress/");
+static const QString folderSyncStateKey = QStringLiteral("FolderSyncState");
+static const QString folderTreeKey = QStringLiteral("FolderTree");
+
+/* Builds the item shape used to retrieve full item payloads on demand. Tasks have no usable MIME
+ * representation, so their payload is built from the typed task properties instead. */
+static EwsItemShape itemPayloadShape(const Item::List &items)
+{
+    bool todo = false;
+    bool event = false;
+    Q_FOREACH(const Item &item, items) {
+        if (item.mimeType() == KCalCore::Todo::todoMimeType()) {
+            todo = true;
+        } else if (item.mimeType() == KCalCore::Event::eventMimeType()) {
+            event = true;
+        }
+    }
+
+    EwsItemShape shape(EwsShapeIdOnly);
+    if (event) {
+        Q_FOREACH(const EwsPropertyField &field, EwsCalendarConverter::mimeProperties()) {
+            shape << field;
+        }
+    } else {
+        shape << EwsPropertyField("item:MimeContent");
+    }
+    if (todo) {
+        shape.setBodyType(EwsItemShape::BodyText);
+        shape << EwsPropertyField("item:Body");
+        Q_FOREACH(const EwsPropertyField &field, EwsTaskConverter::taskProperties()) {
+            shape << field;
+        }
+    }
+    return shape;
+}
+
 EwsResource::EwsResource(const QString &id)
-    : Akonadi::ResourceBase(id), mTagsRetrieved(false), mReconnectTimeout(InitialReconnectTimeout),
-      mSettings(new Settings(winIdForDialogs()))
+    : Akonadi::ResourceBase(id), mFolderTree(new EwsFolderTree()), mTagsRetrieved(false),
+      mReconnectTimeout(InitialReconnectTimeout), mFlagsChangeCoalescer(Q_NULLPTR), mFolderSyncFetchesPending(0),
+      mItemEventsJob(Q_NULLPTR), mSettings(new Settings(winIdForDialogs()))
 {
     //setName(i18n("Microsoft Exchange"));
     mEwsClient.setUrl(mSettings->baseUrl());
@@ -135,19 +192,17 @@ EwsResource::EwsResource(const QString &id)
     }
 
     // Load the sync state
-    QByteArray data = QByteArray::fromBase64(mSettings->syncState().toAscii());
-    if (!data.isEmpty()) {
-        data = qUncompress(data);
-        if (!data.isEmpty()) {
-            QDataStream stream(data);
-            stream >> mSyncState;
-        }
-    }
-    data = QByteArray::fromBase64(mSettings->folderSyncState().toAscii());
-    if (!data.isEmpty()) {
-        data = qUncompress(data);
-        if (!data.isEmpty()) {
-            mFolderSyncState = QString::fromAscii(data);
+    mStateStore = new EwsStateStore(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+                                    + QStringLiteral("/akonadi-ews/") + identifier() + QStringLiteral("/state"),
+                                    this);
+    if (mStateStore->isEmpty()) {
+        importLegacyState();
+    }
+    mFolderSyncState = mStateStore->value(folderSyncStateKey);
+    if (!mFolderSyncState.isEmpty()) {
+        QString folderTree = mStateStore->value(folderTreeKey);
+        if (!folderTree.isEmpty() && !mFolderTree->fromString(folderTree)) {
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to load folder tree snapshot");
         }
     }
 
@@ -155,6 +210,18 @@ EwsResource::EwsResource(const QString &id)
 
     mTagStore = new EwsTagStore(this);
 
+    mFlagsChangeCoalescer = new EwsFlagsChangeCoalescer(mEwsClient, mStateStore, this);
+    connect(mFlagsChangeCoalescer, &EwsFlagsChangeCoalescer::changesCommitted, this,
+            &EwsResource::flagsChangesCommitted);
+    connect(mFlagsChangeCoalescer, &EwsFlagsChangeCoalescer::changesFailed, this,
+            &EwsResource::flagsChangesFailed);
+    mFlagsChangeCoalescer->setOnline(isOnline());
+    mFolderSyncScheduler = new EwsFolderSyncScheduler(this);
+    connect(mFolderSyncScheduler, &EwsFolderSyncScheduler::syncRequested, this,
+            &EwsResource::foldersSyncRequested);
+    connect(mFolderSyncScheduler, &EwsFolderSyncScheduler::preemptionRequested, this,
+            &EwsResource::folderSyncPreemptionRequested);
+
     QMetaObject::invokeMethod(this, "delayedInit", Qt::QueuedConnection);
 
     connect(this, &AgentBase::reloadConfiguration, this, &EwsResource::reloadConfig);
@@ -164,6 +231,14 @@ EwsResource::~EwsResource()
 {
 }
 
+void EwsResource::cleanup()
+{
+    /* The resource is being removed - get rid of its synchronization state. */
+    mStateStore->clear();
+
+    ResourceBase::cleanup();
+}
+
 void EwsResource::delayedInit()
 {
     new ResourceAdaptor(this);
@@ -217,6 +292,7 @@ void EwsResource::rootFolderFetchFinished(KJob *job)
 
     EwsFolder folder = req->responses()[1].folder();
     EwsId id = folder[EwsFolderFieldFolderId].value<EwsId>();
+    EwsId inboxId;
     if (id.type() == EwsId::Real) {
 #ifdef HAVE_INBOX_FILTERING_WORKAROUND
         EwsId::setInboxId(id);
@@ -244,6 +320,8 @@ void EwsResource::rootFolderFetchFinished(KJob *job)
             mSettings->setServerSubscriptionList(subList);
         }
 #endif
+        // Use the same form of the identifier as the one found in notifications.
+        inboxId = EwsId(id.id());
     }
 
     folder = req->responses().first().folder();
@@ -255,8 +333,10 @@ void EwsResource::rootFolderFetchFinished(KJob *job)
         Q_EMIT status(Idle, i18nc("@info:status Resource is ready", "Ready"));
 
         if (mSettings->serverSubscription()) {
-            mSubManager.reset(new EwsSubscriptionManager(mEwsClient, id, mSettings.data(), this));
+            mSubManager.reset(new EwsSubscriptionManager(mEwsClient, id, mSettings.data(), mStateStore, this));
+            mSubManager->setInboxId(inboxId);
             connect(mSubManager.data(), &EwsSubscriptionManager::foldersModified, this, &EwsResource::foldersModifiedEvent);
+            connect(mSubManager.data(), &EwsSubscriptionManager::itemEventsReceived, this, &EwsResource::itemEventsReceived);
             connect(mSubManager.data(), &EwsSubscriptionManager::folderTreeModified, this, &EwsResource::folderTreeModifiedEvent);
             connect(mSubManager.data(), &EwsSubscriptionManager::fullSyncRequested, this, &EwsResource::fullSyncRequestedEvent);
 
@@ -347,6 +427,7 @@ void EwsResource::doRetrieveCollections()
     else {
         EwsFetchFoldersIncrJob *job = new EwsFetchFoldersIncrJob(mEwsClient, mFolderSyncState,
             mRootCollection, this);
+        job->setFolderTree(mFolderTree.data());
         connect(job, &EwsFetchFoldersIncrJob::result, this, &EwsResource::fetchFoldersIncrJobFinished);
         job->start();
     }
@@ -365,17 +446,39 @@ void EwsResource::retrieveItems(const Collection &collection)
     Q_EMIT status(Running, i18nc("@info:status", "Retrieving %1 items", collection.name()));
 
     QString rid = collection.remoteId();
+    mFolderSyncScheduler->syncStarted(rid);
+    if (mFolderSyncScheduler->shouldYield(rid)) {
+        /* A more important folder is waiting - let it go first and get back to this one later.
+         * The task goes back to the end of the queue, which doesn't mark the folder as synced. */
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Deferring sync of folder %1").arg(ewsHash(rid));
+        mFolderSyncScheduler->syncFinished(rid);
+        deferTask();
+        return;
+    }
     EwsFetchItemsJob *job = new EwsFetchItemsJob(collection, mEwsClient,
-        mSyncState.value(rid), mItemsToCheck.value(rid), mTagStore, this);
+        itemSyncState(rid), mItemsToCheck.value(rid), mTagStore, this);
+    if (fullSyncInProgress(rid)) {
+        job->resumeFullSync();
+    }
     job->setQueuedUpdates(mQueuedUpdates.value(collection.remoteId()));
     mQueuedUpdates.remove(collection.remoteId());
+    if (mSettings->calendarSyncWindow() &&
+        collection.contentMimeTypes().contains(KCalCore::Event::eventMimeType())) {
+        QDateTime now = QDateTime::currentDateTimeUtc();
+        job->setCalendarWindow(now.addDays(-static_cast<int>(mSettings->calendarSyncPastDays())),
+                               now.addDays(mSettings->calendarSyncFutureDays()));
+    }
     connect(job, &EwsFetchItemsJob::result, this, &EwsResource::itemFetchJobFinished);
+    connect(job, &EwsFetchItemsJob::syncStateCheckpoint, this, [this, rid](const QString &state, bool fullSync) {
+        setItemSyncState(rid, state, fullSync);
+    });
     connect(job, &EwsFetchItemsJob::status, this, [this](int s, const QString &message) {
         status(s, message);
     });
     connect(job, &EwsFetchItemsJob::percent, this, [this](int p) {
         percent(p);
     });
+    mItemFetchJob = job;
     job->start();
 }
 
@@ -390,9 +493,7 @@ bool EwsResource::retrieveItems(const Item::List &items, const QSet<QByteArray>
         ids << EwsId(item.remoteId(), item.remoteRevision());
     }
     req->setItemIds(ids);
-    EwsItemShape shape(EwsShapeIdOnly);
-    shape << EwsPropertyField("item:MimeContent");
-    req->setItemShape(shape);
+    req->setItemShape(itemPayloadShape(items));
     req->setProperty("items", QVariant::fromValue<Item::List>(items));
     connect(req, &EwsGetItemRequest::result, this, &EwsResource::getItemsRequestFinished);
     req->start();
@@ -469,9 +570,7 @@ bool EwsResource::retrieveItem(const Item &item, const QSet<QByteArray> &parts)
     EwsId::List ids;
     ids << EwsId(item.remoteId(), item.remoteRevision());
     req->setItemIds(ids);
-    EwsItemShape shape(EwsShapeIdOnly);
-    shape << EwsPropertyField("item:MimeContent");
-    req->setItemShape(shape);
+    req->setItemShape(itemPayloadShape(Item::List() << item));
     req->setProperty("item", QVariant::fromValue<Item>(item));
     connect(req, &EwsGetItemRequest::result, this, &EwsResource::getItemRequestFinished);
     req->start();
@@ -558,10 +657,12 @@ void EwsResource::fetchFoldersJobFinished(KJob *job)
     }
 
     mFolderSyncState = req->syncState();
-    saveState();
+    mStateStore->setValue(folderSyncStateKey, mFolderSyncState);
+    mFolderTree->setCollections(req->folders());
+    saveFolderTree();
     collectionsRetrieved(req->folders());
 
-    fetchSpecialFolders();
+    fetchSpecialFolders(true);
 }
 
 void EwsResource::fetchFoldersIncrJobFinished(KJob *job)
@@ -580,12 +681,15 @@ void EwsResource::fetchFoldersIncrJobFinished(KJob *job)
         /* Retry with a full sync. */
         qCWarningNC(EWSRES_LOG) << QStringLiteral("Retrying with a full sync.");
         mFolderSyncState.clear();
+        mFolderTree->clear();
         doRetrieveCollections();
         return;
     }
 
     mFolderSyncState = req->syncState();
-    saveState();
+    mStateStore->setValue(folderSyncStateKey, mFolderSyncState);
+    mFolderTree->applyChanges(req->changedFolders(), req->deletedFolders());
+    saveFolderTree();
     collectionsRetrievedIncremental(req->changedFolders(), req->deletedFolders());
 
     fetchSpecialFolders();
@@ -600,12 +704,20 @@ void EwsResource::itemFetchJobFinished(KJob *job)
         cancelTask(QStringLiteral("Invalid EwsFetchItemsJob job object"));
         return;
     }
+    mFolderSyncScheduler->syncFinished(fetchJob->collection().remoteId());
     if (job->error()) {
         qCWarningNC(EWSRES_LOG) << QStringLiteral("Item fetch error:") << job->errorString();
-        if (mSyncState.contains(fetchJob->collection().remoteId())) {
+        if (fetchJob->checkpointed()) {
+            /* Some pages have already been applied - keep the checkpoint so that the next sync
+             * resumes from there. Should the resumed sync fail before making any progress the
+             * state will be cleared as usual. */
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("Sync interrupted - will resume from last checkpoint.");
+            cancelTask(job->errorString());
+        }
+        else if (!itemSyncState(fetchJob->collection().remoteId()).isNull()) {
             qCDebugNC(EWSRES_LOG) << QStringLiteral("Retrying with empty state.");
             // Retry with a clear sync state.
-            mSyncState.remove(fetchJob->collection().remoteId());
+            setItemSyncState(fetchJob->collection().remoteId(), QString());
             retrieveItems(fetchJob->collection());
         }
         else {
@@ -616,10 +728,15 @@ void EwsResource::itemFetchJobFinished(KJob *job)
         }
     }
     else {
-        mSyncState[fetchJob->collection().remoteId()] = fetchJob->syncState();
+        /* A preempted full sync has only got as far as its last checkpoint. */
+        setItemSyncState(fetchJob->collection().remoteId(), fetchJob->syncState(),
+                         fetchJob->preempted() && fetchJob->fullSync());
         itemsRetrievedIncremental(fetchJob->changedItems(), fetchJob->deletedItems());
+        if (fetchJob->preempted()) {
+            /* Resume from the checkpoint once the more important folders are done. */
+            mFolderSyncScheduler->deferFolder(fetchJob->collection().remoteId());
+        }
     }
-    saveState();
     mItemsToCheck.remove(fetchJob->collection().remoteId());
     Q_EMIT status(Idle, i18nc("@info:status The resource is ready", "Ready"));
 }
@@ -646,28 +763,54 @@ void EwsResource::itemsFlagsChanged(const Akonadi::Item::List &items, const QSet
 {
     qCDebug(EWSRES_AGENTIF_LOG) << "itemsFlagsChanged: start" << items << addedFlags << removedFlags;
 
-    EwsModifyItemFlagsJob *job = new EwsModifyItemFlagsJob(mEwsClient, this, items, addedFlags, removedFlags);
-    connect(job, &EwsModifyItemFlagsJob::result, this, &EwsResource::itemModifyFlagsRequestFinished);
-    job->start();
+    /* Flag changes are sent to the server in batches - see EwsFlagsChangeCoalescer for details.
+     * The change needs to be committed straight away in order for Akonadi to deliver the next
+     * one. */
+    mFlagsChangeCoalescer->queueChange(items, addedFlags, removedFlags);
+
+    qCDebug(EWSRES_AGENTIF_LOG) << "itemsFlagsChanged: queued";
+    changesCommitted(items);
 }
 
-void EwsResource::itemModifyFlagsRequestFinished(KJob *job)
+void EwsResource::flagsChangesCommitted(const Item::List &items)
 {
-    if (job->error()) {
-        qCWarning(EWSRES_AGENTIF_LOG) << "itemsFlagsChanged:" << job->errorString();
-        cancelTask(job->errorString());
-        return;
+    /* The items have already been committed to Akonadi when the change was queued. The only
+     * thing left is to update the remote revisions, which have been changed by the update. */
+    Q_FOREACH(const Item &item, items) {
+        if (mSubManager) {
+            mSubManager->queueUpdate(EwsModifiedEvent, item.remoteId(), item.remoteRevision());
+        }
+        Item updItem(item.id());
+        updItem.setRemoteId(item.remoteId());
+        updItem.setRemoteRevision(item.remoteRevision());
+        ItemModifyJob *job = new ItemModifyJob(updItem, this);
+        job->disableRevisionCheck();
+        job->setIgnorePayload(true);
     }
 
-    EwsModifyItemFlagsJob *req = qobject_cast<EwsModifyItemFlagsJob*>(job);
-    if (!req) {
-        qCWarning(EWSRES_AGENTIF_LOG) << "itemsFlagsChanged: Invalid EwsModifyItemFlagsJob job object";
-        cancelTask(QStringLiteral("Invalid EwsModifyItemFlagsJob job object"));
-        return;
+    qCDebug(EWSRES_AGENTIF_LOG) << "itemsFlagsChanged: done for" << items;
+}
+
+void EwsResource::flagsChangesFailed(const Item::List &items, const QString &error)
+{
+    qCWarning(EWSRES_AGENTIF_LOG) << "itemsFlagsChanged:" << error;
+
+    /* As the change has already been committed to Akonadi the only way to get back in sync is to
+     * resynchronise the affected folders. In order to avoid doing a full sync a hint will be
+     * provided in order to indicate the item(s) to check. */
+    EwsId::List foldersToSync;
+    Q_FOREACH(const Item &item, items) {
+        warning(QStringLiteral("Flag change failed for item %1").arg(item.remoteId()));
+        EwsId colId = EwsId(item.parentCollection().remoteId(), QString());
+        mItemsToCheck[colId.id()].append(EwsId(item.remoteId(), QString()));
+        if (!foldersToSync.contains(colId)) {
+            foldersToSync.append(colId);
+        }
     }
 
-    qCDebug(EWSRES_AGENTIF_LOG) << "itemsFlagsChanged: done";
-    changesCommitted(req->items());
+    qCWarningNC(EWSRES_LOG) << QStringLiteral("Need to force sync for %1 folders.")
+                    .arg(foldersToSync.size());
+    foldersModifiedEvent(foldersToSync);
 }
 
 void EwsResource::itemChangeRequestFinished(KJob *job)
@@ -685,6 +828,12 @@ void EwsResource::itemChangeRequestFinished(KJob *job)
         return;
     }
 
+    if (!req->failedItems().isEmpty()) {
+        qCWarningNC(EWSRES_AGENTIF_LOG) << "itemChanged: Item update failed";
+        cancelTask(QStringLiteral("Item update failed"));
+        return;
+    }
+
     qCDebugNC(EWSRES_AGENTIF_LOG) << "itemChanged: done";
     changesCommitted(req->items());
 }
@@ -694,6 +843,15 @@ void EwsResource::itemsMoved(const Item::List &items, const Collection &sourceCo
 {
     qCDebug(EWSRES_AGENTIF_LOG) << "itemsMoved: start" << items << sourceCollection << destinationCollection;
 
+    /* Moving an item changes its id, so any queued flag changes need to reach the server first. */
+    mFlagsChangeCoalescer->flushAndWait([this, items, sourceCollection, destinationCollection]() {
+        moveItems(items, sourceCollection, destinationCollection);
+    });
+}
+
+void EwsResource::moveItems(const Item::List &items, const Collection &sourceCollection,
+                            const Collection &destinationCollection)
+{
     EwsId::List ids;
 
     Q_FOREACH(const Item &item, items) {
@@ -790,6 +948,127 @@ void EwsResource::itemsRemoved(const Item::List &items)
 {
     qCDebugNC(EWSRES_AGENTIF_LOG) << "itemsRemoved: start" << items;
 
+    /* Make sure that no flag change is sent for the items after they have been deleted. */
+    mFlagsChangeCoalescer->flushAndWait([this, items]() {
+        removeItems(items);
+    });
+}
+
+void EwsResource::removeItems(const Item::List &items)
+{
+    /* When a large number of items is removed from a single folder check if this covers the whole
+     * folder content (ex. emptying the trash). In such case the folder can be emptied on the
+     * server side using a single EmptyFolder request instead of deleting each item by id.
+     * EmptyFolder also removes items Akonadi doesn't know about yet, so it is only used for folders
+     * with a sync state, which makes it possible to check for such items. */
+    if (items.size() >= EmptyFolderMinItems
+        && mEwsClient.serverVersion().supports(EwsServerVersion::EmptyFolder)) {
+        const QString folderId = items.first().parentCollection().remoteId();
+        bool singleFolder = !folderId.isEmpty() && !itemSyncState(folderId).isEmpty();
+        Q_FOREACH(const Item &item, items) {
+            if (item.parentCollection().remoteId() != folderId) {
+                singleFolder = false;
+                break;
+            }
+        }
+
+        if (singleFolder) {
+            EwsGetFolderRequest *req = new EwsGetFolderRequest(mEwsClient, this);
+            req->setFolderIds(EwsId::List() << EwsId(folderId, QString()));
+            EwsFolderShape shape(EwsShapeIdOnly);
+            shape << EwsPropertyField(QStringLiteral("folder:TotalCount"));
+            req->setFolderShape(shape);
+            req->setProperty("items", QVariant::fromValue<Item::List>(items));
+            connect(req, &EwsRequest::result, this, &EwsResource::itemDeleteFolderFetchFinished);
+            req->start();
+            return;
+        }
+    }
+
+    deleteItems(items);
+}
+
+void EwsResource::itemDeleteFolderFetchFinished(KJob *job)
+{
+    Item::List items = job->property("items").value<Item::List>();
+
+    EwsGetFolderRequest *req = qobject_cast<EwsGetFolderRequest*>(job);
+    if (!req || req->error() || req->responses().size() != 1 || !req->responses().first().isSuccess()) {
+        qCWarningNC(EWSRES_AGENTIF_LOG) << "itemsRemoved: Failed to retrieve folder item count";
+        deleteItems(items);
+        return;
+    }
+
+    /* Only empty the folder if it doesn't contain anything more than the items being removed. */
+    const EwsFolder &folder = req->responses().first().folder();
+    if (folder[EwsFolderFieldTotalCount].toUInt() != static_cast<uint>(items.size())) {
+        deleteItems(items);
+        return;
+    }
+
+    /* The item count and the item list are not read atomically - a new item could have arrived in
+     * the meantime and replaced one that has been removed. Make sure that the folder hasn't changed
+     * since the last sync. */
+    const QString folderId = items.first().parentCollection().remoteId();
+    EwsSyncFolderItemsRequest *syncReq = new EwsSyncFolderItemsRequest(mEwsClient, this);
+    syncReq->setFolderId(folder[EwsFolderFieldFolderId].value<EwsId>());
+    syncReq->setItemShape(EwsItemShape(EwsShapeIdOnly));
+    syncReq->setSyncState(itemSyncState(folderId));
+    syncReq->setMaxChanges(1);
+    syncReq->setProperty("items", QVariant::fromValue<Item::List>(items));
+    syncReq->setProperty("folderId", QVariant::fromValue<EwsId>(folder[EwsFolderFieldFolderId].value<EwsId>()));
+    connect(syncReq, &EwsRequest::result, this, &EwsResource::itemDeleteFolderSyncFinished);
+    syncReq->start();
+}
+
+void EwsResource::itemDeleteFolderSyncFinished(KJob *job)
+{
+    Item::List items = job->property("items").value<Item::List>();
+
+    EwsSyncFolderItemsRequest *req = qobject_cast<EwsSyncFolderItemsRequest*>(job);
+    if (!req || req->error() || !req->changes().isEmpty()) {
+        qCDebugNC(EWSRES_AGENTIF_LOG) << "itemsRemoved: Folder changed since last sync - deleting items individually";
+        deleteItems(items);
+        return;
+    }
+
+    qCDebugNC(EWSRES_AGENTIF_LOG) << QStringLiteral("itemsRemoved: emptying folder %1 (%2 items)")
+                    .arg(ewsHash(items.first().parentCollection().remoteId())).arg(items.size());
+
+    EwsEmptyFolderRequest *emptyReq = new EwsEmptyFolderRequest(mEwsClient, this);
+    emptyReq->setFolderIds(EwsId::List() << job->property("folderId").value<EwsId>());
+    emptyReq->setProperty("items", QVariant::fromValue<Item::List>(items));
+    connect(emptyReq, &EwsEmptyFolderRequest::result, this, &EwsResource::itemEmptyFolderRequestFinished);
+    emptyReq->start();
+}
+
+void EwsResource::itemEmptyFolderRequestFinished(KJob *job)
+{
+    Item::List items = job->property("items").value<Item::List>();
+
+    EwsEmptyFolderRequest *req = qobject_cast<EwsEmptyFolderRequest*>(job);
+    if (!req || req->error() || req->responses().size() != 1 || !req->responses().first().isSuccess()) {
+        /* Some folders cannot be emptied (ex. search folders). Fall back to deleting the items
+         * by id. */
+        qCWarningNC(EWSRES_AGENTIF_LOG) << "itemsRemoved: EmptyFolder request failed - deleting items individually";
+        deleteItems(items);
+        return;
+    }
+
+    QString folderId = items.first().parentCollection().remoteId();
+    Q_FOREACH(const Item &item, items) {
+        if (mSubManager) {
+            mSubManager->queueUpdate(EwsDeletedEvent, item.remoteId(), QString());
+        }
+        mQueuedUpdates[folderId].append({item.remoteId(), QString(), EwsDeletedEvent});
+    }
+
+    qCDebug(EWSRES_AGENTIF_LOG) << "itemsRemoved: done";
+    changeProcessed();
+}
+
+void EwsResource::deleteItems(const Item::List &items)
+{
     EwsId::List ids;
 
     Q_FOREACH(const Item &item, items) {
@@ -874,12 +1153,148 @@ void EwsResource::itemAdded(const Item &item, const Collection &collection)
     if (isEwsMessageItemType(type)) {
         cancelTask("Item type not supported for creation");
     }
+    else if (!item.gid().isEmpty()) {
+        /* Items copied between collections arrive as new items, which carry no reference to the
+         * source item apart from the GID. Look for other items with the same GID in order to
+         * find out if this is a copy of an item in this mailbox. In such case the copy can be
+         * made on the server side, which avoids uploading the whole item content. */
+        Item gidItem;
+        gidItem.setGid(item.gid());
+        ItemFetchJob *job = new ItemFetchJob(gidItem, this);
+        job->fetchScope().setAncestorRetrieval(ItemFetchScope::Parent);
+        job->setProperty("item", QVariant::fromValue<Item>(item));
+        job->setProperty("collection", QVariant::fromValue<Collection>(collection));
+        connect(job, &ItemFetchJob::result, this, &EwsResource::itemCopySourceFetchFinished);
+    }
     else {
-        EwsCreateItemJob *job = EwsItemHandler::itemHandler(type)->createItemJob(mEwsClient, item,
-            collection, mTagStore, this);
-        connect(job, &EwsCreateItemJob::result, this, &EwsResource::itemCreateRequestFinished);
-        job->start();
+        createItem(item, collection);
+    }
+}
+
+void EwsResource::itemCopySourceFetchFinished(KJob *job)
+{
+    Item item = job->property("item").value<Item>();
+    Collection collection = job->property("collection").value<Collection>();
+
+    ItemFetchJob *fetchJob = qobject_cast<ItemFetchJob*>(job);
+    if (!fetchJob || fetchJob->error()) {
+        createItem(item, collection);
+        return;
+    }
+
+    Item::List candidates;
+    Collection::List parents;
+    Q_FOREACH(const Item &candidate, fetchJob->items()) {
+        if (candidate.id() == item.id() || candidate.remoteId().isEmpty()
+            || candidate.size() != item.size()) {
+            continue;
+        }
+        candidates.append(candidate);
+        if (!parents.contains(candidate.parentCollection())) {
+            parents.append(candidate.parentCollection());
+        }
     }
+
+    if (candidates.isEmpty()) {
+        createItem(item, collection);
+        return;
+    }
+
+    /* Make sure the candidate belongs to this resource. The items carry only the parent collection
+     * id, so the collections need to be fetched in order to find out their owner. */
+    CollectionFetchJob *collectionJob = new CollectionFetchJob(parents, CollectionFetchJob::Base, this);
+    collectionJob->fetchScope().setResource(identifier());
+    collectionJob->setProperty("item", QVariant::fromValue<Item>(item));
+    collectionJob->setProperty("collection", QVariant::fromValue<Collection>(collection));
+    collectionJob->setProperty("candidates", QVariant::fromValue<Item::List>(candidates));
+    connect(collectionJob, &CollectionFetchJob::result, this, &EwsResource::itemCopySourceCollectionFetchFinished);
+}
+
+void EwsResource::itemCopySourceCollectionFetchFinished(KJob *job)
+{
+    Item item = job->property("item").value<Item>();
+    Collection collection = job->property("collection").value<Collection>();
+
+    CollectionFetchJob *fetchJob = qobject_cast<CollectionFetchJob*>(job);
+    if (!fetchJob || fetchJob->error()) {
+        createItem(item, collection);
+        return;
+    }
+
+    QSet<Collection::Id> ownCollections;
+    Q_FOREACH(const Collection &col, fetchJob->collections()) {
+        if (col.resource() == identifier()) {
+            ownCollections.insert(col.id());
+        }
+    }
+
+    Item source;
+    Q_FOREACH(const Item &candidate, job->property("candidates").value<Item::List>()) {
+        if (ownCollections.contains(candidate.parentCollection().id())) {
+            source = candidate;
+            break;
+        }
+    }
+
+    if (!source.isValid()) {
+        createItem(item, collection);
+        return;
+    }
+
+    qCDebugNC(EWSRES_AGENTIF_LOG) << QStringLiteral("itemAdded: copying item %1 on server side")
+                    .arg(ewsHash(source.remoteId()));
+
+    EwsCopyItemRequest *req = new EwsCopyItemRequest(mEwsClient, this);
+    req->setItemIds(EwsId::List() << EwsId(source.remoteId(), QString()));
+    req->setDestinationFolderId(EwsId(collection.remoteId()));
+    req->setProperty("item", QVariant::fromValue<Item>(item));
+    req->setProperty("collection", QVariant::fromValue<Collection>(collection));
+    req->setProperty("source", QVariant::fromValue<Item>(source));
+    connect(req, &EwsCopyItemRequest::result, this, &EwsResource::itemCopyRequestFinished);
+    req->start();
+}
+
+void EwsResource::itemCopyRequestFinished(KJob *job)
+{
+    Item item = job->property("item").value<Item>();
+    Collection collection = job->property("collection").value<Collection>();
+
+    EwsCopyItemRequest *req = qobject_cast<EwsCopyItemRequest*>(job);
+    if (!req || req->error() || req->responses().size() != 1 || !req->responses().first().isSuccess()) {
+        qCWarningNC(EWSRES_AGENTIF_LOG) << "itemAdded: server side copy failed - uploading item";
+        createItem(item, collection);
+        return;
+    }
+
+    const EwsId &id = req->responses().first().itemId();
+    if (id.type() != EwsId::Real || id.id().isEmpty()) {
+        qCWarningNC(EWSRES_AGENTIF_LOG) << "itemAdded: server side copy returned no item id";
+        cancelTask(QStringLiteral("Invalid item id returned by the server."));
+        return;
+    }
+    item.setRemoteId(id.id());
+    item.setRemoteRevision(id.changeKey());
+    item.setParentCollection(collection);
+
+    /* The server side copy carries the flags of the source item, which may differ from the ones
+     * set on the new item. Write them back the same way as any other flag change. */
+    const Item source = job->property("source").value<Item>();
+    if (item.flags() != source.flags()) {
+        qCDebugNC(EWSRES_AGENTIF_LOG) << QStringLiteral("itemAdded: restoring flags of copied item %1")
+                        .arg(ewsHash(item.remoteId()));
+        mFlagsChangeCoalescer->queueChange(Item::List() << item, item.flags() - source.flags(),
+                                           source.flags() - item.flags());
+    }
+    changeCommitted(item);
+}
+
+void EwsResource::createItem(const Item &item, const Collection &collection)
+{
+    EwsItemType type = EwsItemHandler::mimeToItemType(item.mimeType());
+    EwsCreateItemJob *job = EwsItemHandler::itemHandler(type)->createItemJob(mEwsClient, item,
+        collection, mTagStore, this);
+    connect(job, &EwsCreateItemJob::result, this, &EwsResource::itemCreateRequestFinished);
+    job->start();
 }
 
 void EwsResource::itemCreateRequestFinished(KJob *job)
@@ -1177,6 +1592,11 @@ void EwsResource::messageSendRequestFinished(KJob *job)
 #endif
 
 void EwsResource::foldersModifiedEvent(EwsId::List folders)
+{
+    mFolderSyncScheduler->queueFolders(folders);
+}
+
+void EwsResource::foldersSyncRequested(const EwsId::List &folders)
 {
     Q_FOREACH(const EwsId &id, folders) {
         Collection c;
@@ -1185,20 +1605,84 @@ void EwsResource::foldersModifiedEvent(EwsId::List folders)
         job->setFetchScope(changeRecorder()->collectionFetchScope());
         job->fetchScope().setResource(identifier());
         job->fetchScope().setListFilter(CollectionFetchScope::Sync);
+        job->fetchScope().setIncludeStatistics(true);
+        job->setProperty("folderId", id.id());
         connect(job, SIGNAL(result(KJob*)), SLOT(foldersModifiedCollectionSyncFinished(KJob*)));
+        ++mFolderSyncFetchesPending;
     }
 
 }
 
 void EwsResource::foldersModifiedCollectionSyncFinished(KJob *job)
 {
+    --mFolderSyncFetchesPending;
+
+    CollectionFetchJob *fetchJob = qobject_cast<CollectionFetchJob*>(job);
     if (job->error()) {
         qCDebug(EWSRES_LOG) << QStringLiteral("Failed to fetch collection tree for sync.");
+        mFolderSyncScheduler->syncDropped(job->property("folderId").toString());
+    } else if (fetchJob->collections().isEmpty()) {
+        mFolderSyncScheduler->syncDropped(job->property("folderId").toString());
+    } else {
+        mFoldersToSync.append(fetchJob->collections()[0]);
+    }
+
+    if (mFolderSyncFetchesPending > 0) {
         return;
     }
 
-    CollectionFetchJob *fetchJob = qobject_cast<CollectionFetchJob*>(job);
-    synchronizeCollection(fetchJob->collections()[0].id());
+    /* Akonadi synchronizes the collections in the order they were requested. */
+    std::sort(mFoldersToSync.begin(), mFoldersToSync.end(), [this](const Collection &a, const Collection &b) {
+        double pa = mFolderSyncScheduler->priority(a.remoteId());
+        double pb = mFolderSyncScheduler->priority(b.remoteId());
+        if (pa != pb) {
+            return pa > pb;
+        }
+        return a.statistics().unreadCount() > b.statistics().unreadCount();
+    });
+    Q_FOREACH(const Collection &c, mFoldersToSync) {
+        synchronizeCollection(c.id());
+    }
+    mFoldersToSync.clear();
+}
+
+void EwsResource::folderSyncPreemptionRequested(const QString &folderId)
+{
+    if (mItemFetchJob && mItemFetchJob->collection().remoteId() == folderId) {
+        mItemFetchJob->preempt();
+    }
+}
+
+void EwsResource::itemEventsReceived(const EwsSubscriptionManager::ItemEventList &events)
+{
+    /* Events are applied strictly in order, so append to the running job if there is one. */
+    if (mItemEventsJob) {
+        mItemEventsJob->addEvents(events);
+        return;
+    }
+
+    mItemEventsJob = new EwsApplyItemEventsJob(mEwsClient, events, this);
+    connect(mItemEventsJob, &EwsApplyItemEventsJob::result, this, &EwsResource::itemEventsApplied);
+    mItemEventsJob->start();
+}
+
+void EwsResource::itemEventsApplied(KJob *job)
+{
+    EwsApplyItemEventsJob *eventsJob = qobject_cast<EwsApplyItemEventsJob*>(job);
+    Q_ASSERT(eventsJob);
+    mItemEventsJob = Q_NULLPTR;
+
+    /* The next incremental sync of the source folders will report the removals once again. */
+    const QHash<QString, QStringList> &removedItems = eventsJob->removedItems();
+    for (auto it = removedItems.cbegin(); it != removedItems.cend(); ++it) {
+        Q_FOREACH(const QString &itemId, it.value()) {
+            mQueuedUpdates[it.key()].append({itemId, QString(), EwsDeletedEvent});
+        }
+    }
+
+    if (!eventsJob->failedFolders().isEmpty()) {
+        foldersModifiedEvent(eventsJob->failedFolders());
+    }
 }
 
 void EwsResource::folderTreeModifiedEvent()
@@ -1213,26 +1697,35 @@ void EwsResource::fullSyncRequestedEvent()
 
 void EwsResource::clearFolderSyncState()
 {
-    mSyncState.clear();
-    saveState();
+    Q_FOREACH(const QString &key, mStateStore->keys()) {
+        if (key.startsWith(itemSyncStateKeyPrefix) || key.startsWith(fullSyncKeyPrefix)) {
+            mStateStore->remove(key);
+        }
+    }
+    mStateStore->flush();
 }
 
 void EwsResource::clearFolderSyncState(QString folderId)
 {
-    mSyncState.remove(folderId);
-    saveState();
+    setItemSyncState(folderId, QString());
 }
 
 void EwsResource::clearFolderTreeSyncState()
 {
     mFolderSyncState.clear();
-    saveState();
+    mFolderTree->clear();
+    mStateStore->remove(folderSyncStateKey);
+    mStateStore->remove(folderTreeKey);
+    mStateStore->flush();
 }
 
-void EwsResource::fetchSpecialFolders()
+void EwsResource::fetchSpecialFolders(bool prioritize)
 {
     CollectionFetchJob *job = new CollectionFetchJob(mRootCollection, CollectionFetchJob::Recursive, this);
-    connect(job, &CollectionFetchJob::collectionsReceived, this, &EwsResource::specialFoldersCollectionsRetrieved);
+    job->setProperty("prioritize", prioritize);
+    connect(job, &CollectionFetchJob::collectionsReceived, this, [this, job](const Collection::List &folders) {
+        specialFoldersCollectionsRetrieved(folders, job->property("prioritize").toBool());
+    });
     connect(job, &CollectionFetchJob::result, this, [this](KJob *job) {
         if (job->error()) {
             qCWarningNC(EWSRES_LOG) << "Special folders fetch failed:" << job->errorString();
@@ -1241,7 +1734,7 @@ void EwsResource::fetchSpecialFolders()
     job->start();
 }
 
-void EwsResource::specialFoldersCollectionsRetrieved(const Collection::List &folders)
+void EwsResource::specialFoldersCollectionsRetrieved(const Collection::List &folders, bool prioritize)
 {
     QStringList queryItemNames;
     EwsId::List queryItems;
@@ -1255,6 +1748,7 @@ void EwsResource::specialFoldersCollectionsRetrieved(const Collection::List &fol
         req->setFolderShape(EwsFolderShape(EwsShapeIdOnly));
         req->setFolderIds(queryItems);
         req->setProperty("collections", QVariant::fromValue<Collection::List>(folders));
+        req->setProperty("prioritize", prioritize);
         connect(req, &EwsGetFolderRequest::finished, this, &EwsResource::specialFoldersFetchFinished);
         req->start();
     }
@@ -1287,10 +1781,12 @@ void EwsResource::specialFoldersFetchFinished(KJob *job)
         map.insert(col.remoteId(), col);
     }
 
+    QStringList specialFolderIds;
     auto it = specialFolderList.cbegin();
     Q_FOREACH(const EwsGetFolderRequest::Response &resp, req->responses()) {
         if (resp.isSuccess()) {
             EwsId fid = resp.folder()[EwsFolderFieldFolderId].value<EwsId>();
+            specialFolderIds.append(fid.id());
             QMap<QString, Collection>::iterator mapIt = map.find(fid.id());
             if (mapIt != map.end()) {
                 qCDebugNC(EWSRES_LOG) << QStringLiteral("Registering folder %1(%2) as special collection %3")
@@ -1306,20 +1802,92 @@ void EwsResource::specialFoldersFetchFinished(KJob *job)
         }
         it++;
     }
+
+    mFolderSyncScheduler->setSpecialFolders(specialFolderIds);
+    if (req->property("prioritize").toBool()) {
+        /* Make sure the special folders are synchronized before the rest of the folder tree. */
+        EwsId::List folders;
+        Q_FOREACH(const QString &id, specialFolderIds) {
+            folders.append(EwsId(id));
+        }
+        mFolderSyncScheduler->queueFolders(folders);
+    }
 }
 
-void EwsResource::saveState()
+QString EwsResource::itemSyncState(const QString &folderId) const
 {
-    QByteArray str;
-    QDataStream dataStream(&str, QIODevice::WriteOnly);
-    dataStream << mSyncState;
-    mSettings->setSyncState(qCompress(str, 9).toBase64());
-    mSettings->setFolderSyncState(qCompress(mFolderSyncState.toAscii(), 9).toBase64());
-    mSettings->save();
+    return mStateStore->value(itemSyncStateKeyPrefix + folderId);
+}
+
+bool EwsResource::fullSyncInProgress(const QString &folderId) const
+{
+    return !mStateStore->value(fullSyncKeyPrefix + folderId).isNull();
+}
+
+void EwsResource::setItemSyncState(const QString &folderId, const QString &state, bool fullSync)
+{
+    mStateStore->setValue(itemSyncStateKeyPrefix + folderId, state);
+    /* Stored together with the state it refers to. */
+    if (fullSync) {
+        mStateStore->setValue(fullSyncKeyPrefix + folderId, QStringLiteral("1"));
+    } else {
+        mStateStore->remove(fullSyncKeyPrefix + folderId);
+    }
+    /* The state is only stored once the changes it covers have been applied, so it must not be
+     * lost in case of a crash. */
+    mStateStore->flush();
+}
+
+void EwsResource::saveFolderTree()
+{
+    /* The snapshot must always match the folder sync state it was taken with. */
+    mStateStore->setValue(folderTreeKey, mFolderTree->toString());
+    mStateStore->flush();
+}
+
+void EwsResource::importLegacyState()
+{
+    /* Older versions kept the whole synchronization state in the configuration file. */
+    QHash<QString, QString> syncState;
+    QByteArray data = QByteArray::fromBase64(mSettings->syncState().toAscii());
+    if (!data.isEmpty()) {
+        data = qUncompress(data);
+        if (!data.isEmpty()) {
+            QDataStream stream(data);
+            stream >> syncState;
+        }
+    }
+    for (auto it = syncState.cbegin(); it != syncState.cend(); ++it) {
+        mStateStore->setValue(itemSyncStateKeyPrefix + it.key(), it.value());
+    }
+
+    data = QByteArray::fromBase64(mSettings->folderSyncState().toAscii());
+    if (!data.isEmpty()) {
+        data = qUncompress(data);
+        if (!data.isEmpty()) {
+            mStateStore->setValue(folderSyncStateKey, QString::fromAscii(data));
+        }
+    }
+
+    mStateStore->setValue(EwsSubscriptionManager::watermarkKey, mSettings->eventSubscriptionWatermark());
+
+    if (!mStateStore->isEmpty()) {
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Imported %1 state entries from configuration")
+                        .arg(mStateStore->keys().size());
+        mStateStore->flush();
+        mSettings->setSyncState(QString());
+        mSettings->setFolderSyncState(QString());
+        mSettings->setEventSubscriptionWatermark(QString());
+        mSettings->save();
+    }
 }
 
 void EwsResource::doSetOnline(bool online)
 {
+    /* Called from the constructor before the coalescer exists - it picks up the state itself. */
+    if (mFlagsChangeCoalescer) {
+        mFlagsChangeCoalescer->setOnline(online);
+    }
     if (online) {
         resetUrl();
     } else {
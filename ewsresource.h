@@ -20,6 +20,7 @@
 #ifndef EWSRESOURCE_H
 #define EWSRESOURCE_H
 
+#include <QPointer>
 #include <QScopedPointer>
 
 #include <AkonadiAgentBase/ResourceBase>
@@ -29,6 +30,7 @@
 #include "ewsclient.h"
 #include "ewsfetchitemsjob.h"
 #include "ewsid.h"
+#include "ewssubscriptionmanager.h"
 
 #include <config.h>
 
@@ -38,10 +40,14 @@
 #endif
 
 class FetchItemState;
+class EwsApplyItemEventsJob;
+class EwsFlagsChangeCoalescer;
+class EwsFolderSyncScheduler;
 class EwsGetItemRequest;
 class EwsFindFolderRequest;
 class EwsFolder;
-class EwsSubscriptionManager;
+class EwsFolderTree;
+class EwsStateStore;
 class EwsTagStore;
 class Settings;
 
@@ -87,6 +93,7 @@ public:
 
     Settings *settings() { return mSettings.data(); };
 protected:
+    virtual void cleanup() Q_DECL_OVERRIDE;
     void doSetOnline(bool online) Q_DECL_OVERRIDE;
 public Q_SLOTS:
     void configure(WId windowId) Q_DECL_OVERRIDE;
@@ -112,10 +119,17 @@ private Q_SLOTS:
     void getItemRequestFinished(KJob *job);
 #endif
     void itemChangeRequestFinished(KJob *job);
-    void itemModifyFlagsRequestFinished(KJob *job);
+    void flagsChangesCommitted(const Akonadi::Item::List &items);
+    void flagsChangesFailed(const Akonadi::Item::List &items, const QString &error);
     void itemMoveRequestFinished(KJob *job);
     void itemDeleteRequestFinished(KJob *job);
+    void itemDeleteFolderFetchFinished(KJob *job);
+    void itemDeleteFolderSyncFinished(KJob *job);
+    void itemEmptyFolderRequestFinished(KJob *job);
     void itemCreateRequestFinished(KJob *job);
+    void itemCopySourceFetchFinished(KJob *job);
+    void itemCopySourceCollectionFetchFinished(KJob *job);
+    void itemCopyRequestFinished(KJob *job);
     void itemSendRequestFinished(KJob *job);
     void folderCreateRequestFinished(KJob *job);
     void folderMoveRequestFinished(KJob *job);
@@ -123,7 +137,11 @@ private Q_SLOTS:
     void folderDeleteRequestFinished(KJob *job);
     void delayedInit();
     void foldersModifiedEvent(EwsId::List folders);
+    void foldersSyncRequested(const EwsId::List &folders);
     void foldersModifiedCollectionSyncFinished(KJob *job);
+    void folderSyncPreemptionRequested(const QString &folderId);
+    void itemEventsReceived(const EwsSubscriptionManager::ItemEventList &events);
+    void itemEventsApplied(KJob *job);
     void folderTreeModifiedEvent();
     void fullSyncRequestedEvent();
     void rootFolderFetchFinished(KJob *job);
@@ -146,10 +164,19 @@ private Q_SLOTS:
 
 private:
     void finishItemsFetch(FetchItemState *state);
-    void fetchSpecialFolders();
-    void specialFoldersCollectionsRetrieved(const Akonadi::Collection::List &folders);
-
-    void saveState();
+    void fetchSpecialFolders(bool prioritize = false);
+    void moveItems(const Akonadi::Item::List &items, const Akonadi::Collection &sourceCollection,
+                   const Akonadi::Collection &destinationCollection);
+    void removeItems(const Akonadi::Item::List &items);
+    void deleteItems(const Akonadi::Item::List &items);
+    void createItem(const Akonadi::Item &item, const Akonadi::Collection &collection);
+    void specialFoldersCollectionsRetrieved(const Akonadi::Collection::List &folders, bool prioritize);
+
+    QString itemSyncState(const QString &folderId) const;
+    void setItemSyncState(const QString &folderId, const QString &state, bool fullSync = false);
+    bool fullSyncInProgress(const QString &folderId) const;
+    void importLegacyState();
+    void saveFolderTree();
     void resetUrl();
 
     void doRetrieveCollections();
@@ -159,14 +186,21 @@ private:
     EwsClient mEwsClient;
     Akonadi::Collection mRootCollection;
     QScopedPointer<EwsSubscriptionManager> mSubManager;
-    QHash<QString, QString> mSyncState;
     QString mFolderSyncState;
+    QScopedPointer<EwsFolderTree> mFolderTree;
     QHash<QString, EwsId::List> mItemsToCheck;
     QHash<QString, EwsFetchItemsJob::QueuedUpdateList> mQueuedUpdates;
     QString mPassword;
     bool mTagsRetrieved;
     int mReconnectTimeout;
     EwsTagStore *mTagStore;
+    EwsFlagsChangeCoalescer *mFlagsChangeCoalescer;
+    EwsFolderSyncScheduler *mFolderSyncScheduler;
+    Akonadi::Collection::List mFoldersToSync;
+    int mFolderSyncFetchesPending;
+    QPointer<EwsFetchItemsJob> mItemFetchJob;
+    EwsApplyItemEventsJob *mItemEventsJob;
+    EwsStateStore *mStateStore;
     QScopedPointer<Settings> mSettings;
 };
 
@@ -0,0 +1,344 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ewsstatestore.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "ewsclient_debug.h"
+
+static Q_CONSTEXPR quint32 snapshotMagic = 0x45575353; /* "EWSS" */
+static Q_CONSTEXPR quint32 formatVersion = 1;
+
+/* Each record starts with the payload size and checksum. */
+static Q_CONSTEXPR qint64 recordHeaderSize = sizeof(quint32) + sizeof(quint16);
+
+/* QDataStream length marker of a null string, which denotes a removed key. */
+static Q_CONSTEXPR quint32 nullStringSize = 0xFFFFFFFF;
+
+/* Delay between the first unsaved change and writing it to the journal. */
+static Q_CONSTEXPR int flushDelay = 5000; /* milliseconds */
+
+/* Do not bother compacting small journals even if the snapshot is smaller. */
+static Q_CONSTEXPR qint64 minCompactSize = 64 * 1024; /* bytes */
+
+static QByteArray makeRecord(const QString &key, const QString &value)
+{
+    QByteArray payload;
+    QDataStream payloadStream(&payload, QIODevice::WriteOnly);
+    payloadStream.setVersion(QDataStream::Qt_5_0);
+    payloadStream << key << value;
+
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << static_cast<quint32>(payload.size()) << qChecksum(payload.constData(), payload.size());
+    stream.writeRawData(payload.constData(), payload.size());
+    return record;
+}
+
+EwsStateStore::EwsStateStore(const QString &path, QObject *parent)
+    : QObject(parent), mPath(path), mSnapshotData(Q_NULLPTR)
+{
+    mFlushTimer.setSingleShot(true);
+    mFlushTimer.setInterval(flushDelay);
+    connect(&mFlushTimer, &QTimer::timeout, this, &EwsStateStore::flush);
+
+    QDir().mkpath(QFileInfo(mPath).absolutePath());
+    load();
+}
+
+EwsStateStore::~EwsStateStore()
+{
+    flush();
+}
+
+bool EwsStateStore::mapSnapshot()
+{
+    mSnapshotData = Q_NULLPTR;
+    mSnapshot.close();
+    mSnapshot.setFileName(mPath);
+    if (!mSnapshot.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    mSnapshotData = mSnapshot.map(0, mSnapshot.size());
+    return mSnapshotData != Q_NULLPTR;
+}
+
+void EwsStateStore::load()
+{
+    if (mapSnapshot()) {
+        QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(mSnapshotData), mSnapshot.size());
+        QBuffer buffer(&data);
+        buffer.open(QIODevice::ReadOnly);
+        QDataStream stream(&buffer);
+        stream.setVersion(QDataStream::Qt_5_0);
+        quint32 magic, version;
+        stream >> magic >> version;
+        if (magic == snapshotMagic && version == formatVersion) {
+            if (scanRecords(stream, Snapshot) < buffer.size()) {
+                qCWarning(EWSRES_LOG) << QStringLiteral("State snapshot %1 is damaged").arg(mPath);
+            }
+        } else {
+            qCWarning(EWSRES_LOG) << QStringLiteral("Invalid state snapshot %1 - ignoring").arg(mPath);
+        }
+    }
+
+    mJournal.setFileName(mPath + QStringLiteral(".journal"));
+    if (mJournal.open(QIODevice::ReadWrite)) {
+        QDataStream stream(&mJournal);
+        stream.setVersion(QDataStream::Qt_5_0);
+        qint64 validSize = scanRecords(stream, Journal);
+        if (validSize < mJournal.size()) {
+            /* Most likely a leftover of an interrupted write. Drop the damaged part so that new
+             * records are appended after the last valid one. */
+            qCWarning(EWSRES_LOG) << QStringLiteral("Discarding %1 bytes of damaged state journal")
+                            .arg(mJournal.size() - validSize);
+            mJournal.resize(validSize);
+        }
+        mJournal.seek(validSize);
+    } else {
+        qCWarning(EWSRES_LOG) << QStringLiteral("Failed to open state journal %1").arg(mJournal.fileName());
+    }
+
+    qCDebug(EWSRES_LOG) << QStringLiteral("Indexed %1 state entries").arg(mIndex.size());
+}
+
+qint64 EwsStateStore::scanRecords(QDataStream &stream, StoreFile file)
+{
+    QIODevice *dev = stream.device();
+    qint64 validEnd = dev->pos();
+
+    while (!stream.atEnd()) {
+        quint32 size;
+        quint16 checksum;
+        stream >> size >> checksum;
+        if (stream.status() != QDataStream::Ok || size > dev->size() - dev->pos()) {
+            break;
+        }
+
+        const qint64 offset = dev->pos();
+        QByteArray payload;
+        if (file == Snapshot) {
+            /* The snapshot is written atomically, so there is no need to verify the checksum, which
+             * would mean reading all the values. */
+            payload = QByteArray::fromRawData(reinterpret_cast<const char*>(mSnapshotData) + offset, size);
+            dev->seek(offset + size);
+        } else {
+            payload = dev->read(size);
+            if (payload.size() != static_cast<int>(size)
+                || qChecksum(payload.constData(), size) != checksum) {
+                break;
+            }
+        }
+
+        /* Only the key is of interest here - for the value it is enough to know if it is null. */
+        QDataStream payloadStream(payload);
+        payloadStream.setVersion(QDataStream::Qt_5_0);
+        QString key;
+        quint32 valueSize;
+        payloadStream >> key >> valueSize;
+        if (payloadStream.status() != QDataStream::Ok) {
+            break;
+        }
+
+        mPendingChanges.remove(key);
+        if (valueSize == nullStringSize) {
+            mIndex.remove(key);
+        } else {
+            mIndex.insert(key, {file, offset, size});
+        }
+        validEnd = dev->pos();
+    }
+
+    return validEnd;
+}
+
+QByteArray EwsStateStore::readPayload(const Location &location) const
+{
+    if (location.file == Snapshot) {
+        if (!mSnapshotData) {
+            return QByteArray();
+        }
+        return QByteArray::fromRawData(reinterpret_cast<const char*>(mSnapshotData) + location.offset,
+                                       location.size);
+    } else if (location.file == Journal) {
+        const qint64 pos = mJournal.pos();
+        mJournal.seek(location.offset);
+        QByteArray payload = mJournal.read(location.size);
+        mJournal.seek(pos);
+        return payload;
+    }
+    return QByteArray();
+}
+
+QString EwsStateStore::value(const QString &key) const
+{
+    auto pendingIt = mPendingChanges.constFind(key);
+    if (pendingIt != mPendingChanges.cend()) {
+        return *pendingIt;
+    }
+
+    auto it = mIndex.constFind(key);
+    if (it == mIndex.cend()) {
+        return QString();
+    }
+
+    QDataStream stream(readPayload(*it));
+    stream.setVersion(QDataStream::Qt_5_0);
+    QString storedKey, value;
+    stream >> storedKey >> value;
+    return value;
+}
+
+void EwsStateStore::setValue(const QString &key, const QString &value)
+{
+    if (value.isNull()) {
+        remove(key);
+        return;
+    }
+
+    if (mIndex.contains(key) && this->value(key) == value) {
+        return;
+    }
+
+    mIndex.insert(key, {Pending, 0, 0});
+    queueChange(key, value);
+}
+
+void EwsStateStore::remove(const QString &key)
+{
+    if (mIndex.remove(key) > 0) {
+        queueChange(key, QString());
+    }
+}
+
+void EwsStateStore::clear()
+{
+    mFlushTimer.stop();
+    mIndex.clear();
+    mPendingChanges.clear();
+
+    mSnapshotData = Q_NULLPTR;
+    mSnapshot.close();
+    QFile::remove(mPath);
+    mJournal.close();
+    mJournal.remove();
+
+    QDir().rmdir(QFileInfo(mPath).absolutePath());
+}
+
+void EwsStateStore::queueChange(const QString &key, const QString &value)
+{
+    mPendingChanges.insert(key, value);
+    if (!mFlushTimer.isActive()) {
+        mFlushTimer.start();
+    }
+}
+
+void EwsStateStore::flush()
+{
+    mFlushTimer.stop();
+
+    if (mPendingChanges.isEmpty()) {
+        return;
+    }
+
+    if (!mJournal.isOpen()) {
+        /* Without a journal the only option is to write a full snapshot. */
+        compact();
+        return;
+    }
+
+    const qint64 start = mJournal.size();
+    QByteArray data;
+    QHash<QString, Location> locations;
+    for (auto it = mPendingChanges.cbegin(); it != mPendingChanges.cend(); ++it) {
+        QByteArray record = makeRecord(it.key(), it.value());
+        if (!it.value().isNull()) {
+            locations.insert(it.key(), {Journal, start + data.size() + recordHeaderSize,
+                                        static_cast<quint32>(record.size() - recordHeaderSize)});
+        }
+        data += record;
+    }
+
+    mJournal.seek(start);
+    if (mJournal.write(data) != data.size() || !mJournal.flush()) {
+        qCWarning(EWSRES_LOG) << QStringLiteral("Failed to write state journal %1").arg(mJournal.fileName());
+        mJournal.resize(start);
+        mJournal.seek(start);
+        compact();
+        return;
+    }
+
+    for (auto it = locations.cbegin(); it != locations.cend(); ++it) {
+        mIndex.insert(it.key(), it.value());
+    }
+    mPendingChanges.clear();
+
+    if (mJournal.size() > qMax(mSnapshot.size(), minCompactSize)) {
+        compact();
+    }
+}
+
+void EwsStateStore::compact()
+{
+    QSaveFile file(mPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(EWSRES_LOG) << QStringLiteral("Failed to open state snapshot %1").arg(mPath);
+        return;
+    }
+
+    QByteArray header;
+    QDataStream headerStream(&header, QIODevice::WriteOnly);
+    headerStream.setVersion(QDataStream::Qt_5_0);
+    headerStream << snapshotMagic << formatVersion;
+    file.write(header);
+
+    /* The current values are read from the old snapshot while the new one is being written. This
+     * is safe as the new snapshot replaces the old one only once it is committed. */
+    QHash<QString, Location> index;
+    qint64 pos = header.size();
+    for (auto it = mIndex.cbegin(); it != mIndex.cend(); ++it) {
+        QByteArray record = makeRecord(it.key(), value(it.key()));
+        index.insert(it.key(), {Snapshot, pos + recordHeaderSize,
+                                static_cast<quint32>(record.size() - recordHeaderSize)});
+        file.write(record);
+        pos += record.size();
+    }
+
+    if (!file.commit()) {
+        qCWarning(EWSRES_LOG) << QStringLiteral("Failed to write state snapshot %1").arg(mPath);
+        return;
+    }
+
+    /* The snapshot now contains all changes, including the ones not written to the journal. */
+    mIndex = index;
+    mPendingChanges.clear();
+    if (!mapSnapshot()) {
+        qCWarning(EWSRES_LOG) << QStringLiteral("Failed to map state snapshot %1").arg(mPath);
+    }
+    if (mJournal.isOpen()) {
+        mJournal.resize(0);
+        mJournal.seek(0);
+    }
+}
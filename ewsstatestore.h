@@ -0,0 +1,106 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#ifndef EWSSTATESTORE_H
+#define EWSSTATESTORE_H
+
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+/**
+ *  @brief  Persistent key-value store for synchronization state
+ *
+ *  The resource needs to persist a number of frequently changing values, such as the item sync
+ *  states of all folders or the event subscription watermark. Keeping them in the configuration
+ *  file would mean rewriting the whole file each time a single value changes.
+ *
+ *  This class stores the values in a snapshot file accompanied by an append-only journal. Each
+ *  change is recorded in memory and written out to the journal in batches, either after a short
+ *  delay or when flush() is called explicitly. Once the journal grows larger than the snapshot
+ *  the store is compacted - a new snapshot is written atomically and the journal is emptied.
+ *
+ *  Both files consist of the same checksummed records. When the store is opened the records are
+ *  only scanned in order to build an index of keys and the location of their latest value. Values
+ *  are read on demand (the snapshot is memory-mapped for this purpose), so that the sync states of
+ *  folders that are not being synchronized are never loaded into memory.
+ *
+ *  When scanning the journal only the records up to the first incomplete or damaged one are taken
+ *  into account, which is what is left behind if the process gets killed in the middle of a write.
+ *  Replaying a journal which has already been merged into the snapshot is harmless as the records
+ *  are applied in order.
+ *
+ *  Changes which have not been flushed yet are lost if the process is killed. For values that must
+ *  not go back in time (ex. sync states, which are only stored once the corresponding changes have
+ *  been applied to Akonadi) the caller needs to call flush() straight after setting them. For the
+ *  remaining ones losing the last few seconds of changes only results in some work being redone.
+ */
+class EwsStateStore : public QObject
+{
+    Q_OBJECT
+public:
+    EwsStateStore(const QString &path, QObject *parent);
+    virtual ~EwsStateStore();
+
+    bool isEmpty() const { return mIndex.isEmpty(); };
+    QStringList keys() const { return mIndex.keys(); };
+    QString value(const QString &key) const;
+    void setValue(const QString &key, const QString &value);
+    void remove(const QString &key);
+
+    /* Removes all values together with the files backing the store. */
+    void clear();
+public Q_SLOTS:
+    void flush();
+private:
+    enum StoreFile {
+        Snapshot,
+        Journal,
+        Pending
+    };
+
+    /* Location of the payload of the record holding the current value of a key. */
+    struct Location {
+        StoreFile file;
+        qint64 offset;
+        quint32 size;
+    };
+
+    void load();
+    bool mapSnapshot();
+    qint64 scanRecords(QDataStream &stream, StoreFile file);
+    QByteArray readPayload(const Location &location) const;
+    void compact();
+    void queueChange(const QString &key, const QString &value);
+
+    QString mPath;
+    QHash<QString, Location> mIndex;
+    /* Changes not written to the journal yet. A null value denotes removal. */
+    QHash<QString, QString> mPendingChanges;
+    QFile mSnapshot;
+    const uchar *mSnapshotData;
+    mutable QFile mJournal;
+    QTimer mFlushTimer;
+};
+
+#endif
@@ -0,0 +1,217 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ewsstreamingchannel.h"
+
+#include "ewsclient.h"
+#include "ewsgetstreamingeventsrequest.h"
+#include "ewsclient_debug.h"
+
+static Q_CONSTEXPR uint streamingTimeout = 30; /* minutes */
+
+static Q_CONSTEXPR uint streamingConnTimeout = 60; /* seconds */
+
+/* Channels in use keyed by server URL and user name. */
+static QHash<QString, EwsStreamingChannel*> channels;
+
+EwsStreamingChannel *EwsStreamingChannel::channel(EwsClient &client)
+{
+    const QString key = client.url().toString(QUrl::RemovePassword);
+    EwsStreamingChannel *channel = channels.value(key);
+    if (!channel) {
+        channel = new EwsStreamingChannel(key);
+        channels.insert(key, channel);
+    }
+    return channel;
+}
+
+EwsStreamingChannel::EwsStreamingChannel(const QString &key)
+    : QObject(Q_NULLPTR), mKey(key), mRestartPending(false)
+{
+    mConnectionTimer.setInterval(streamingConnTimeout * 1000);
+    mConnectionTimer.setSingleShot(true);
+    connect(&mConnectionTimer, &QTimer::timeout, this, &EwsStreamingChannel::connectionTimeout);
+}
+
+EwsStreamingChannel::~EwsStreamingChannel()
+{
+    stopRequest();
+}
+
+void EwsStreamingChannel::addSubscription(const QString &id, EwsClient &client)
+{
+    /* Re-adding an existing subscription is used by the owner to request a reconnection. */
+    const bool known = mSubscriptions.contains(id);
+    mSubscriptions.insert(id, &client);
+    if (known || !mRequest) {
+        scheduleRestart();
+    } else {
+        /* Restarting the live request would drop any events in flight for the other
+         * subscriptions. The new one will be included once the request is reconnected. */
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Streaming subscription %1 will join on next reconnect")
+            .arg(id);
+    }
+}
+
+void EwsStreamingChannel::removeSubscription(const QString &id)
+{
+    if (mSubscriptions.remove(id) == 0) {
+        return;
+    }
+
+    if (mSubscriptions.isEmpty()) {
+        stopRequest();
+        channels.remove(mKey);
+        deleteLater();
+    }
+
+    /* Otherwise keep the live request running. Notifications for the removed subscription are
+     * dropped until the next reconnection leaves it out. */
+}
+
+void EwsStreamingChannel::scheduleRestart()
+{
+    /* Defer the restart so that multiple subscriptions added in a row result in a single
+     * reconnection. */
+    if (!mRestartPending) {
+        mRestartPending = true;
+        QMetaObject::invokeMethod(this, "restart", Qt::QueuedConnection);
+    }
+}
+
+void EwsStreamingChannel::stopRequest()
+{
+    mConnectionTimer.stop();
+    if (mRequest) {
+        mRequest->disconnect(this);
+        mRequest->kill();
+        mRequest->deleteLater();
+        mRequest = Q_NULLPTR;
+    }
+}
+
+void EwsStreamingChannel::restart()
+{
+    mRestartPending = false;
+    stopRequest();
+
+    /* Any of the clients will do, as all of them point to the same server and user. Use the first
+     * one that still exists. */
+    EwsClient *client = Q_NULLPTR;
+    for (auto it = mSubscriptions.begin(); it != mSubscriptions.end();) {
+        if (it.value()) {
+            client = it.value();
+            ++it;
+        } else {
+            it = mSubscriptions.erase(it);
+        }
+    }
+    if (!client) {
+        return;
+    }
+
+    EwsGetStreamingEventsRequest *req = new EwsGetStreamingEventsRequest(*client, this);
+    req->setSubscriptionIds(mSubscriptions.keys());
+    req->setTimeout(streamingTimeout);
+    connect(req, &EwsRequest::result, this, &EwsStreamingChannel::requestFinished);
+    connect(req, &EwsGetStreamingEventsRequest::eventsReceived, this, &EwsStreamingChannel::eventsReceived);
+    req->start();
+    mRequest = req;
+    mConnectionTimer.start();
+}
+
+void EwsStreamingChannel::eventsReceived(KJob *job)
+{
+    mConnectionTimer.stop();
+
+    EwsGetStreamingEventsRequest *req = qobject_cast<EwsGetStreamingEventsRequest*>(job);
+    if (!req || req != mRequest) {
+        return;
+    }
+
+    if (!job->error()) {
+        processResponses(req);
+        if (mRequest) {
+            mConnectionTimer.start();
+        }
+    }
+}
+
+void EwsStreamingChannel::requestFinished(KJob *job)
+{
+    mConnectionTimer.stop();
+
+    EwsGetStreamingEventsRequest *req = qobject_cast<EwsGetStreamingEventsRequest*>(job);
+    if (!req || req != mRequest) {
+        return;
+    }
+
+    /* Also look at the responses in case of an error as they may indicate invalid
+     * subscriptions. */
+    processResponses(req);
+
+    if (mRequest) {
+        mRequest->deleteLater();
+        mRequest = Q_NULLPTR;
+    }
+
+    /* The server closes the connection once the timeout expires, so reconnect regardless of the
+     * outcome. */
+    scheduleRestart();
+}
+
+void EwsStreamingChannel::connectionTimeout()
+{
+    if (mRequest) {
+        qCWarningNC(EWSRES_LOG) << QStringLiteral("Streaming request timeout - restarting");
+        scheduleRestart();
+    }
+}
+
+void EwsStreamingChannel::processResponses(EwsGetStreamingEventsRequest *req)
+{
+    Q_FOREACH(const EwsEventRequestBase::Response &resp, req->responses()) {
+        if (!resp.isSuccess()) {
+            if (resp.responseCode() == QStringLiteral("ErrorInvalidSubscription")
+                || resp.responseCode() == QStringLiteral("ErrorSubscriptionNotFound")) {
+                QStringList failedIds = resp.errorSubscriptionIds();
+                if (failedIds.isEmpty()) {
+                    failedIds = mSubscriptions.keys();
+                }
+                Q_FOREACH(const QString &id, failedIds) {
+                    if (mSubscriptions.remove(id) > 0) {
+                        Q_EMIT subscriptionFailed(id);
+                    }
+                }
+            }
+        } else {
+            QHash<QString, EwsEventRequestBase::Notification::List> notifications;
+            Q_FOREACH(const EwsEventRequestBase::Notification &nfy, resp.notifications()) {
+                notifications[nfy.subscriptionId()].append(nfy);
+            }
+            for (auto it = notifications.cbegin(); it != notifications.cend(); ++it) {
+                if (!mSubscriptions.contains(it.key())) {
+                    continue;
+                }
+                Q_EMIT notificationsReceived(it.key(), it.value());
+            }
+        }
+        req->eventsProcessed(resp);
+    }
+}
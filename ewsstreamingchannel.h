@@ -0,0 +1,91 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#ifndef EWSSTREAMINGCHANNEL_H
+#define EWSSTREAMINGCHANNEL_H
+
+#include <QHash>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+
+#include "ewseventrequestbase.h"
+
+class EwsClient;
+class EwsGetStreamingEventsRequest;
+class KJob;
+
+/**
+ *  @brief  Shared streaming notification channel
+ *
+ *  A streaming subscription requires a long-lived GetStreamingEvents connection to the server. A
+ *  single such request is able to carry multiple subscription identifiers, which makes it possible
+ *  to serve several subscriptions for the same server and user using a single connection.
+ *
+ *  Channels are shared only by subscription managers running in the same process. As Akonadi
+ *  runs each resource instance in a process of its own, resources handling different mailboxes
+ *  still use separate connections.
+ *
+ *  Each manager registers its subscription with the channel. In order not to lose events that are
+ *  in flight a live connection is not interrupted when a subscription is added or removed - a new
+ *  subscription joins the channel on the next reconnection, while the server keeps its events
+ *  queued in the meantime. A connection is only started immediately if none is running or when the
+ *  owner re-adds a subscription that is already registered, which is used to request a
+ *  reconnection. Notifications received are dispatched back to the owner using the subscription
+ *  identifier.
+ *
+ *  The channel takes care of restarting the connection when the server closes it, when it fails
+ *  and when no data has been received for too long. Subscriptions reported by the server as
+ *  invalid are removed from the channel and reported back to their owners.
+ *
+ *  Once the last subscription is removed the connection is closed and the channel is destroyed.
+ */
+class EwsStreamingChannel : public QObject
+{
+    Q_OBJECT
+public:
+    static EwsStreamingChannel *channel(EwsClient &client);
+
+    void addSubscription(const QString &id, EwsClient &client);
+    void removeSubscription(const QString &id);
+Q_SIGNALS:
+    void notificationsReceived(const QString &subscriptionId,
+                               const EwsEventRequestBase::Notification::List &notifications);
+    void subscriptionFailed(const QString &subscriptionId);
+private Q_SLOTS:
+    void restart();
+    void eventsReceived(KJob *job);
+    void requestFinished(KJob *job);
+    void connectionTimeout();
+private:
+    explicit EwsStreamingChannel(const QString &key);
+    virtual ~EwsStreamingChannel();
+
+    void scheduleRestart();
+    void processResponses(EwsGetStreamingEventsRequest *req);
+    void stopRequest();
+
+    QString mKey;
+    QHash<QString, QPointer<EwsClient>> mSubscriptions;
+    QPointer<EwsGetStreamingEventsRequest> mRequest;
+    QTimer mConnectionTimer;
+    bool mRestartPending;
+};
+
+#endif
@@ -20,6 +20,7 @@
 #include "ewssubscribedfoldersjob.h"
 
 #include "ewsclient.h"
+#include "ewsfindfolderrequest.h"
 #include "ewsgetfolderrequest.h"
 #include "settings.h"
 #include "ewsclient_debug.h"
@@ -36,6 +37,18 @@ EwsSubscribedFoldersJob::~EwsSubscribedFoldersJob()
 
 void EwsSubscribedFoldersJob::start()
 {
+    /* Older servers are not able to subscribe to all folders by themselves. In such case retrieve
+     * the full folder tree and subscribe to each folder explicitly. */
+    if (mSettings->serverSubscriptionAllFolders()) {
+        EwsFindFolderRequest *req = new EwsFindFolderRequest(mClient, this);
+        req->setFolderShape(EwsFolderShape(EwsShapeIdOnly));
+        req->setParentFolderId(EwsId(EwsDIdMsgFolderRoot));
+        req->setTraversal(EwsTraversalDeep);
+        connect(req, &EwsRequest::result, this, &EwsSubscribedFoldersJob::allFoldersRequestFinished);
+        req->start();
+        return;
+    }
+
     EwsId::List ids;
 
     // Before subscribing make sure the subscription list doesn't contain invalid folders.
@@ -91,6 +104,22 @@ void EwsSubscribedFoldersJob::verifySubFoldersRequestFinished(KJob *job)
     emitResult();
 }
 
+void EwsSubscribedFoldersJob::allFoldersRequestFinished(KJob *job)
+{
+    if (!job->error()) {
+        EwsFindFolderRequest *req = qobject_cast<EwsFindFolderRequest*>(job);
+        Q_ASSERT(req);
+
+        mFolders.clear();
+        Q_FOREACH(const EwsFolder &folder, req->folders()) {
+            mFolders << EwsId(folder[EwsFolderFieldFolderId].value<EwsId>().id());
+        }
+    } else {
+        setErrorMsg(job->errorString(), job->error());
+    }
+    emitResult();
+}
+
 const EwsId::List &EwsSubscribedFoldersJob::defaultSubscriptionFolders()
 {
     static const EwsId::List list = {EwsId(EwsDIdInbox), EwsId(EwsDIdCalendar), EwsId(EwsDIdTasks),
@@ -40,6 +40,7 @@ public:
     static const EwsId::List &defaultSubscriptionFolders();
 private Q_SLOTS:
     void verifySubFoldersRequestFinished(KJob *job);
+    void allFoldersRequestFinished(KJob *job);
 private:
     EwsId::List mFolders;
     EwsClient &mClient;
@@ -22,28 +22,26 @@
 #include "ewsclient_debug.h"
 #include "ewsgeteventsrequest.h"
 #include "ewsgetfolderrequest.h"
-#include "ewsgetstreamingeventsrequest.h"
+#include "ewsstreamingchannel.h"
+#include "ewsstatestore.h"
 #include "ewssubscribedfoldersjob.h"
 #include "ewssubscriberequest.h"
 #include "ewsunsubscriberequest.h"
 #include "settings.h"
 
-// TODO: Allow customization
-static Q_CONSTEXPR uint pollInterval = 10; /* seconds */
+/* Pull subscriptions expire on the server when not polled for 30 minutes. Never let the poll
+ * interval get close to that regardless of the configuration. */
+static Q_CONSTEXPR uint pollIntervalLimit = 20 * 60; /* seconds */
 
-static Q_CONSTEXPR uint streamingTimeout = 30; /* minutes */
-
-static Q_CONSTEXPR uint streamingConnTimeout = 60; /* seconds */
+const QString EwsSubscriptionManager::watermarkKey = QStringLiteral("EventSubscriptionWatermark");
 
 EwsSubscriptionManager::EwsSubscriptionManager(EwsClient &client, const EwsId &rootId,
-                                               Settings *settings, QObject *parent)
-    : QObject(parent), mEwsClient(client), mPollTimer(this), mMsgRootId(rootId), mFolderTreeChanged(false),
-      mEventReq(Q_NULLPTR), mSettings(settings)
+                                               Settings *settings, EwsStateStore *stateStore,
+                                               QObject *parent)
+    : QObject(parent), mEwsClient(client), mPollTimer(this), mPollInterval(0), mMsgRootId(rootId),
+      mFolderTreeChanged(false), mFolderAdded(false), mEventReq(Q_NULLPTR), mSettings(settings), mStateStore(stateStore)
 {
     mStreamingEvents = mEwsClient.serverVersion().supports(EwsServerVersion::StreamingSubscription);
-    mStreamingTimer.setInterval(streamingConnTimeout * 1000);
-    mStreamingTimer.setSingleShot(true);
-    connect(&mStreamingTimer, SIGNAL(timeout()), this, SLOT(streamingConnectionTimeout()));
 }
 
 EwsSubscriptionManager::~EwsSubscriptionManager()
@@ -61,8 +59,9 @@ void EwsSubscriptionManager::start()
     }
 
     if (!mStreamingEvents) {
-        mPollTimer.setInterval(pollInterval * 1000);
-        mPollTimer.setSingleShot(false);
+        /* The timer is armed each time a poll has completed as the interval depends on its
+         * outcome. */
+        mPollTimer.setSingleShot(true);
         connect(&mPollTimer, &QTimer::timeout, this, &EwsSubscriptionManager::getEvents);
     }
 }
@@ -70,18 +69,26 @@ void EwsSubscriptionManager::start()
 void EwsSubscriptionManager::cancelSubscription()
 {
     if (!mSettings->eventSubscriptionId().isEmpty()) {
+        if (mChannel) {
+            mChannel->removeSubscription(mSettings->eventSubscriptionId());
+        }
         QPointer<EwsUnsubscribeRequest> req = new EwsUnsubscribeRequest(mEwsClient, this);
         req->setSubscriptionId(mSettings->eventSubscriptionId());
         req->exec();
         mSettings->setEventSubscriptionId(QString());
-        mSettings->setEventSubscriptionWatermark(QString());
+        mStateStore->remove(watermarkKey);
         mSettings->save();
     }
 }
 
 void EwsSubscriptionManager::setupSubscription()
 {
-    EwsId::List ids;
+    /* When subscribing to all folders there is no need to retrieve the folder list if the server
+     * is able to do it by itself. */
+    if (serverSubscribesAllFolders()) {
+        setupSubscriptionReq(EwsId::List(), true);
+        return;
+    }
 
     EwsSubscribedFoldersJob *job = new EwsSubscribedFoldersJob(mEwsClient, mSettings, this);
     connect(job, &EwsRequest::result, this, &EwsSubscriptionManager::verifySubFoldersRequestFinished);
@@ -94,16 +101,15 @@ void EwsSubscriptionManager::verifySubFoldersRequestFinished(KJob *job)
         EwsSubscribedFoldersJob *folderJob = qobject_cast<EwsSubscribedFoldersJob*>(job);
         Q_ASSERT(folderJob);
 
-        setupSubscriptionReq(folderJob->folders());
+        setupSubscriptionReq(folderJob->folders(), false);
     } else {
         Q_EMIT connectionError();
     }
 }
 
-void EwsSubscriptionManager::setupSubscriptionReq(const EwsId::List &ids)
+void EwsSubscriptionManager::setupSubscriptionReq(const EwsId::List &ids, bool allFolders)
 {
     EwsSubscribeRequest *req = new EwsSubscribeRequest(mEwsClient, this);
-    //req->setAllFolders(true);
     QList<EwsEventType> events;
     events << EwsNewMailEvent;
     events << EwsMovedEvent;
@@ -119,18 +125,21 @@ void EwsSubscriptionManager::setupSubscriptionReq(const EwsId::List &ids)
         req->setType(EwsSubscribeRequest::PullSubscription);
     }
     req->setFolderIds(ids);
-    req->setAllFolders(false);
+    req->setAllFolders(allFolders);
     connect(req, &EwsRequest::result, this, &EwsSubscriptionManager::subscribeRequestFinished);
     req->start();
 }
 
+bool EwsSubscriptionManager::serverSubscribesAllFolders() const
+{
+    return mSettings->serverSubscriptionAllFolders()
+        && mEwsClient.serverVersion().supports(EwsServerVersion::SubscribeToAllFolders);
+}
+
 void EwsSubscriptionManager::reset()
 {
     mPollTimer.stop();
     getEvents();
-    if (!mStreamingEvents) {
-        mPollTimer.start();
-    }
 }
 
 void EwsSubscriptionManager::resetSubscription()
@@ -150,9 +159,10 @@ void EwsSubscriptionManager::subscribeRequestFinished(KJob *job)
                 getEvents();
             }
             else {
-                mSettings->setEventSubscriptionWatermark(req->response().watermark());
+                mStateStore->setValue(watermarkKey, req->response().watermark());
+                /* The watermark must not get out of step with the subscription id. */
+                mStateStore->flush();
                 getEvents();
-                mPollTimer.start();
             }
             mSettings->save();
         }
@@ -164,20 +174,25 @@ void EwsSubscriptionManager::subscribeRequestFinished(KJob *job)
 void EwsSubscriptionManager::getEvents()
 {
     if (mStreamingEvents) {
-        EwsGetStreamingEventsRequest *req = new EwsGetStreamingEventsRequest(mEwsClient, this);
-        req->setSubscriptionId(mSettings->eventSubscriptionId());
-        req->setTimeout(streamingTimeout);
-        connect(req, &EwsRequest::result, this, &EwsSubscriptionManager::getEventsRequestFinished);
-        connect(req, &EwsGetStreamingEventsRequest::eventsReceived, this,
-                &EwsSubscriptionManager::streamingEventsReceived);
-        req->start();
-        mEventReq = req;
-        mStreamingTimer.start();
+        /* Streaming events are delivered through a connection shared with other subscriptions
+         * for the same server and user within this process. */
+        EwsStreamingChannel *channel = EwsStreamingChannel::channel(mEwsClient);
+        if (channel != mChannel) {
+            if (mChannel) {
+                mChannel->disconnect(this);
+            }
+            mChannel = channel;
+            connect(mChannel.data(), &EwsStreamingChannel::notificationsReceived, this,
+                    &EwsSubscriptionManager::streamingEventsReceived);
+            connect(mChannel.data(), &EwsStreamingChannel::subscriptionFailed, this,
+                    &EwsSubscriptionManager::streamingSubscriptionFailed);
+        }
+        mChannel->addSubscription(mSettings->eventSubscriptionId(), mEwsClient);
     }
     else {
         EwsGetEventsRequest *req = new EwsGetEventsRequest(mEwsClient, this);
         req->setSubscriptionId(mSettings->eventSubscriptionId());
-        req->setWatermark(mSettings->eventSubscriptionWatermark());
+        req->setWatermark(mStateStore->value(watermarkKey));
         connect(req, &EwsRequest::result, this, &EwsSubscriptionManager::getEventsRequestFinished);
         req->start();
         mEventReq = req;
@@ -186,8 +201,6 @@ void EwsSubscriptionManager::getEvents()
 
 void EwsSubscriptionManager::getEventsRequestFinished(KJob *job)
 {
-    mStreamingTimer.stop();
-
     mEventReq->deleteLater();
     mEventReq = Q_NULLPTR;
 
@@ -202,106 +215,124 @@ void EwsSubscriptionManager::getEventsRequestFinished(KJob *job)
         ((req->responses()[0].responseCode() == QStringLiteral("ErrorInvalidSubscription")) ||
         (req->responses()[0].responseCode() == QStringLiteral("ErrorSubscriptionNotFound")))) {
         mSettings->setEventSubscriptionId(QString());
-        mSettings->setEventSubscriptionWatermark(QString());
+        mStateStore->remove(watermarkKey);
         mSettings->save();
         resetSubscription();
         return;
     }
 
     if (!job->error()) {
-        processEvents(req, true);
-        if (mStreamingEvents) {
-            getEvents();
+        EwsEventRequestBase::Notification::List notifications;
+        Q_FOREACH(const EwsEventRequestBase::Response &resp, req->responses()) {
+            notifications += resp.notifications();
         }
+        processEvents(notifications, true);
     } else {
         reset();
     }
 }
 
-void EwsSubscriptionManager::streamingEventsReceived(KJob *job)
+void EwsSubscriptionManager::streamingEventsReceived(const QString &subscriptionId,
+                                                     const EwsEventRequestBase::Notification::List &notifications)
 {
-    mStreamingTimer.stop();
-
-    EwsEventRequestBase *req = qobject_cast<EwsEventRequestBase*>(job);
-    if (!req) {
-        qCWarningNC(EWSRES_LOG) << QStringLiteral("Invalid EwsEventRequestBase job object.");
-        reset();
-        return;
-    }
-
-    if (!job->error()) {
-        processEvents(req, false);
-        mStreamingTimer.start();
+    if (subscriptionId == mSettings->eventSubscriptionId()) {
+        processEvents(notifications, false);
     }
 }
 
-void EwsSubscriptionManager::streamingConnectionTimeout()
+void EwsSubscriptionManager::streamingSubscriptionFailed(const QString &subscriptionId)
 {
-    if (mEventReq) {
-        qCWarningNC(EWSRES_LOG) << QStringLiteral("Streaming request timeout - restarting");
-        mEventReq->deleteLater();
-        mEventReq = Q_NULLPTR;
-        getEvents();
+    if (subscriptionId == mSettings->eventSubscriptionId()) {
+        mSettings->setEventSubscriptionId(QString());
+        mStateStore->remove(watermarkKey);
+        mSettings->save();
+        resetSubscription();
     }
 }
 
-void EwsSubscriptionManager::processEvents(EwsEventRequestBase *req, bool finished)
+void EwsSubscriptionManager::processEvents(const EwsEventRequestBase::Notification::List &notifications,
+                                           bool finished)
 {
     bool moreEvents = false;
+    bool activity = false;
+
+    Q_FOREACH(const EwsEventRequestBase::Notification &nfy, notifications) {
+        Q_FOREACH(const EwsEventRequestBase::Event &event, nfy.events()) {
+
+            bool skip = false;
+            EwsId id = event.itemId();
+            for (auto it = mQueuedUpdates.find(id.id()); it != mQueuedUpdates.end(); ++it) {
+                if (it->type == event.type()
+                    && (it->type == EwsDeletedEvent || it->changeKey == id.changeKey())) {
+                    qCDebugNC(EWSRES_LOG) << QStringLiteral("Skipped queued update type %1 for item %2");
+                    skip = true;
+                    mQueuedUpdates.erase(it);
+                    break;
+                }
+            }
 
-    Q_FOREACH(const EwsGetEventsRequest::Response &resp, req->responses()) {
-        Q_FOREACH(const EwsGetEventsRequest::Notification &nfy, resp.notifications()) {
-            Q_FOREACH(const EwsGetEventsRequest::Event &event, nfy.events()) {
-
-                bool skip = false;
-                EwsId id = event.itemId();
-                for (auto it = mQueuedUpdates.find(id.id()); it != mQueuedUpdates.end(); ++it) {
-                    if (it->type == event.type()
-                        && (it->type == EwsDeletedEvent || it->changeKey == id.changeKey())) {
-                        qCDebugNC(EWSRES_LOG) << QStringLiteral("Skipped queued update type %1 for item %2");
+            mStateStore->setValue(watermarkKey, event.watermark());
+            if (event.type() != EwsStatusEvent) {
+                activity = true;
+            }
+            if (!skip && !event.itemIsFolder() && mInboxId.type() == EwsId::Real) {
+                /* Inbox item creations, moves and deletions can be applied without
+                 * synchronizing the whole folder. */
+                switch (event.type()) {
+                case EwsNewMailEvent:
+                case EwsCreatedEvent:
+                case EwsDeletedEvent:
+                    if (event.parentFolderId().id() == mInboxId.id()) {
+                        queueItemEvent({event.type(), event.itemId(), event.parentFolderId(), EwsId(), EwsId()});
                         skip = true;
-                        mQueuedUpdates.erase(it);
-                        break;
                     }
+                    break;
+                case EwsMovedEvent:
+                    if ((event.parentFolderId().id() == mInboxId.id()
+                        || event.oldParentFolderId().id() == mInboxId.id())
+                        && event.oldItemId().type() == EwsId::Real) {
+                        queueItemEvent({event.type(), event.itemId(), event.parentFolderId(),
+                                        event.oldItemId(), event.oldParentFolderId()});
+                        skip = true;
+                    }
+                    break;
+                default:
+                    break;
                 }
-
-                mSettings->setEventSubscriptionWatermark(event.watermark());
-                if (!skip) {
-                    switch (event.type()) {
-                    case EwsCopiedEvent:
-                    case EwsMovedEvent:
-                        if (!event.itemIsFolder()) {
-                            mUpdatedFolderIds.insert(event.oldParentFolderId());
-                        }
-                        /* no break */
-                    case EwsCreatedEvent:
-                    case EwsDeletedEvent:
-                    case EwsModifiedEvent:
-                    case EwsNewMailEvent:
-                        if (event.itemIsFolder()) {
-                            mFolderTreeChanged = true;
-                        }
-                        else {
-                            mUpdatedFolderIds.insert(event.parentFolderId());
+            }
+            if (!skip) {
+                switch (event.type()) {
+                case EwsCopiedEvent:
+                case EwsMovedEvent:
+                    if (!event.itemIsFolder()) {
+                        mUpdatedFolderIds.insert(event.oldParentFolderId());
+                    }
+                    /* no break */
+                case EwsCreatedEvent:
+                case EwsDeletedEvent:
+                case EwsModifiedEvent:
+                case EwsNewMailEvent:
+                    if (event.itemIsFolder()) {
+                        mFolderTreeChanged = true;
+                        if (event.type() == EwsCreatedEvent || event.type() == EwsMovedEvent
+                            || event.type() == EwsCopiedEvent) {
+                            mFolderAdded = true;
                         }
-                        break;
-                    case EwsStatusEvent:
-                        // Do nothing
-                        break;
-                    default:
-                        break;
                     }
+                    else {
+                        mUpdatedFolderIds.insert(event.parentFolderId());
+                    }
+                    break;
+                case EwsStatusEvent:
+                    // Do nothing
+                    break;
+                default:
+                    break;
                 }
             }
-            if (nfy.hasMoreEvents()) {
-                moreEvents = true;
-            }
         }
-        if (mStreamingEvents) {
-            EwsGetStreamingEventsRequest *req2 = qobject_cast<EwsGetStreamingEventsRequest*>(req);
-            if (req2) {
-                req2->eventsProcessed(resp);
-            }
+        if (nfy.hasMoreEvents()) {
+            moreEvents = true;
         }
     }
 
@@ -309,17 +340,36 @@ void EwsSubscriptionManager::processEvents(EwsEventRequestBase *req, bool finish
         getEvents();
     }
     else {
+        if (!mStreamingEvents) {
+            schedulePoll(activity);
+        }
         if (mFolderTreeChanged) {
             qCDebugNC(EWSRES_LOG) << QStringLiteral("Found modified folder tree");
             Q_EMIT folderTreeModified();
             mFolderTreeChanged = false;
         }
+        foldItemEvents();
+        if (!mItemEvents.isEmpty()) {
+            qCDebugNC(EWSRES_LOG) << QStringLiteral("Found %1 directly applicable item events")
+                            .arg(mItemEvents.size());
+            Q_EMIT itemEventsReceived(mItemEvents);
+            mItemEvents.clear();
+        }
         if (!mUpdatedFolderIds.isEmpty()) {
             qCDebugNC(EWSRES_LOG) << QStringLiteral("Found %1 modified folders")
                             .arg(mUpdatedFolderIds.size());
             Q_EMIT foldersModified(mUpdatedFolderIds.toList());
             mUpdatedFolderIds.clear();
         }
+        if (mFolderAdded) {
+            mFolderAdded = false;
+            /* When subscribed to all folders explicitly the subscription only covers the folders
+             * which existed when it was made. Renew it to take in the new ones. */
+            if (mSettings->serverSubscriptionAllFolders() && !serverSubscribesAllFolders()) {
+                qCDebugNC(EWSRES_LOG) << QStringLiteral("New folders found - renewing subscription");
+                resetSubscription();
+            }
+        }
     }
 }
 
@@ -327,3 +377,84 @@ void EwsSubscriptionManager::queueUpdate(EwsEventType type, QString id, QString
 {
     mQueuedUpdates.insert(id, {type, changeKey});
 }
+
+void EwsSubscriptionManager::setInboxId(const EwsId &id)
+{
+    mInboxId = id;
+}
+
+void EwsSubscriptionManager::queueItemEvent(const ItemEvent &event)
+{
+    /* Exchange reports a new message using both a new mail and a created event. Only one of them
+     * needs to be applied. Any other combination of events for the same item is too complicated
+     * to be applied directly - let the folder sync sort it out. */
+    for (auto it = mItemEvents.begin(); it != mItemEvents.end(); ++it) {
+        bool sameItem = it->itemId.id() == event.itemId.id()
+                        || (it->oldItemId.type() == EwsId::Real && it->oldItemId.id() == event.itemId.id())
+                        || (event.oldItemId.type() == EwsId::Real && it->itemId.id() == event.oldItemId.id());
+        if (!sameItem) {
+            continue;
+        }
+        if ((it->type == EwsNewMailEvent || it->type == EwsCreatedEvent)
+            && (event.type == EwsNewMailEvent || event.type == EwsCreatedEvent)) {
+            return;
+        }
+        qCDebugNC(EWSRES_LOG) << QStringLiteral("Multiple events for item %1 - falling back to folder sync")
+                        .arg(ewsHash(event.itemId.id()));
+        mUpdatedFolderIds.insert(it->folderId);
+        if (it->oldFolderId.type() == EwsId::Real) {
+            mUpdatedFolderIds.insert(it->oldFolderId);
+        }
+        mUpdatedFolderIds.insert(event.folderId);
+        if (event.oldFolderId.type() == EwsId::Real) {
+            mUpdatedFolderIds.insert(event.oldFolderId);
+        }
+        mItemEvents.erase(it);
+        return;
+    }
+
+    mItemEvents.append(event);
+}
+
+void EwsSubscriptionManager::foldItemEvents()
+{
+    /* There is no point in applying events for folders that will be synchronized anyway. Folding
+     * a move event into a sync pulls in the other folder, so repeat until nothing changes. */
+    bool folded;
+    do {
+        folded = false;
+        QSet<QString> folderIds;
+        Q_FOREACH(const EwsId &id, mUpdatedFolderIds) {
+            folderIds.insert(id.id());
+        }
+        for (auto it = mItemEvents.begin(); it != mItemEvents.end();) {
+            if (folderIds.contains(it->folderId.id()) || folderIds.contains(it->oldFolderId.id())) {
+                mUpdatedFolderIds.insert(it->folderId);
+                if (it->oldFolderId.type() == EwsId::Real) {
+                    mUpdatedFolderIds.insert(it->oldFolderId);
+                    folded = true;
+                }
+                it = mItemEvents.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    } while (folded);
+}
+
+void EwsSubscriptionManager::schedulePoll(bool activity)
+{
+    /* Poll often while there is something going on in the mailbox and back off exponentially
+     * while it stays idle. */
+    uint minInterval = qMin(mSettings->serverSubscriptionPollIntervalMin(), pollIntervalLimit);
+    uint maxInterval = qBound(minInterval, mSettings->serverSubscriptionPollIntervalMax(), pollIntervalLimit);
+
+    if (activity) {
+        mPollInterval = minInterval;
+    } else {
+        mPollInterval = qBound(minInterval, mPollInterval * 2, maxInterval);
+    }
+
+    qCDebugNC(EWSRES_LOG) << QStringLiteral("Next poll for events in %1 seconds").arg(mPollInterval);
+    mPollTimer.start(mPollInterval * 1000);
+}
@@ -20,15 +20,18 @@
 #ifndef EWSSUBSCRIPTIONMANAGER_H
 #define EWSSUBSCRIPTIONMANAGER_H
 
+#include <QPointer>
 #include <QSet>
 #include <QString>
 #include <QTimer>
 
+#include "ewseventrequestbase.h"
 #include "ewsid.h"
 
 class EwsClient;
 class KJob;
-class EwsEventRequestBase;
+class EwsStateStore;
+class EwsStreamingChannel;
 class Settings;
 
 /**
@@ -42,11 +45,16 @@ class Settings;
  *  updates.
  *
  *  Notifications can be delivered in 3 ways:
- *   - pull (i.e. polling) - the client needs to periodically question the server.
+ *   - pull (i.e. polling) - the client needs to periodically question the server. The polling
+ *                 interval adapts to the mailbox activity - it drops to the configured minimum
+ *                 once changes are reported and grows up to the configured maximum while the
+ *                 mailbox stays idle.
  *   - push - the server issues a callback connection to the client with events (not supported)
  *   - streaming - a combination of pull and push, where the client makes the connection, but the
  *                 server keeps it open for a specified period of time and keeps delivering events
- *                 over this connection (supported since Exchange 2010 SP2).
+ *                 over this connection (supported since Exchange 2010 SP2). The connection is
+ *                 shared with other subscriptions for the same server and user made from
+ *                 within the same process (see EwsStreamingChannel).
  *
  *  The responsibility of this class is to retrieve and act upon change events from the Exchange
  *  server. The current implementation is simplified:
@@ -64,17 +72,38 @@ class Settings;
  *  subscription manager about it by adding an entry about the performed operation and its subject.
  *  The subscription manager will in turn filter out update events that refer to oprerations that
  *  have already been made.
+ *
+ *  Synchronizing a folder only to find out about a single new or removed item is wasteful for
+ *  the most frequently updated folder - the inbox. Events announcing creation, move or deletion
+ *  of an inbox item carry enough information to apply the change directly. Such events are not
+ *  turned into a folder sync but are reported separately using the itemEventsReceived() signal.
+ *  In case the same folder needs to be synchronized anyway, or when several events in one batch
+ *  refer to the same item, the events are folded back into a regular folder sync.
  */
 class EwsSubscriptionManager : public QObject
 {
     Q_OBJECT
 public:
-    EwsSubscriptionManager(EwsClient &client, const EwsId &rootId, Settings *settings, QObject *parent);
+    struct ItemEvent {
+        EwsEventType type;
+        EwsId itemId;
+        EwsId folderId;
+        EwsId oldItemId;
+        EwsId oldFolderId;
+    };
+    typedef QList<ItemEvent> ItemEventList;
+
+    static const QString watermarkKey;
+
+    EwsSubscriptionManager(EwsClient &client, const EwsId &rootId, Settings *settings,
+                           EwsStateStore *stateStore, QObject *parent);
     virtual ~EwsSubscriptionManager();
     void start();
     void queueUpdate(EwsEventType type, QString id, QString changeKey);
+    void setInboxId(const EwsId &id);
 Q_SIGNALS:
     void foldersModified(EwsId::List folders);
+    void itemEventsReceived(const EwsSubscriptionManager::ItemEventList &events);
     void folderTreeModified();
     void fullSyncRequested();
     void connectionError();
@@ -82,16 +111,21 @@ private Q_SLOTS:
     void subscribeRequestFinished(KJob *job);
     void verifySubFoldersRequestFinished(KJob *job);
     void getEventsRequestFinished(KJob *job);
-    void streamingEventsReceived(KJob *job);
+    void streamingEventsReceived(const QString &subscriptionId,
+                                 const EwsEventRequestBase::Notification::List &notifications);
+    void streamingSubscriptionFailed(const QString &subscriptionId);
     void getEvents();
-    void streamingConnectionTimeout();
 private:
     void cancelSubscription();
     void setupSubscription();
-    void setupSubscriptionReq(const EwsId::List &ids);
+    void setupSubscriptionReq(const EwsId::List &ids, bool allFolders);
+    bool serverSubscribesAllFolders() const;
     void reset();
     void resetSubscription();
-    void processEvents(EwsEventRequestBase *req, bool finished);
+    void processEvents(const EwsEventRequestBase::Notification::List &notifications, bool finished);
+    void schedulePoll(bool activity);
+    void queueItemEvent(const ItemEvent &event);
+    void foldItemEvents();
 
     struct UpdateItem {
         EwsEventType type;
@@ -100,15 +134,20 @@ private:
 
     EwsClient &mEwsClient;
     QTimer mPollTimer;
+    uint mPollInterval;
     EwsId mMsgRootId;
 
     QSet<EwsId> mUpdatedFolderIds;
+    ItemEventList mItemEvents;
+    EwsId mInboxId;
     bool mFolderTreeChanged;
+    bool mFolderAdded;
     bool mStreamingEvents;
     QMultiHash<QString, UpdateItem> mQueuedUpdates;
-    QTimer mStreamingTimer;
     EwsEventRequestBase *mEventReq;
+    QPointer<EwsStreamingChannel> mChannel;
     Settings *mSettings;
+    EwsStateStore *mStateStore;
 };
 
 #endif
@@ -76,6 +76,7 @@ public Q_SLOTS:
 public:
     bool mEnabled;
     QCheckBox *mEnableCheckBox;
+    QCheckBox *mAllFoldersCheckBox;
     QTreeView *mFolderTreeView;
     QWidget *mSubContainer;
     QPushButton *mRefreshButton;
@@ -156,9 +157,10 @@ EwsSubscriptionWidgetPrivate::~EwsSubscriptionWidgetPrivate()
 {
 }
 
-void EwsSubscriptionWidgetPrivate::enableCheckBoxToggled(bool checked)
+void EwsSubscriptionWidgetPrivate::enableCheckBoxToggled(bool)
 {
-    mSubContainer->setEnabled(checked);
+    mAllFoldersCheckBox->setEnabled(mEnableCheckBox->isChecked());
+    mSubContainer->setEnabled(mEnableCheckBox->isChecked() && !mAllFoldersCheckBox->isChecked());
 }
 
 void EwsSubscriptionWidgetPrivate::reloadFolderList(bool)
@@ -302,6 +304,9 @@ EwsSubscriptionWidget::EwsSubscriptionWidget(EwsClient &client, Settings *settin
     d->mEnableCheckBox = new QCheckBox(i18nc("@option:check", "Enable server-side subscriptions"), this);
     d->mEnableCheckBox->setChecked(d->mEnabled);
 
+    d->mAllFoldersCheckBox = new QCheckBox(i18nc("@option:check", "Subscribe to all folders"), this);
+    d->mAllFoldersCheckBox->setChecked(d->mSettings->serverSubscriptionAllFolders());
+
     d->mSubContainer = new QWidget(this);
     QVBoxLayout *subContainerLayout = new QVBoxLayout(d->mSubContainer);
     subContainerLayout->setMargin(0);
@@ -347,16 +352,19 @@ EwsSubscriptionWidget::EwsSubscriptionWidget(EwsClient &client, Settings *settin
 
     topLayout->addWidget(d->mMsgWidget);
     topLayout->addWidget(d->mEnableCheckBox);
+    topLayout->addWidget(d->mAllFoldersCheckBox);
     topLayout->addWidget(d->mSubContainer);
 
     connect(d->mEnableCheckBox, &QCheckBox::toggled, d, &EwsSubscriptionWidgetPrivate::enableCheckBoxToggled);
+    connect(d->mAllFoldersCheckBox, &QCheckBox::toggled, d, &EwsSubscriptionWidgetPrivate::enableCheckBoxToggled);
     connect(d->mRefreshButton, &QPushButton::clicked, d, &EwsSubscriptionWidgetPrivate::reloadFolderList);
     connect(resetButton, &QPushButton::clicked, d, &EwsSubscriptionWidgetPrivate::resetSelection);
     connect(d->mFolderTreeModel, &QStandardItemModel::itemChanged, d, &EwsSubscriptionWidgetPrivate::treeItemChanged);
     connect(filterLineEdit, &QLineEdit::textChanged, d, &EwsSubscriptionWidgetPrivate::filterTextChanged);
     connect(subOnlyCheckBox, &QCheckBox::toggled, d->mFilterModel, &EwsSubscriptionFilterModel::setFilterSelected);
 
-    d->enableCheckBoxToggled(d->mEnabled);
+    /* Apply the loaded settings to the dependent widgets. */
+    d->enableCheckBoxToggled(d->mEnableCheckBox->isChecked());
     d->reloadFolderList(false);
 }
 
@@ -383,6 +391,13 @@ bool EwsSubscriptionWidget::subscriptionEnabled() const
     return d->mEnableCheckBox->isChecked();
 }
 
+bool EwsSubscriptionWidget::allFoldersSubscribed() const
+{
+    Q_D(const EwsSubscriptionWidget);
+
+    return d->mAllFoldersCheckBox->isChecked();
+}
+
 bool EwsSubscriptionWidget::subscribedListValid() const
 {
     Q_D(const EwsSubscriptionWidget);
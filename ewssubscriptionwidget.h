@@ -39,6 +39,7 @@ public:
     QStringList subscribedList() const;
     bool subscribedListValid() const;
     bool subscriptionEnabled() const;
+    bool allFoldersSubscribed() const;
 private:
     QScopedPointer<EwsSubscriptionWidgetPrivate> d_ptr;
     Q_DECLARE_PRIVATE(EwsSubscriptionWidget)
@@ -80,29 +80,37 @@ void EwsModifyMailJob::start()
 void EwsModifyMailJob::updateItemFinished(KJob *job)
 {
     if (job->error()) {
-        setErrorText(job->errorString());
+        setErrorMsg(job->errorString(), job->error());
         emitResult();
         return;
     }
 
     EwsUpdateItemRequest *req = qobject_cast<EwsUpdateItemRequest*>(job);
     if (!req) {
-        setErrorText(QStringLiteral("Invalid EwsUpdateItemRequest job object"));
+        setErrorMsg(QStringLiteral("Invalid EwsUpdateItemRequest job object"));
         emitResult();
         return;
     }
 
-    Q_ASSERT(req->responses().size() == mItems.size());
+    if (req->responses().size() != mItems.size()) {
+        setErrorMsg(QStringLiteral("Invalid number of responses received from server."));
+        emitResult();
+        return;
+    }
 
+    /* A failure to update one item doesn't affect the others - report it for the item only. */
     Item::List::iterator it = mItems.begin();
     Q_FOREACH(const EwsUpdateItemRequest::Response &resp, req->responses()) {
         if (!resp.isSuccess()) {
-            setErrorText(QStringLiteral("Item update failed: ") + resp.responseMessage());
-            emitResult();
-            return;
+            qCWarningNC(EWSRES_LOG) << QStringLiteral("Item update failed for item %1: %2")
+                            .arg(ewsHash(it->remoteId())).arg(resp.responseMessage());
+            mFailedItems.append(*it);
+            it = mItems.erase(it);
+            continue;
         }
 
         it->setRemoteRevision(resp.itemId().changeKey());
+        ++it;
     }
 
     emitResult();
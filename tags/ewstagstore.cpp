@@ -111,6 +111,55 @@ bool EwsTagStore::unserializeTag(const QByteArray &data, Akonadi::Tag &tag) cons
     return true;
 }
 
+QString EwsTagStore::encodeEntry(const TagEntry &entry)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_4);
+    stream << entry.rid.toLatin1();
+    stream << entry.data;
+    return QString::fromLatin1(qCompress(data, 9).toBase64());
+}
+
+int EwsTagStore::addEntry(const QString &rid)
+{
+    TagEntry entry;
+    entry.rid = rid;
+    mTags.append(entry);
+    mRidIndex.insert(rid, mTags.size() - 1);
+    return mTags.size() - 1;
+}
+
+void EwsTagStore::removeEntry(int index)
+{
+    const TagEntry &entry = mTags[index];
+    mRidIndex.remove(entry.rid);
+    if (entry.id != -1) {
+        mIdIndex.remove(entry.id);
+    }
+
+    /* Move the last entry into the freed slot to keep the table compact. */
+    int last = mTags.size() - 1;
+    if (index != last) {
+        mTags[index] = mTags[last];
+        mRidIndex[mTags[index].rid] = index;
+        if (mTags[index].id != -1) {
+            mIdIndex[mTags[index].id] = index;
+        }
+    }
+    mTags.removeLast();
+}
+
+void EwsTagStore::setEntryId(int index, Akonadi::Tag::Id id)
+{
+    TagEntry &entry = mTags[index];
+    if (entry.id != -1) {
+        mIdIndex.remove(entry.id);
+    }
+    entry.id = id;
+    mIdIndex.insert(id, index);
+}
+
 bool EwsTagStore::readTags(const QStringList &taglist, int version)
 {
 
@@ -123,7 +172,13 @@ bool EwsTagStore::readTags(const QStringList &taglist, int version)
         return true;
     }
 
-    mTagData.clear();
+    /* Akonadi identifiers are not part of the server-side list - carry them over for tags that
+     * are still there. */
+    QVector<TagEntry> oldTags;
+    oldTags.swap(mTags);
+    QHash<QString, int> oldRidIndex;
+    oldRidIndex.swap(mRidIndex);
+    mIdIndex.clear();
 
     Q_FOREACH(const QString &tag, taglist) {
         QByteArray tagdata = qUncompress(QByteArray::fromBase64(tag.toAscii()));
@@ -135,11 +190,25 @@ bool EwsTagStore::readTags(const QStringList &taglist, int version)
             QByteArray key, data;
             stream >> key >> data;
             if (stream.status() != QDataStream::Ok) {
+                /* Drop only the damaged entry - the remaining ones keep their Akonadi identifiers
+                 * so that they are not added again as new tags. */
                 qCDebugNC(EWSRES_LOG) << QStringLiteral("Incorrect tag entry");
-                mTagData.clear();
-                return false;
             } else {
-                mTagData.insert(key, data);
+                const QString rid = QString::fromLatin1(key);
+                int index = mRidIndex.value(rid, -1);
+                if (index < 0) {
+                    index = addEntry(rid);
+                }
+                TagEntry &entry = mTags[index];
+                entry.data = data;
+                /* The entry is already encoded - there is no need to do it again when writing
+                 * the list back. */
+                entry.encoded = tag;
+                int oldIndex = oldRidIndex.value(rid, -1);
+                if (oldIndex >= 0 && oldTags[oldIndex].id != -1) {
+                    entry.name = oldTags[oldIndex].name;
+                    setEntryId(index, oldTags[oldIndex].id);
+                }
             }
         }
     }
@@ -152,14 +221,10 @@ bool EwsTagStore::readTags(const QStringList &taglist, int version)
 QStringList EwsTagStore::serialize() const
 {
     QStringList tagList;
+    tagList.reserve(mTags.size());
 
-    for (auto it = mTagData.cbegin(); it != mTagData.cend(); ++it) {
-        QByteArray data;
-        QDataStream stream(&data, QIODevice::WriteOnly);
-        stream.setVersion(QDataStream::Qt_5_4);
-        stream << it.key();
-        stream << it.value();
-        tagList.append(qCompress(data, 9).toBase64());
+    Q_FOREACH(const TagEntry &entry, mTags) {
+        tagList.append(entry.encoded);
     }
 
     return tagList;
@@ -169,9 +234,9 @@ Tag::List EwsTagStore::tags() const
 {
     Tag::List tagList;
 
-    for (auto it = mTagData.cbegin(); it != mTagData.cend(); ++it) {
+    Q_FOREACH(const TagEntry &entry, mTags) {
         Tag tag(-1);
-        if (unserializeTag(it.value(), tag)) {
+        if (unserializeTag(entry.data, tag)) {
             tagList.append(tag);
         }
     }
@@ -181,7 +246,7 @@ Tag::List EwsTagStore::tags() const
 
 bool EwsTagStore::containsId(Akonadi::Tag::Id id) const
 {
-    return mTagIdMap.contains(id);
+    return mIdIndex.contains(id);
 }
 
 void EwsTagStore::addTag(const Akonadi::Tag &tag)
@@ -205,25 +270,31 @@ bool EwsTagStore::syncTags(const Akonadi::Tag::List &tags)
 
     bool changed = false;
 
-    QList<QByteArray> tagIds = mTagData.keys();
+    QVector<bool> seen(mTags.size(), false);
     Q_FOREACH(const Tag &tag, tags) {
+        const QString rid = QString::fromLatin1(tag.gid());
         QByteArray serialized = serializeTag(tag);
-        auto it = mTagData.find(tag.gid());
+        int index = mRidIndex.value(rid, -1);
         /* First check if the tag exists or if it has been changed. Only once that is done
          * check if the store knows the tag name and Akonadi id. The separation is necessary as
          * the store might have the full list of tags from Exchange, but without Akonadi IDs. When
          * a sync is done it may only yield those IDs without any of the tags changed. In such case
          * the function should return false as no actual change has been made.
          */
-        if ((it == mTagData.end()) || (*it != serialized)) {
-            mTagData.insert(tag.gid(), serialized);
-            changed = true;
+        if (index < 0) {
+            index = addEntry(rid);
+        } else if (index < seen.size()) {
+            seen[index] = true;
         }
-        if (it != mTagData.end()) {
-        	tagIds.removeOne(tag.gid());
+        TagEntry &entry = mTags[index];
+        if (entry.data != serialized) {
+            entry.data = serialized;
+            /* Only the changed entries need to be encoded again. */
+            entry.encoded = encodeEntry(entry);
+            changed = true;
         }
-        if (!mTagIdMap.contains(tag.id())) {
-            mTagIdMap.insert(tag.id(), tag.gid());
+        if (!mIdIndex.contains(tag.id())) {
+            setEntryId(index, tag.id());
             QString name;
             if (tag.hasAttribute<TagAttribute>()) {
                 name = tag.attribute<TagAttribute>()->displayName();
@@ -231,13 +302,17 @@ bool EwsTagStore::syncTags(const Akonadi::Tag::List &tags)
                 name = tag.name();
             }
             if (!name.isEmpty()) {
-                mTagNameMap.insert(tag.id(), tag.name());
+                mTags[index].name = tag.name();
             }
         }
     }
 
-    Q_FOREACH(const QByteArray &tagId, tagIds) {
-        mTagData.remove(tagId);
+    /* Remove the tags not present in the list. Go backwards as removal moves the last entry
+     * into the freed slot. */
+    for (int i = seen.size() - 1; i >= 0; --i) {
+        if (!seen[i]) {
+            removeEntry(i);
+        }
     }
 
     if (changed) {
@@ -249,49 +324,58 @@ bool EwsTagStore::syncTags(const Akonadi::Tag::List &tags)
 
 void EwsTagStore::removeTag(const Akonadi::Tag &tag)
 {
-    QByteArray rid = mTagIdMap.value(tag.id());
-    mTagIdMap.remove(tag.id());
-    mTagNameMap.remove(tag.id());
-    mTagData.remove(rid);
+    int index = mIdIndex.value(tag.id(), -1);
+    if (index >= 0) {
+        removeEntry(index);
+    }
 
     ++mVersion;
 }
 
 QByteArray EwsTagStore::tagRemoteId(Akonadi::Tag::Id id) const
 {
-    return mTagIdMap.value(id);
+    int index = mIdIndex.value(id, -1);
+    return index >= 0 ? mTags[index].rid.toLatin1() : QByteArray();
 }
 
 QString EwsTagStore::tagName(Akonadi::Tag::Id id) const
 {
-    return mTagNameMap.value(id);
+    int index = mIdIndex.value(id, -1);
+    return index >= 0 ? mTags[index].name : QString();
 }
 
 Tag::Id EwsTagStore::tagIdForRid(const QByteArray &rid) const
 {
-    return mTagIdMap.key(rid, -1);
+    int index = mRidIndex.value(QString::fromLatin1(rid), -1);
+    return index >= 0 ? mTags[index].id : -1;
 }
 
 bool EwsTagStore::readEwsProperties(Akonadi::Item &item, const EwsItem &ewsItem, bool ignoreMissing) const
 {
+    /* Fast path - most items carry no tags and therefore no extended properties at all. */
+    if (!ewsItem.hasField(EwsItemFieldExtendedProperties)) {
+        return true;
+    }
+
     QVariant tagProp = ewsItem[EwsResource::tagsProperty];
-    if (tagProp.isValid() && tagProp.canConvert<QStringList>()) {
-        QStringList tagRids = tagProp.toStringList();
-        Tag::List tags;
-        Q_FOREACH(const QString &tagRid, tagRids) {
-            Tag::Id tagId = tagIdForRid(tagRid.toAscii());
-            if (tagId == -1) {
-                /* Tag not found. */
-                qCDebug(EWSRES_LOG) << QStringLiteral("Found missing tag: %1").arg(tagRid);
-                if (ignoreMissing) {
-                    continue;
-                } else {
-                    return false;
-                }
+    if (!tagProp.isValid() || !tagProp.canConvert<QStringList>()) {
+        return true;
+    }
+
+    const QStringList tagRids = tagProp.toStringList();
+    Q_FOREACH(const QString &tagRid, tagRids) {
+        int index = mRidIndex.value(tagRid, -1);
+        Tag::Id tagId = index >= 0 ? mTags[index].id : -1;
+        if (tagId == -1) {
+            /* Tag not found. */
+            qCDebug(EWSRES_LOG) << QStringLiteral("Found missing tag: %1").arg(tagRid);
+            if (ignoreMissing) {
+                continue;
+            } else {
+                return false;
             }
-            Tag tag(tagId);
-            item.setTag(tag);
         }
+        item.setTag(Tag(tagId));
     }
 
     return true;
@@ -20,6 +20,8 @@
 #ifndef EWSTAGSTORE_H
 #define EWSTAGSTORE_H
 
+#include <QVector>
+
 #include <AkonadiCore/Tag>
 #include <AkonadiCore/Item>
 
@@ -210,15 +212,37 @@ public:
     int version() const;
 
 private:
+    /** Single entry of the tag table. */
+    struct TagEntry {
+        TagEntry() : id(-1) {};
+
+        /** Tag remote identifier (same as the Akonadi tag gid) */
+        QString rid;
+        /** Serialized tag data */
+        QByteArray data;
+        /** Compressed and encoded form of the entry as stored on the Exchange server */
+        QString encoded;
+        /** Akonadi tag identifier or -1 if not known yet */
+        Akonadi::Tag::Id id;
+        /** Tag display name */
+        QString name;
+    };
+
     QByteArray serializeTag(const Akonadi::Tag &tag) const;
     bool unserializeTag(const QByteArray &data, Akonadi::Tag &tag) const;
-
-    /** Master tag list (keyed by the tag remote identifier) */
-    QHash<QByteArray, QByteArray> mTagData;
-    /** Mapping used to determine the tag remote identifier based on Akonadi tag identifier. */
-    QHash<Akonadi::Tag::Id, QByteArray> mTagIdMap;
-    /** Mapping used to determine the tag display name based on Akonadi tag identifier. */
-    QHash<Akonadi::Tag::Id, QString> mTagNameMap;
+    static QString encodeEntry(const TagEntry &entry);
+    int addEntry(const QString &rid);
+    void removeEntry(int index);
+    void setEntryId(int index, Akonadi::Tag::Id id);
+
+    /** Master tag table */
+    QVector<TagEntry> mTags;
+    /** Index of the tag table by remote identifier. The keys share their data with the remote
+     *  identifiers in the table. Keeping them as strings allows to look up the identifiers read
+     *  from Exchange items without any conversion. */
+    QHash<QString, int> mRidIndex;
+    /** Index of the tag table by Akonadi tag identifier. */
+    QHash<Akonadi::Tag::Id, int> mIdIndex;
 
     int mVersion;
 };
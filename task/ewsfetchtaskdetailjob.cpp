@@ -19,9 +19,11 @@
 
 #include "ewsfetchtaskdetailjob.h"
 
+#include <KCalCore/Todo>
+
 #include "ewsitemshape.h"
 #include "ewsgetitemrequest.h"
-#include "ewsmailbox.h"
+#include "ewstaskconverter.h"
 #include "ewsclient_debug.h"
 
 using namespace Akonadi;
@@ -30,6 +32,11 @@ EwsFetchTaskDetailJob::EwsFetchTaskDetailJob(EwsClient &client, QObject *parent,
     : EwsFetchItemDetailJob(client, parent, collection)
 {
     EwsItemShape shape(EwsShapeIdOnly);
+    shape.setBodyType(EwsItemShape::BodyText);
+    shape << EwsPropertyField("item:Body");
+    Q_FOREACH(const EwsPropertyField &field, EwsTaskConverter::taskProperties()) {
+        shape << field;
+    }
     mRequest->setItemShape(shape);
 }
 
@@ -47,16 +54,19 @@ void EwsFetchTaskDetailJob::processItems(const QList<EwsGetItemRequest::Response
 
         if (!resp.isSuccess()) {
             qCWarningNC(EWSRES_LOG) << QStringLiteral("Failed to fetch item %1").arg(item.remoteId());
+            ++it;
             continue;
         }
 
-        //const EwsItem &ewsItem = resp.item();
-
-        // TODO: Implement
+        KCalCore::Todo::Ptr todo(new KCalCore::Todo());
+        EwsTaskConverter::readTodo(todo, resp.item());
+        item.setPayload<KCalCore::Todo::Ptr>(todo);
 
         ++it;
     }
 
+    qCDebugNC(EWSRES_LOG) << "EwsFetchTaskDetailJob::processItems: done";
+
     emitResult();
 }
 
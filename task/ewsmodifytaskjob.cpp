@@ -19,8 +19,16 @@
 
 #include "ewsmodifytaskjob.h"
 
+#include <KCalCore/Todo>
+
+#include "ewsgetitemrequest.h"
+#include "ewsupdateitemrequest.h"
+#include "ewstaskconverter.h"
+
 #include "ewsclient_debug.h"
 
+using namespace Akonadi;
+
 EwsModifyTaskJob::EwsModifyTaskJob(EwsClient& client, const Akonadi::Item::List &items,
                                    const QSet<QByteArray> &parts, QObject *parent)
     : EwsModifyItemJob(client, items, parts, parent)
@@ -32,6 +40,148 @@ EwsModifyTaskJob::~EwsModifyTaskJob()
 
 void EwsModifyTaskJob::start()
 {
-    qCWarning(EWSRES_LOG) << QStringLiteral("Task item modification not implemented!");
+    EwsId::List ids;
+
+    Q_FOREACH(const Item &item, mItems) {
+        if (item.hasPayload<KCalCore::Todo::Ptr>()) {
+            ids << EwsId(item.remoteId(), item.remoteRevision());
+        }
+    }
+
+    if (ids.isEmpty()) {
+        qCDebugNC(EWSRES_LOG) << "Nothing to do for parts" << mParts;
+        emitResult();
+        return;
+    }
+
+    /* Fetch the current server-side values of the task properties in one batch so that only the
+     * properties which actually differ from the Akonadi payload are sent back. */
+    EwsGetItemRequest *req = new EwsGetItemRequest(mClient, this);
+    req->setItemIds(ids);
+    EwsItemShape shape(EwsShapeIdOnly);
+    Q_FOREACH(const EwsPropertyField &field, EwsTaskConverter::taskProperties()) {
+        shape << field;
+    }
+    req->setItemShape(shape);
+    connect(req, &EwsGetItemRequest::result, this, &EwsModifyTaskJob::getItemFinished);
+    req->start();
+}
+
+void EwsModifyTaskJob::getItemFinished(KJob *job)
+{
+    if (job->error()) {
+        setErrorMsg(job->errorString(), job->error());
+        emitResult();
+        return;
+    }
+
+    EwsGetItemRequest *req = qobject_cast<EwsGetItemRequest*>(job);
+    if (!req) {
+        setErrorMsg(QStringLiteral("Invalid EwsGetItemRequest job object"));
+        emitResult();
+        return;
+    }
+
+    EwsUpdateItemRequest *updateReq = new EwsUpdateItemRequest(mClient, this);
+    QList<EwsGetItemRequest::Response>::const_iterator respIt = req->responses().cbegin();
+
+    Q_FOREACH(const Item &item, mItems) {
+        if (!item.hasPayload<KCalCore::Todo::Ptr>()) {
+            continue;
+        }
+
+        if (respIt == req->responses().cend()) {
+            delete updateReq;
+            setErrorMsg(QStringLiteral("Invalid number of responses received from server."));
+            emitResult();
+            return;
+        }
+
+        const EwsGetItemRequest::Response &resp = *respIt++;
+        if (!resp.isSuccess()) {
+            delete updateReq;
+            setErrorMsg(QStringLiteral("Item fetch failed: ") + resp.responseMessage());
+            emitResult();
+            return;
+        }
+
+        KCalCore::Todo::Ptr serverTodo(new KCalCore::Todo());
+        EwsTaskConverter::readTodo(serverTodo, resp.item());
+        const QHash<EwsPropertyField, QVariant> oldProps = EwsTaskConverter::writeTodo(serverTodo);
+        const QHash<EwsPropertyField, QVariant> newProps =
+            EwsTaskConverter::writeTodo(item.payload<KCalCore::Todo::Ptr>());
+
+        EwsUpdateItemRequest::ItemChange ic(EwsId(item.remoteId(), item.remoteRevision()), EwsItemTypeTask);
+        bool changed = false;
+        for (auto it = newProps.cbegin(); it != newProps.cend(); ++it) {
+            if (oldProps.value(it.key()) == it.value()) {
+                continue;
+            }
+            if (it.value().isNull()) {
+                ic.addUpdate(new EwsUpdateItemRequest::DeleteUpdate(it.key()));
+            } else {
+                ic.addUpdate(new EwsUpdateItemRequest::SetUpdate(it.key(), it.value()));
+            }
+            changed = true;
+        }
+
+        if (changed) {
+            updateReq->addItemChange(ic);
+            mUpdatedItems.append(item);
+        }
+    }
+
+    if (mUpdatedItems.isEmpty()) {
+        delete updateReq;
+        qCDebugNC(EWSRES_LOG) << "No task properties changed";
+        emitResult();
+        return;
+    }
+
+    connect(updateReq, &EwsUpdateItemRequest::result, this, &EwsModifyTaskJob::updateItemFinished);
+    updateReq->start();
+}
+
+void EwsModifyTaskJob::updateItemFinished(KJob *job)
+{
+    if (job->error()) {
+        setErrorMsg(job->errorString(), job->error());
+        emitResult();
+        return;
+    }
+
+    EwsUpdateItemRequest *req = qobject_cast<EwsUpdateItemRequest*>(job);
+    if (!req) {
+        setErrorMsg(QStringLiteral("Invalid EwsUpdateItemRequest job object"));
+        emitResult();
+        return;
+    }
+
+    if (req->responses().size() != mUpdatedItems.size()) {
+        setErrorMsg(QStringLiteral("Invalid number of responses received from server."));
+        emitResult();
+        return;
+    }
+
+    QHash<QString, QString> changeKeys;
+    Item::List::const_iterator updIt = mUpdatedItems.cbegin();
+    Q_FOREACH(const EwsUpdateItemRequest::Response &resp, req->responses()) {
+        if (!resp.isSuccess()) {
+            setErrorMsg(QStringLiteral("Item update failed: ") + resp.responseMessage());
+            emitResult();
+            return;
+        }
+
+        changeKeys.insert(updIt->remoteId(), resp.itemId().changeKey());
+        ++updIt;
+    }
+
+    for (Item::List::iterator it = mItems.begin(); it != mItems.end(); ++it) {
+        auto keyIt = changeKeys.constFind(it->remoteId());
+        if (keyIt != changeKeys.cend()) {
+            it->setRemoteRevision(*keyIt);
+        }
+    }
+
     emitResult();
 }
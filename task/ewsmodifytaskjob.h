@@ -30,6 +30,11 @@ public:
                      QObject *parent);
     virtual ~EwsModifyTaskJob();
     virtual void start() Q_DECL_OVERRIDE;
+private Q_SLOTS:
+    void getItemFinished(KJob *job);
+    void updateItemFinished(KJob *job);
+private:
+    Akonadi::Item::List mUpdatedItems;
 };
 
 #endif
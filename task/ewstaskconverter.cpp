@@ -0,0 +1,200 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include "ewstaskconverter.h"
+
+#include <KCalCore/Todo>
+
+#include "ewsitem.h"
+
+QList<EwsPropertyField> EwsTaskConverter::taskProperties()
+{
+    static const QList<EwsPropertyField> props = {
+        EwsPropertyField("item:Subject"),
+        EwsPropertyField("item:Importance"),
+        EwsPropertyField("item:Sensitivity"),
+        EwsPropertyField("task:StartDate"),
+        EwsPropertyField("task:DueDate"),
+        EwsPropertyField("task:CompleteDate"),
+        EwsPropertyField("task:PercentComplete"),
+        EwsPropertyField("task:Status"),
+    };
+    return props;
+}
+
+/* EWS task status names indexed by the EwsTaskStatus value. The statuses that have no iCalendar
+ * counterpart are kept as custom statuses so that they survive a round trip. */
+static const QVector<QString> taskStatusNames = {
+    QStringLiteral("NotStarted"),
+    QStringLiteral("InProgress"),
+    QStringLiteral("Completed"),
+    QStringLiteral("WaitingOnOthers"),
+    QStringLiteral("Deferred")
+};
+
+void EwsTaskConverter::readTodo(const KCalCore::Todo::Ptr &todo, const EwsItem &ewsItem)
+{
+    QVariant v = ewsItem[EwsItemFieldItemId];
+    if (v.isValid()) {
+        todo->setUid(v.value<EwsId>().id());
+    }
+
+    v = ewsItem[EwsItemFieldSubject];
+    if (v.isValid()) {
+        todo->setSummary(v.toString());
+    }
+
+    v = ewsItem[EwsItemFieldBody];
+    if (v.isValid()) {
+        todo->setDescription(v.toString(), ewsItem[EwsItemFieldBodyIsHtml].toBool());
+    }
+
+    v = ewsItem[EwsItemFieldImportance];
+    if (v.isValid()) {
+        switch (static_cast<EwsItemImportance>(v.toInt())) {
+        case EwsItemImportanceHigh:
+            todo->setPriority(1);
+            break;
+        case EwsItemImportanceLow:
+            todo->setPriority(9);
+            break;
+        default:
+            todo->setPriority(5);
+            break;
+        }
+    }
+
+    v = ewsItem[EwsItemFieldSensitivity];
+    if (v.isValid()) {
+        switch (static_cast<EwsItemSensitivity>(v.toInt())) {
+        case EwsItemSensitivityPersonal:
+        case EwsItemSensitivityPrivate:
+            todo->setSecrecy(KCalCore::Incidence::SecrecyPrivate);
+            break;
+        case EwsItemSensitivityConfidential:
+            todo->setSecrecy(KCalCore::Incidence::SecrecyConfidential);
+            break;
+        default:
+            todo->setSecrecy(KCalCore::Incidence::SecrecyPublic);
+            break;
+        }
+    }
+
+    v = ewsItem[EwsItemFieldStartDate];
+    if (v.isValid()) {
+        todo->setDtStart(KDateTime(v.toDateTime()));
+    }
+
+    v = ewsItem[EwsItemFieldDueDate];
+    if (v.isValid()) {
+        todo->setDtDue(KDateTime(v.toDateTime()));
+    }
+
+    v = ewsItem[EwsItemFieldPercentComplete];
+    if (v.isValid()) {
+        todo->setPercentComplete(qRound(v.toDouble()));
+    }
+
+    v = ewsItem[EwsItemFieldStatus];
+    if (v.isValid()) {
+        int status = v.toInt();
+        switch (status) {
+        case EwsTaskStatusInProgress:
+            todo->setStatus(KCalCore::Incidence::StatusInProcess);
+            break;
+        case EwsTaskStatusCompleted:
+            todo->setStatus(KCalCore::Incidence::StatusCompleted);
+            break;
+        case EwsTaskStatusWaitingOnOthers:
+        case EwsTaskStatusDeferred:
+            todo->setCustomStatus(taskStatusNames[status]);
+            break;
+        default:
+            todo->setStatus(KCalCore::Incidence::StatusNeedsAction);
+            break;
+        }
+    }
+
+    v = ewsItem[EwsItemFieldCompleteDate];
+    if (v.isValid()) {
+        todo->setCompleted(KDateTime(v.toDateTime()));
+    }
+}
+
+QHash<EwsPropertyField, QVariant> EwsTaskConverter::writeTodo(const KCalCore::Todo::Ptr &todo)
+{
+    QHash<EwsPropertyField, QVariant> propertyHash;
+
+    propertyHash.insert(EwsPropertyField("item:Subject"), todo->summary());
+
+    QString importance;
+    if (todo->priority() >= 1 && todo->priority() <= 4) {
+        importance = QStringLiteral("High");
+    } else if (todo->priority() >= 6) {
+        importance = QStringLiteral("Low");
+    } else {
+        importance = QStringLiteral("Normal");
+    }
+    propertyHash.insert(EwsPropertyField("item:Importance"), importance);
+
+    QString sensitivity;
+    switch (todo->secrecy()) {
+    case KCalCore::Incidence::SecrecyPrivate:
+        sensitivity = QStringLiteral("Private");
+        break;
+    case KCalCore::Incidence::SecrecyConfidential:
+        sensitivity = QStringLiteral("Confidential");
+        break;
+    default:
+        sensitivity = QStringLiteral("Normal");
+        break;
+    }
+    propertyHash.insert(EwsPropertyField("item:Sensitivity"), sensitivity);
+
+    /* A null value requests removal of the property. */
+    propertyHash.insert(EwsPropertyField("task:StartDate"), todo->hasStartDate() ?
+                        QVariant(todo->dtStart().dateTime().toUTC().toString(Qt::ISODate)) : QVariant());
+    propertyHash.insert(EwsPropertyField("task:DueDate"), todo->hasDueDate() ?
+                        QVariant(todo->dtDue().dateTime().toUTC().toString(Qt::ISODate)) : QVariant());
+
+    propertyHash.insert(EwsPropertyField("task:PercentComplete"), QString::number(todo->percentComplete()));
+
+    QString status;
+    switch (todo->status()) {
+    case KCalCore::Incidence::StatusInProcess:
+        status = taskStatusNames[EwsTaskStatusInProgress];
+        break;
+    case KCalCore::Incidence::StatusCompleted:
+        status = taskStatusNames[EwsTaskStatusCompleted];
+        break;
+    case KCalCore::Incidence::StatusX:
+        if (taskStatusNames.contains(todo->customStatus())) {
+            status = todo->customStatus();
+            break;
+        }
+        // Fall through
+    default:
+        status = todo->isCompleted() ? taskStatusNames[EwsTaskStatusCompleted]
+                                     : taskStatusNames[EwsTaskStatusNotStarted];
+        break;
+    }
+    propertyHash.insert(EwsPropertyField("task:Status"), status);
+
+    return propertyHash;
+}
@@ -0,0 +1,47 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#ifndef EWSTASKCONVERTER_H
+#define EWSTASKCONVERTER_H
+
+#include <QHash>
+#include <QList>
+
+#include <KCalCore/Todo>
+
+#include "ewspropertyfield.h"
+
+class EwsItem;
+
+/**
+ *  @brief  Conversion between EWS task items and KCalCore::Todo objects
+ *
+ *  The properties returned by taskProperties() need to be requested from the server for
+ *  readTodo() to be complete. writeTodo() returns the values of the same properties, with a null
+ *  value denoting a property to be removed.
+ */
+class EwsTaskConverter
+{
+public:
+    static QList<EwsPropertyField> taskProperties();
+    static void readTodo(const KCalCore::Todo::Ptr &todo, const EwsItem &ewsItem);
+    static QHash<EwsPropertyField, QVariant> writeTodo(const KCalCore::Todo::Ptr &todo);
+};
+
+#endif
@@ -21,9 +21,11 @@
 
 #include <KCalCore/Todo>
 
+#include "ewstaskconverter.h"
 #include "ewsfetchtaskdetailjob.h"
 #include "ewsmodifytaskjob.h"
 #include "ewscreatetaskjob.h"
+#include "ewsitem.h"
 
 using namespace Akonadi;
 
@@ -59,8 +61,9 @@ QString EwsTaskHandler::mimeType()
 
 bool EwsTaskHandler::setItemPayload(Akonadi::Item &item, const EwsItem &ewsItem)
 {
-    Q_UNUSED(item)
-    Q_UNUSED(ewsItem)
+    KCalCore::Todo::Ptr todo(new KCalCore::Todo());
+    EwsTaskConverter::readTodo(todo, ewsItem);
+    item.setPayload<KCalCore::Todo::Ptr>(todo);
 
     return true;
 }
@@ -20,6 +20,8 @@
 #ifndef EWSTASKHANDLER_H
 #define EWSTASKHANDLER_H
 
+#include <KCalCore/Todo>
+
 #include "ewsitemhandler.h"
 
 class EwsTaskHandler : public EwsItemHandler
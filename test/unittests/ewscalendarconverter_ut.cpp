@@ -0,0 +1,164 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include <QTimeZone>
+#include <QtTest>
+
+#include <KCalCore/Event>
+#include <KDE/KSystemTimeZones>
+#include <KDE/KTimeZone>
+
+#include "calendar/ewscalendarconverter.h"
+#include "ewsitemparser.h"
+
+class UtEwsCalendarConverter : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void incidenceFromMime();
+    void resolveTimezone();
+    void resolveTimezone_data();
+    void resolveTimezoneBenchmark();
+    void resolveTimezoneBenchmark_data();
+};
+
+/* Time zones of a typical calendar - the same few of them are looked up for each item. */
+static const QVector<QPair<QString, QString>> calendarTimezones = {
+    {QStringLiteral("W. Europe Standard Time"), QStringLiteral("de-DE")},
+    {QStringLiteral("Central European Standard Time"), QStringLiteral("pl-PL")},
+    {QStringLiteral("GMT Standard Time"), QStringLiteral("en-GB")},
+    {QStringLiteral("Eastern Standard Time"), QStringLiteral("en-US")},
+    {QStringLiteral("tzone://Microsoft/Utc"), QStringLiteral("en-US")},
+};
+
+void UtEwsCalendarConverter::incidenceFromMime()
+{
+    /* Exchange names the time zone of the event after the Windows one. */
+    const QByteArray ical = "BEGIN:VCALENDAR\r\n"
+        "VERSION:2.0\r\n"
+        "BEGIN:VTIMEZONE\r\n"
+        "TZID:W. Europe Standard Time\r\n"
+        "BEGIN:STANDARD\r\n"
+        "DTSTART:16010101T030000\r\n"
+        "TZOFFSETFROM:+0200\r\n"
+        "TZOFFSETTO:+0100\r\n"
+        "RRULE:FREQ=YEARLY;INTERVAL=1;BYDAY=-1SU;BYMONTH=10\r\n"
+        "END:STANDARD\r\n"
+        "BEGIN:DAYLIGHT\r\n"
+        "DTSTART:16010101T020000\r\n"
+        "TZOFFSETFROM:+0100\r\n"
+        "TZOFFSETTO:+0200\r\n"
+        "RRULE:FREQ=YEARLY;INTERVAL=1;BYDAY=-1SU;BYMONTH=3\r\n"
+        "END:DAYLIGHT\r\n"
+        "END:VTIMEZONE\r\n"
+        "BEGIN:VEVENT\r\n"
+        "UID:040000008200E00074C5B7101A82E008\r\n"
+        "SUMMARY:Meeting\r\n"
+        "DTSTART;TZID=W. Europe Standard Time:20170601T100000\r\n"
+        "DTEND;TZID=W. Europe Standard Time:20170601T110000\r\n"
+        "END:VEVENT\r\n"
+        "END:VCALENDAR\r\n";
+
+    EwsItem item = parseEwsItem(QStringLiteral("<CalendarItem>"
+        "<MimeContent CharacterSet=\"UTF-8\">%1</MimeContent>"
+        "<ItemId Id=\"DdBTBAvLHI8OyQ3K\" ChangeKey=\"6yDDqXl+\"/>"
+        "<Culture>de-DE</Culture>"
+        "<CalendarItemType>Single</CalendarItemType>"
+        "<TimeZone>W. Europe Standard Time</TimeZone>"
+        "</CalendarItem>").arg(QString::fromLatin1(ical.toBase64())));
+    QVERIFY(item.isValid());
+
+    KCalCore::Incidence::Ptr incidence = EwsCalendarConverter::incidenceFromMime(item, false);
+    QVERIFY(incidence);
+    QCOMPARE(incidence->summary(), QStringLiteral("Meeting"));
+    QCOMPARE(incidence->dtStart().timeZone().name(), QStringLiteral("Europe/Berlin"));
+    QCOMPARE(incidence->dtStart().time(), QTime(10, 0));
+    KCalCore::Event::Ptr event = incidence.staticCast<KCalCore::Event>();
+    QCOMPARE(event->dtEnd().timeZone().name(), QStringLiteral("Europe/Berlin"));
+    QCOMPARE(event->dtEnd().time(), QTime(11, 0));
+}
+
+void UtEwsCalendarConverter::resolveTimezone_data()
+{
+    QTest::addColumn<QString>("msTimezone");
+    QTest::addColumn<QString>("culture");
+    QTest::addColumn<QString>("ianaTimezone");
+
+    QTest::newRow("culture country") << QStringLiteral("W. Europe Standard Time") << QStringLiteral("de-DE")
+                                     << QStringLiteral("Europe/Berlin");
+    QTest::newRow("other culture country") << QStringLiteral("W. Europe Standard Time") << QStringLiteral("it-IT")
+                                           << QStringLiteral("Europe/Rome");
+    QTest::newRow("default country") << QStringLiteral("Eastern Standard Time") << QString()
+                                     << QStringLiteral("America/New_York");
+    QTest::newRow("utc") << QStringLiteral("tzone://Microsoft/Utc") << QString() << QStringLiteral("UTC");
+    QTest::newRow("unknown") << QStringLiteral("No Such Standard Time") << QString() << QString();
+    QTest::newRow("empty") << QString() << QString() << QString();
+}
+
+void UtEwsCalendarConverter::resolveTimezone()
+{
+    QFETCH(QString, msTimezone);
+    QFETCH(QString, culture);
+    QFETCH(QString, ianaTimezone);
+
+    /* The second lookup is served from the cache and must give the same answer. */
+    for (int i = 0; i < 2; ++i) {
+        KTimeZone tz = EwsCalendarConverter::resolveTimezone(msTimezone, culture);
+        if (ianaTimezone.isNull()) {
+            QVERIFY(!tz.isValid());
+        } else {
+            QVERIFY(tz.isValid());
+            QCOMPARE(tz.name(), ianaTimezone);
+        }
+    }
+}
+
+void UtEwsCalendarConverter::resolveTimezoneBenchmark_data()
+{
+    QTest::addColumn<bool>("cached");
+
+    QTest::newRow("uncached") << false;
+    QTest::newRow("cached") << true;
+}
+
+void UtEwsCalendarConverter::resolveTimezoneBenchmark()
+{
+    QFETCH(bool, cached);
+
+    if (cached) {
+        QBENCHMARK {
+            for (const auto &tz : calendarTimezones) {
+                EwsCalendarConverter::resolveTimezone(tz.first, tz.second);
+            }
+        }
+    } else {
+        /* The lookup done by resolveTimezone() for each time zone before it was memoized. */
+        QBENCHMARK {
+            for (const auto &tz : calendarTimezones) {
+                QByteArray ianaTz = QTimeZone::windowsIdToDefaultIanaId(tz.first.toLatin1(),
+                                                                        QLocale(tz.second).country());
+                KSystemTimeZones::zone(QString::fromLatin1(ianaTz));
+            }
+        }
+    }
+}
+
+QTEST_MAIN(UtEwsCalendarConverter)
+
+#include "ewscalendarconverter_ut.moc"
@@ -0,0 +1,87 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include <QtTest>
+
+#include <KContacts/Addressee>
+
+#include "contact/ewscontactconverter.h"
+#include "ewsitem.h"
+#include "ewsitemparser.h"
+
+class UtEwsContactConverter : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void readContact();
+    void readContactLocalDates();
+};
+
+void UtEwsContactConverter::readContact()
+{
+    EwsItem item = parseEwsItem(QStringLiteral("<Contact>"
+        "<ItemId Id=\"DdBTBAvLHI8OyQ3K\" ChangeKey=\"6yDDqXl+\"/>"
+        "<Body BodyType=\"Text\">Met at the conference.</Body>"
+        "<DisplayName>John Doe</DisplayName>"
+        "<GivenName>John</GivenName>"
+        "<ImAddresses>"
+        "<Entry Key=\"ImAddress1\">john@im.example.com</Entry>"
+        "<Entry Key=\"ImAddress2\">jdoe@chat.example.org</Entry>"
+        "</ImAddresses>"
+        "<Surname>Doe</Surname>"
+        "</Contact>"));
+    QVERIFY(item.isValid());
+
+    KContacts::Addressee contact;
+    EwsContactConverter::readContact(contact, item);
+
+    QCOMPARE(contact.formattedName(), QStringLiteral("John Doe"));
+    QCOMPARE(contact.givenName(), QStringLiteral("John"));
+    QCOMPARE(contact.familyName(), QStringLiteral("Doe"));
+    QCOMPARE(contact.note(), QStringLiteral("Met at the conference."));
+    QCOMPARE(contact.custom(QStringLiteral("KADDRESSBOOK"), QStringLiteral("X-IMAddress")),
+             QStringLiteral("john@im.example.com, jdoe@chat.example.org"));
+}
+
+void UtEwsContactConverter::readContactLocalDates()
+{
+    /* Exchange stores the local midnight of the day converted to UTC, which can fall on the
+     * previous day. */
+    const QString birthday = QDateTime(QDate(1980, 5, 12), QTime(0, 0), Qt::LocalTime).toUTC()
+                                .toString(Qt::ISODate);
+    const QString anniversary = QDateTime(QDate(2005, 1, 1), QTime(0, 0), Qt::LocalTime).toUTC()
+                                .toString(Qt::ISODate);
+    EwsItem item = parseEwsItem(QStringLiteral("<Contact>"
+        "<ItemId Id=\"DdBTBAvLHI8OyQ3K\" ChangeKey=\"6yDDqXl+\"/>"
+        "<Birthday>%1</Birthday>"
+        "<WeddingAnniversary>%2</WeddingAnniversary>"
+        "</Contact>").arg(birthday).arg(anniversary));
+    QVERIFY(item.isValid());
+
+    KContacts::Addressee contact;
+    EwsContactConverter::readContact(contact, item);
+
+    QCOMPARE(contact.birthday().date(), QDate(1980, 5, 12));
+    QCOMPARE(contact.custom(QStringLiteral("KADDRESSBOOK"), QStringLiteral("X-Anniversary")),
+             QStringLiteral("2005-01-01"));
+}
+
+QTEST_MAIN(UtEwsContactConverter)
+
+#include "ewscontactconverter_ut.moc"
@@ -32,6 +32,7 @@ private Q_SLOTS:
     void twoItems();
     void twoItemsOneFailed();
     void twoItemsSecondFailed();
+    void twoItemsChunked();
 private:
     void verifier(FakeTransferJob* job, const QByteArray& req, const QByteArray &expReq,
                   const QByteArray &resp);
@@ -286,6 +287,86 @@ void UtEwsDeleteItemRequest::twoItemsSecondFailed()
     }
 }
 
+void UtEwsDeleteItemRequest::twoItemsChunked()
+{
+    static const QByteArray request1 = "<?xml version=\"1.0\"?>"
+                    "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<soap:Header><t:RequestServerVersion Version=\"Exchange2007_SP1\"/>"
+                    "</soap:Header><soap:Body><m:DeleteItem DeleteType=\"SoftDelete\">"
+                    "<m:ItemIds>"
+                    "<t:ItemId Id=\"9LB1MiL3cOYUjmYy\" ChangeKey=\"TBjl3rnU\"/>"
+                    "</m:ItemIds>"
+                    "</m:DeleteItem></soap:Body></soap:Envelope>\n";
+    static const QByteArray request2 = "<?xml version=\"1.0\"?>"
+                    "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<soap:Header><t:RequestServerVersion Version=\"Exchange2007_SP1\"/>"
+                    "</soap:Header><soap:Body><m:DeleteItem DeleteType=\"SoftDelete\">"
+                    "<m:ItemIds>"
+                    "<t:ItemId Id=\"rZ0sc7Gfn9+XHVgv\" ChangeKey=\"pHTEe9nY\"/>"
+                    "</m:ItemIds>"
+                    "</m:DeleteItem></soap:Body></soap:Envelope>\n";
+    static const QByteArray response1 = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                    "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                    "<s:Body xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+                    "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">"
+                    "<m:DeleteItemResponse "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<m:ResponseMessages>"
+                    "<m:DeleteItemResponseMessage ResponseClass=\"Error\">"
+                    "<m:MessageText>The specified object was not found in the store.</m:MessageText>"
+                    "<m:ResponseCode>ErrorItemNotFound</m:ResponseCode>"
+                    "<m:DescriptiveLinkKey>0</m:DescriptiveLinkKey>"
+                    "</m:DeleteItemResponseMessage>"
+                    "</m:ResponseMessages>"
+                    "</m:DeleteItemResponse>"
+                    "</s:Body>"
+                    "</s:Envelope>";
+    static const QByteArray response2 = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                    "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                    "<s:Body xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+                    "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">"
+                    "<m:DeleteItemResponse "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<m:ResponseMessages>"
+                    "<m:DeleteItemResponseMessage ResponseClass=\"Success\">"
+                    "<m:ResponseCode>NoError</m:ResponseCode>"
+                    "</m:DeleteItemResponseMessage>"
+                    "</m:ResponseMessages>"
+                    "</m:DeleteItemResponse>"
+                    "</s:Body>"
+                    "</s:Envelope>";
+
+    /* Delay the response to the first chunk so that the second one completes first. The
+     * responses must nevertheless be returned in item order. */
+    FakeTransferJob::addVerifier(this, [this](FakeTransferJob* job, const QByteArray& req){
+        QTimer::singleShot(100, job, [this, job, req]() {
+            verifier(job, req, request1, response1);
+        });
+    });
+    FakeTransferJob::addVerifier(this, [this](FakeTransferJob* job, const QByteArray& req){
+        verifier(job, req, request2, response2);
+    });
+    QScopedPointer<EwsDeleteItemRequest> req(new EwsDeleteItemRequest(mClient, this));
+    static const EwsId::List ids = {
+        EwsId("9LB1MiL3cOYUjmYy", "TBjl3rnU"),
+        EwsId("rZ0sc7Gfn9+XHVgv", "pHTEe9nY")
+    };
+    req->setItemIds(ids);
+    req->setChunkSize(1);
+    req->exec();
+
+    QCOMPARE(req->error(), 0);
+    QCOMPARE(req->responses().size(), 2);
+    QCOMPARE(req->responses()[0].responseClass(), EwsResponseError);
+    QCOMPARE(req->responses()[1].responseClass(), EwsResponseSuccess);
+}
+
 void UtEwsDeleteItemRequest::verifier(FakeTransferJob* job, const QByteArray& req,
                                       const QByteArray &expReq, const QByteArray &response)
 {
@@ -0,0 +1,163 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include <QEventLoop>
+#include <QtTest>
+
+#include "fakehttppost.h"
+
+#include "ewsemptyfolderrequest.h"
+
+class UtEwsEmptyFolderRequest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void singleFolder();
+    void singleFolderFailed();
+private:
+    void verifier(FakeTransferJob* job, const QByteArray& req, const QByteArray &expReq,
+                  const QByteArray &resp);
+
+    EwsClient mClient;
+};
+
+void UtEwsEmptyFolderRequest::singleFolder()
+{
+    static const QByteArray request = "<?xml version=\"1.0\"?>"
+                    "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<soap:Header><t:RequestServerVersion Version=\"Exchange2010_SP1\"/>"
+                    "</soap:Header><soap:Body>"
+                    "<m:EmptyFolder DeleteType=\"SoftDelete\" DeleteSubFolders=\"false\">"
+                    "<m:FolderIds><t:FolderId Id=\"tvMBpR4R3ohjbKCJ\" ChangeKey=\"fqWLRgxK\"/></m:FolderIds>"
+                    "</m:EmptyFolder></soap:Body></soap:Envelope>\n";
+    static const QByteArray response = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                    "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                    "<s:Header>"
+                    "<h:ServerVersionInfo MajorVersion=\"14\" MinorVersion=\"3\" "
+                    "MajorBuildNumber=\"248\" MinorBuildNumber=\"2\" "
+                    "Version=\"Exchange2010_SP1\" "
+                    "xmlns:h=\"http://schemas.microsoft.com/exchange/services/2006/types\" "
+                    "xmlns=\"http://schemas.microsoft.com/exchange/services/2006/types\" "
+                    "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+                    "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\"/>"
+                    "</s:Header>"
+                    "<s:Body xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+                    "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">"
+                    "<m:EmptyFolderResponse "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<m:ResponseMessages>"
+                    "<m:EmptyFolderResponseMessage ResponseClass=\"Success\">"
+                    "<m:ResponseCode>NoError</m:ResponseCode>"
+                    "</m:EmptyFolderResponseMessage>"
+                    "</m:ResponseMessages>"
+                    "</m:EmptyFolderResponse>"
+                    "</s:Body>"
+                    "</s:Envelope>";
+
+    FakeTransferJob::addVerifier(this, [this](FakeTransferJob* job, const QByteArray& req){
+        verifier(job, req, request, response);
+    });
+    QScopedPointer<EwsEmptyFolderRequest> req(new EwsEmptyFolderRequest(mClient, this));
+    EwsId::List ids;
+    ids << EwsId("tvMBpR4R3ohjbKCJ", "fqWLRgxK");
+    req->setFolderIds(ids);
+    req->exec();
+
+    QCOMPARE(req->error(), 0);
+    QCOMPARE(req->responses().size(), 1);
+    EwsEmptyFolderRequest::Response resp = req->responses().first();
+    QCOMPARE(resp.responseClass(), EwsResponseSuccess);
+}
+
+void UtEwsEmptyFolderRequest::singleFolderFailed()
+{
+    static const QByteArray request = "<?xml version=\"1.0\"?>"
+                    "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<soap:Header><t:RequestServerVersion Version=\"Exchange2010_SP1\"/>"
+                    "</soap:Header><soap:Body>"
+                    "<m:EmptyFolder DeleteType=\"HardDelete\" DeleteSubFolders=\"true\">"
+                    "<m:FolderIds><t:FolderId Id=\"tvMBpR4R3ohjbKCJ\" ChangeKey=\"fqWLRgxK\"/></m:FolderIds>"
+                    "</m:EmptyFolder></soap:Body></soap:Envelope>\n";
+    static const QByteArray response = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                    "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                    "<s:Header>"
+                    "<h:ServerVersionInfo MajorVersion=\"14\" MinorVersion=\"3\" "
+                    "MajorBuildNumber=\"248\" MinorBuildNumber=\"2\" "
+                    "Version=\"Exchange2010_SP1\" "
+                    "xmlns:h=\"http://schemas.microsoft.com/exchange/services/2006/types\" "
+                    "xmlns=\"http://schemas.microsoft.com/exchange/services/2006/types\" "
+                    "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+                    "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\"/>"
+                    "</s:Header>"
+                    "<s:Body xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+                    "xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">"
+                    "<m:EmptyFolderResponse "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<m:ResponseMessages>"
+                    "<m:EmptyFolderResponseMessage ResponseClass=\"Error\">"
+                    "<m:MessageText>Unable to empty the folder.</m:MessageText>"
+                    "<m:ResponseCode>ErrorCannotEmptyFolder</m:ResponseCode>"
+                    "<m:DescriptiveLinkKey>0</m:DescriptiveLinkKey>"
+                    "</m:EmptyFolderResponseMessage>"
+                    "</m:ResponseMessages>"
+                    "</m:EmptyFolderResponse>"
+                    "</s:Body>"
+                    "</s:Envelope>";
+
+    FakeTransferJob::addVerifier(this, [this](FakeTransferJob* job, const QByteArray& req){
+        verifier(job, req, request, response);
+    });
+    QScopedPointer<EwsEmptyFolderRequest> req(new EwsEmptyFolderRequest(mClient, this));
+    EwsId::List ids;
+    ids << EwsId("tvMBpR4R3ohjbKCJ", "fqWLRgxK");
+    req->setFolderIds(ids);
+    req->setType(EwsEmptyFolderRequest::HardDelete);
+    req->setDeleteSubFolders(true);
+    req->exec();
+
+    QCOMPARE(req->error(), 0);
+    QCOMPARE(req->responses().size(), 1);
+    EwsEmptyFolderRequest::Response resp = req->responses().first();
+    QCOMPARE(resp.responseClass(), EwsResponseError);
+    QCOMPARE(resp.responseCode(), QStringLiteral("ErrorCannotEmptyFolder"));
+}
+
+void UtEwsEmptyFolderRequest::verifier(FakeTransferJob* job, const QByteArray& req,
+                                       const QByteArray &expReq, const QByteArray &response)
+{
+    bool fail = true;
+    auto f = finally([&fail,&job]{
+        if (fail) {
+            job->postResponse("");
+        }
+    });
+    QCOMPARE(req, expReq);
+    fail = false;
+    job->postResponse(response);
+}
+
+QTEST_MAIN(UtEwsEmptyFolderRequest)
+
+#include "ewsemptyfolderrequest_ut.moc"
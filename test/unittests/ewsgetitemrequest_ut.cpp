@@ -29,7 +29,11 @@ class UtEwsGetItemRequest : public QObject
     Q_OBJECT
 private Q_SLOTS:
     void twoFailures();
+    void cachedTemplate();
+    void cachedTemplateBodyType();
+    void contactFields();
 private:
+    void verifyCachedTemplate(const EwsItemShape &shape, const QByteArray &shapeXml);
     void verifier(FakeTransferJob* job, const QByteArray& req, const QByteArray &expReq,
                   const QByteArray &resp);
 
@@ -129,6 +133,167 @@ void UtEwsGetItemRequest::twoFailures()
     }
 }
 
+void UtEwsGetItemRequest::cachedTemplate()
+{
+    EwsItemShape shape(EwsShapeIdOnly);
+    shape << EwsPropertyField(QStringLiteral("item:Subject"));
+
+    verifyCachedTemplate(shape, "<m:ItemShape><t:BaseShape>IdOnly</t:BaseShape>"
+                    "<t:AdditionalProperties><t:FieldURI FieldURI=\"item:Subject\"/></t:AdditionalProperties>"
+                    "</m:ItemShape>");
+}
+
+void UtEwsGetItemRequest::cachedTemplateBodyType()
+{
+    EwsItemShape shape(EwsShapeIdOnly);
+    shape.setFlags(EwsItemShape::IncludeMimeContent);
+    shape.setBodyType(EwsItemShape::BodyText);
+    shape << EwsPropertyField(QStringLiteral("item:Subject"));
+
+    verifyCachedTemplate(shape, "<m:ItemShape><t:BaseShape>IdOnly</t:BaseShape>"
+                    "<t:IncludeMimeContent>true</t:IncludeMimeContent>"
+                    "<t:BodyType>Text</t:BodyType>"
+                    "<t:AdditionalProperties><t:FieldURI FieldURI=\"item:Subject\"/></t:AdditionalProperties>"
+                    "</m:ItemShape>");
+}
+
+void UtEwsGetItemRequest::verifyCachedTemplate(const EwsItemShape &shape, const QByteArray &shapeXml)
+{
+    const QByteArray requestHead = "<?xml version=\"1.0\"?>"
+                    "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<soap:Header>"
+                    "<t:RequestServerVersion Version=\"Exchange2007_SP1\"/></soap:Header>"
+                    "<soap:Body>"
+                    "<m:GetItem>"
+                    + shapeXml +
+                    "<m:ItemIds>";
+    static const QByteArray requestTail = "</m:ItemIds>"
+                    "</m:GetItem>"
+                    "</soap:Body>"
+                    "</soap:Envelope>\n";
+    static const QByteArray responseHead = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                    "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                    "<s:Body xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">"
+                    "<m:GetItemResponse xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<m:ResponseMessages>"
+                    "<m:GetItemResponseMessage ResponseClass=\"Success\"><m:ResponseCode>NoError</m:ResponseCode><m:Items><t:Message>";
+    static const QByteArray responseTail = "<t:Subject>Test</t:Subject></t:Message></m:Items></m:GetItemResponseMessage>"
+                    "</m:ResponseMessages></m:GetItemResponse></s:Body></s:Envelope>";
+    static const EwsId::List ids = {
+        EwsId("DdBTBAvLHI8OyQ3K", "6yDDqXl+"),
+        EwsId("CgIdfZGT3QJrWZHi", "wPjRsOpg")
+    };
+
+    /* Issue two requests with an identical shape. The second one will be built from a cached
+     * template, which must not affect the request content. */
+    int templateCount = -1;
+    Q_FOREACH(const EwsId &id, ids) {
+        const QByteArray idXml = "<t:ItemId Id=\"" + id.id().toLatin1() + "\" ChangeKey=\""
+                        + id.changeKey().toLatin1() + "\"/>";
+        const QByteArray request = requestHead + idXml + requestTail;
+        const QByteArray response = responseHead + idXml + responseTail;
+
+        FakeTransferJob::addVerifier(this, [this, request, response](FakeTransferJob* job, const QByteArray& req){
+            verifier(job, req, request, response);
+        });
+        QScopedPointer<EwsGetItemRequest> req(new EwsGetItemRequest(mClient, this));
+        req->setItemIds(EwsId::List() << id);
+        req->setItemShape(shape);
+
+        req->exec();
+
+        QCOMPARE(req->error(), 0);
+        QCOMPARE(req->responses().size(), 1);
+        const EwsGetItemRequest::Response &resp = req->responses().first();
+        QCOMPARE(resp.responseClass(), EwsResponseSuccess);
+        QCOMPARE(resp.item()[EwsItemFieldItemId].value<EwsId>(), id);
+
+        /* The second request must reuse the template created by the first one. */
+        if (templateCount < 0) {
+            templateCount = EwsRequest::soapTemplateCount();
+        } else {
+            QCOMPARE(EwsRequest::soapTemplateCount(), templateCount);
+        }
+    }
+}
+
+void UtEwsGetItemRequest::contactFields()
+{
+    static const QByteArray request = "<?xml version=\"1.0\"?>"
+                    "<soap:Envelope xmlns:soap=\"http://schemas.xmlsoap.org/soap/envelope/\" "
+                    "xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" "
+                    "xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<soap:Header>"
+                    "<t:RequestServerVersion Version=\"Exchange2007_SP1\"/></soap:Header>"
+                    "<soap:Body>"
+                    "<m:GetItem>"
+                    "<m:ItemShape><t:BaseShape>IdOnly</t:BaseShape>"
+                    "<t:AdditionalProperties>"
+                    "<t:FieldURI FieldURI=\"contacts:EmailAddresses\"/>"
+                    "<t:FieldURI FieldURI=\"contacts:PhysicalAddresses\"/>"
+                    "<t:FieldURI FieldURI=\"contacts:Surname\"/>"
+                    "</t:AdditionalProperties>"
+                    "</m:ItemShape>"
+                    "<m:ItemIds>"
+                    "<t:ItemId Id=\"DdBTBAvLHI8OyQ3K\" ChangeKey=\"6yDDqXl+\"/>"
+                    "</m:ItemIds>"
+                    "</m:GetItem>"
+                    "</soap:Body>"
+                    "</soap:Envelope>\n";
+    static const QByteArray response = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                    "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\">"
+                    "<s:Body xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\">"
+                    "<m:GetItemResponse xmlns:m=\"http://schemas.microsoft.com/exchange/services/2006/messages\" xmlns:t=\"http://schemas.microsoft.com/exchange/services/2006/types\">"
+                    "<m:ResponseMessages>"
+                    "<m:GetItemResponseMessage ResponseClass=\"Success\"><m:ResponseCode>NoError</m:ResponseCode><m:Items><t:Contact>"
+                    "<t:ItemId Id=\"DdBTBAvLHI8OyQ3K\" ChangeKey=\"6yDDqXl+\"/>"
+                    "<t:EmailAddresses>"
+                    "<t:Entry Key=\"EmailAddress1\">john.doe@example.com</t:Entry>"
+                    "<t:Entry Key=\"EmailAddress2\">jd@example.org</t:Entry>"
+                    "</t:EmailAddresses>"
+                    "<t:PhysicalAddresses>"
+                    "<t:Entry Key=\"Business\"><t:Street>1 Main St</t:Street><t:City>Springfield</t:City></t:Entry>"
+                    "</t:PhysicalAddresses>"
+                    "<t:Surname>Doe</t:Surname>"
+                    "</t:Contact></m:Items></m:GetItemResponseMessage>"
+                    "</m:ResponseMessages></m:GetItemResponse></s:Body></s:Envelope>";
+
+    FakeTransferJob::addVerifier(this, [this](FakeTransferJob* job, const QByteArray& req){
+        verifier(job, req, request, response);
+    });
+    QScopedPointer<EwsGetItemRequest> req(new EwsGetItemRequest(mClient, this));
+    req->setItemIds(EwsId::List() << EwsId("DdBTBAvLHI8OyQ3K", "6yDDqXl+"));
+    EwsItemShape shape(EwsShapeIdOnly);
+    shape << EwsPropertyField(QStringLiteral("contacts:EmailAddresses"));
+    shape << EwsPropertyField(QStringLiteral("contacts:PhysicalAddresses"));
+    shape << EwsPropertyField(QStringLiteral("contacts:Surname"));
+    req->setItemShape(shape);
+
+    req->exec();
+
+    QCOMPARE(req->error(), 0);
+    QCOMPARE(req->responses().size(), 1);
+    const EwsGetItemRequest::Response &resp = req->responses().first();
+    QCOMPARE(resp.responseClass(), EwsResponseSuccess);
+    const EwsItem &item = resp.item();
+    QCOMPARE(item.type(), EwsItemTypeContact);
+    QCOMPARE(item[EwsItemFieldSurname].toString(), QStringLiteral("Doe"));
+
+    const EwsItem::EntryMap emails = item[EwsItemFieldEmailAddresses].value<EwsItem::EntryMap>();
+    QCOMPARE(emails.size(), 2);
+    QCOMPARE(emails.value(QStringLiteral("EmailAddress1")), QStringLiteral("john.doe@example.com"));
+    QCOMPARE(emails.value(QStringLiteral("EmailAddress2")), QStringLiteral("jd@example.org"));
+
+    const EwsItem::PhysicalAddressMap addresses =
+        item[EwsItemFieldPhysicalAddresses].value<EwsItem::PhysicalAddressMap>();
+    QCOMPARE(addresses.size(), 1);
+    const EwsItem::EntryMap business = addresses.value(QStringLiteral("Business"));
+    QCOMPARE(business.value(QStringLiteral("Street")), QStringLiteral("1 Main St"));
+    QCOMPARE(business.value(QStringLiteral("City")), QStringLiteral("Springfield"));
+}
+
 void UtEwsGetItemRequest::verifier(FakeTransferJob* job, const QByteArray& req,
                                       const QByteArray &expReq, const QByteArray &response)
 {
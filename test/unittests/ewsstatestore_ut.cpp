@@ -0,0 +1,179 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "ewsstatestore.h"
+
+class UtEwsStateStore : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void init();
+    void reopen();
+    void removeValue();
+    void unflushedChanges();
+    void damagedJournal();
+    void compaction();
+    void clear();
+private:
+    QString storePath() const;
+
+    QScopedPointer<QTemporaryDir> mDir;
+};
+
+void UtEwsStateStore::init()
+{
+    mDir.reset(new QTemporaryDir());
+    QVERIFY(mDir->isValid());
+}
+
+QString UtEwsStateStore::storePath() const
+{
+    return mDir->path() + QStringLiteral("/res/state");
+}
+
+void UtEwsStateStore::reopen()
+{
+    {
+        EwsStateStore store(storePath(), Q_NULLPTR);
+        QVERIFY(store.isEmpty());
+        store.setValue(QStringLiteral("key1"), QStringLiteral("value1"));
+        store.setValue(QStringLiteral("key2"), QStringLiteral("value2"));
+        store.setValue(QStringLiteral("key1"), QStringLiteral("value3"));
+        QCOMPARE(store.value(QStringLiteral("key1")), QStringLiteral("value3"));
+        store.flush();
+        QCOMPARE(store.value(QStringLiteral("key1")), QStringLiteral("value3"));
+    }
+
+    EwsStateStore store(storePath(), Q_NULLPTR);
+    QStringList keys = store.keys();
+    keys.sort();
+    QCOMPARE(keys, QStringList() << QStringLiteral("key1") << QStringLiteral("key2"));
+    QCOMPARE(store.value(QStringLiteral("key1")), QStringLiteral("value3"));
+    QCOMPARE(store.value(QStringLiteral("key2")), QStringLiteral("value2"));
+    QVERIFY(store.value(QStringLiteral("key3")).isNull());
+}
+
+void UtEwsStateStore::removeValue()
+{
+    {
+        EwsStateStore store(storePath(), Q_NULLPTR);
+        store.setValue(QStringLiteral("key1"), QStringLiteral("value1"));
+        store.setValue(QStringLiteral("key2"), QStringLiteral("value2"));
+        store.flush();
+        store.remove(QStringLiteral("key1"));
+        store.setValue(QStringLiteral("key2"), QString());
+        QVERIFY(store.isEmpty());
+        store.flush();
+    }
+
+    EwsStateStore store(storePath(), Q_NULLPTR);
+    QVERIFY(store.isEmpty());
+    QVERIFY(store.value(QStringLiteral("key1")).isNull());
+}
+
+void UtEwsStateStore::unflushedChanges()
+{
+    /* Changes are written out on destruction. Only a crash can lose them, which is why callers
+     * flush the values that must not be lost straight away. */
+    {
+        EwsStateStore store(storePath(), Q_NULLPTR);
+        store.setValue(QStringLiteral("key1"), QStringLiteral("value1"));
+    }
+
+    EwsStateStore store(storePath(), Q_NULLPTR);
+    QCOMPARE(store.value(QStringLiteral("key1")), QStringLiteral("value1"));
+}
+
+void UtEwsStateStore::damagedJournal()
+{
+    {
+        EwsStateStore store(storePath(), Q_NULLPTR);
+        store.setValue(QStringLiteral("key1"), QStringLiteral("value1"));
+        store.flush();
+        store.setValue(QStringLiteral("key2"), QStringLiteral("value2"));
+        store.flush();
+    }
+
+    /* Simulate a write interrupted by a crash - the last record is truncated. */
+    QFile journal(storePath() + QStringLiteral(".journal"));
+    QVERIFY(journal.open(QIODevice::ReadWrite));
+    QVERIFY(journal.resize(journal.size() - 4));
+    journal.close();
+
+    {
+        EwsStateStore store(storePath(), Q_NULLPTR);
+        QCOMPARE(store.keys(), QStringList() << QStringLiteral("key1"));
+        QCOMPARE(store.value(QStringLiteral("key1")), QStringLiteral("value1"));
+
+        /* New records must be appended after the last valid one. */
+        store.setValue(QStringLiteral("key3"), QStringLiteral("value3"));
+        store.flush();
+    }
+
+    EwsStateStore store(storePath(), Q_NULLPTR);
+    QCOMPARE(store.value(QStringLiteral("key1")), QStringLiteral("value1"));
+    QVERIFY(store.value(QStringLiteral("key2")).isNull());
+    QCOMPARE(store.value(QStringLiteral("key3")), QStringLiteral("value3"));
+}
+
+void UtEwsStateStore::compaction()
+{
+    const QString bigValue(16 * 1024, QLatin1Char('x'));
+
+    {
+        EwsStateStore store(storePath(), Q_NULLPTR);
+        for (int i = 0; i < 10; ++i) {
+            store.setValue(QStringLiteral("key"), bigValue + QString::number(i));
+            store.flush();
+        }
+        QCOMPARE(store.value(QStringLiteral("key")), bigValue + QStringLiteral("9"));
+    }
+
+    /* The journal has outgrown the compaction limit - its content should have been moved into the
+     * snapshot. */
+    QVERIFY(QFileInfo(storePath() + QStringLiteral(".journal")).size() < 64 * 1024);
+    QVERIFY(QFileInfo(storePath()).size() > 16 * 1024);
+
+    EwsStateStore store(storePath(), Q_NULLPTR);
+    QCOMPARE(store.keys(), QStringList() << QStringLiteral("key"));
+    QCOMPARE(store.value(QStringLiteral("key")), bigValue + QStringLiteral("9"));
+}
+
+void UtEwsStateStore::clear()
+{
+    {
+        EwsStateStore store(storePath(), Q_NULLPTR);
+        store.setValue(QStringLiteral("key1"), QStringLiteral("value1"));
+        store.flush();
+        store.setValue(QStringLiteral("key2"), QStringLiteral("value2"));
+        store.clear();
+        QVERIFY(store.isEmpty());
+    }
+
+    QVERIFY(!QFileInfo::exists(storePath()));
+    QVERIFY(!QFileInfo::exists(storePath() + QStringLiteral(".journal")));
+    QVERIFY(!QFileInfo::exists(QFileInfo(storePath()).absolutePath()));
+}
+
+QTEST_MAIN(UtEwsStateStore)
+
+#include "ewsstatestore_ut.moc"
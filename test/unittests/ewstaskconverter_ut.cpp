@@ -0,0 +1,87 @@
+/*  This file is part of Akonadi EWS Resource
+    Copyright (C) 2017 Krzysztof Nowicki <krissn@op.pl>
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with this library; see the file COPYING.LIB.  If not, write to
+    the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+#include <QtTest>
+
+#include "task/ewstaskconverter.h"
+#include "ewsitem.h"
+#include "ewsitemparser.h"
+
+class UtEwsTaskConverter : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void readTodo();
+    void readTodo_data();
+    void roundTrip();
+};
+
+void UtEwsTaskConverter::readTodo_data()
+{
+    QTest::addColumn<QString>("body");
+    QTest::addColumn<QString>("description");
+    QTest::addColumn<bool>("isRich");
+
+    QTest::newRow("text body") << QStringLiteral("<Body BodyType=\"Text\">Buy milk</Body>")
+                               << QStringLiteral("Buy milk") << false;
+    QTest::newRow("html body") << QStringLiteral("<Body BodyType=\"HTML\">&lt;b&gt;Buy milk&lt;/b&gt;</Body>")
+                               << QStringLiteral("<b>Buy milk</b>") << true;
+    QTest::newRow("no body") << QString() << QString() << false;
+}
+
+void UtEwsTaskConverter::readTodo()
+{
+    QFETCH(QString, body);
+    QFETCH(QString, description);
+    QFETCH(bool, isRich);
+
+    EwsItem item = parseEwsItem(QStringLiteral("<Task>"
+        "<ItemId Id=\"DdBTBAvLHI8OyQ3K\" ChangeKey=\"6yDDqXl+\"/>"
+        "<Subject>Shopping</Subject>%1"
+        "</Task>").arg(body));
+    QVERIFY(item.isValid());
+
+    KCalCore::Todo::Ptr todo(new KCalCore::Todo());
+    EwsTaskConverter::readTodo(todo, item);
+
+    QCOMPARE(todo->summary(), QStringLiteral("Shopping"));
+    QCOMPARE(todo->description(), description);
+    QCOMPARE(todo->descriptionIsRich(), isRich);
+}
+
+void UtEwsTaskConverter::roundTrip()
+{
+    /* EwsModifyTaskJob compares the server version read by readTodo() with the local one. */
+    EwsItem item = parseEwsItem(QStringLiteral("<Task>"
+        "<ItemId Id=\"DdBTBAvLHI8OyQ3K\" ChangeKey=\"6yDDqXl+\"/>"
+        "<Subject>Shopping</Subject>"
+        "<Body BodyType=\"Text\">Buy milk</Body>"
+        "</Task>"));
+    QVERIFY(item.isValid());
+
+    KCalCore::Todo::Ptr todo(new KCalCore::Todo());
+    EwsTaskConverter::readTodo(todo, item);
+    KCalCore::Todo::Ptr copy(new KCalCore::Todo(*todo));
+
+    QCOMPARE(EwsTaskConverter::writeTodo(todo), EwsTaskConverter::writeTodo(copy));
+}
+
+QTEST_MAIN(UtEwsTaskConverter)
+
+#include "ewstaskconverter_ut.moc"